@@ -0,0 +1,184 @@
+#include "ActiveBricks.h"
+#include "BrickMarkingShader.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+ActiveBricks::ActiveBricks(Area &area, int brickSize, BrickCriterion criterion, GLuint materialsSSBO, GLuint fansSSBO, int fanCount)
+{
+    mTemperatureVolume = area.getTemperatureVolumeHandle();
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mTemperatureFormat = area.getTemperatureFormat();
+    mVelocityFormat = area.getVelocityFormat();
+    mStorageFormatDefines = area.getStorageFormatDefines();
+    mMaterialsSSBO = materialsSSBO;
+    mFansSSBO = fansSSBO;
+    mFanCount = fanCount;
+    mCriterion = criterion;
+
+    // Bricks outside of simulation box are never active
+    mBoxMin = area.getSimulationBoxMin();
+    mBoxMax = area.getSimulationBoxMax();
+
+    mBrickSize = brickSize;
+    mBricksPerAxis = area.getResolution() / brickSize;
+    int brickCount = mBricksPerAxis * mBricksPerAxis * mBricksPerAxis;
+
+    mEnabled = true;
+    mThreshold = 0.00005f; // Difference of 0.0001 at steps of half a second
+
+    // Indirect dispatch command followed by list of brick indices
+    std::vector<GLuint> initialData(3 + brickCount, 0);
+    initialData[1] = 1;
+    initialData[2] = 1;
+    glGenBuffers(1, &mActiveBricksSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mActiveBricksSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * initialData.size(), initialData.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    prepareShader();
+}
+
+ActiveBricks::~ActiveBricks()
+{
+    glDeleteProgram(mBrickMarkingProgram);
+    glDeleteBuffers(1, &mActiveBricksSSBO);
+}
+
+void ActiveBricks::prepareShader()
+{
+    // Brick size is workgroup size, storage formats must match the ones of the simulators
+    std::stringstream source;
+    source << "#version 430 core\n";
+    source << "#define BRICK_SIZE " << mBrickSize << "\n";
+    source << mStorageFormatDefines;
+    source << brickMarkingComputeShader;
+    std::string sourceString = source.str();
+    const char* pSource = sourceString.c_str();
+
+    mBrickMarkingProgram = glCreateProgram();
+    GLint brickMarkingCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(brickMarkingCS, 1, &pSource, NULL);
+    glCompileShader(brickMarkingCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(brickMarkingCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(brickMarkingCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mBrickMarkingProgram, brickMarkingCS);
+    glLinkProgram(mBrickMarkingProgram);
+    glDetachShader(mBrickMarkingProgram, brickMarkingCS);
+    glDeleteShader(brickMarkingCS);
+
+    mTemperatureVolumeLocation = glGetUniformLocation(mBrickMarkingProgram, "temperatureVolume");
+    mVelocityVolumeLocation = glGetUniformLocation(mBrickMarkingProgram, "velocityVolume");
+    mPropertyVolumeLocation = glGetUniformLocation(mBrickMarkingProgram, "propertyVolume");
+    mFanCountLocation = glGetUniformLocation(mBrickMarkingProgram, "fanCount");
+    mFluidCriterionLocation = glGetUniformLocation(mBrickMarkingProgram, "fluidCriterion");
+    mMarkAllLocation = glGetUniformLocation(mBrickMarkingProgram, "markAll");
+    mThresholdLocation = glGetUniformLocation(mBrickMarkingProgram, "threshold");
+    mBoxMinLocation = glGetUniformLocation(mBrickMarkingProgram, "boxMin");
+    mBoxMaxLocation = glGetUniformLocation(mBrickMarkingProgram, "boxMax");
+}
+
+void ActiveBricks::update(float dt)
+{
+    // Reset dispatch command to zero workgroups
+    GLuint command[3] = { 0, 1, 1 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mActiveBricksSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(command), command);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(mBrickMarkingProgram);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mMaterialsSSBO);
+    if (mFanCount > 0)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mFansSSBO);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mActiveBricksSSBO);
+
+    glBindImageTexture(0,
+        mTemperatureVolume,
+        0,
+        GL_TRUE,
+        0,
+        GL_READ_ONLY,
+        mTemperatureFormat);
+
+    glBindImageTexture(1,
+        mPropertyVolume,
+        0,
+        GL_TRUE,
+        0,
+        GL_READ_ONLY,
+        GL_R32UI);
+
+    glBindImageTexture(2,
+        mVelocityVolume,
+        0,
+        GL_TRUE,
+        0,
+        GL_READ_ONLY,
+        mVelocityFormat);
+
+    // Fill uniforms
+    glUniform1i(mTemperatureVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1i(mVelocityVolumeLocation, 2);
+    glUniform1i(mFanCountLocation, mFanCount);
+    glUniform1i(mFluidCriterionLocation, mCriterion == BrickCriterion::FLUID);
+    glUniform1i(mMarkAllLocation, !mEnabled);
+    glUniform1f(mThresholdLocation, mThreshold / dt);
+    glUniform3i(mBoxMinLocation, mBoxMin.x, mBoxMin.y, mBoxMin.z);
+    glUniform3i(mBoxMaxLocation, mBoxMax.x, mBoxMax.y, mBoxMax.z);
+
+    // One workgroup per brick
+    glDispatchCompute(mBricksPerAxis, mBricksPerAxis, mBricksPerAxis);
+
+    glUseProgram(0);
+
+    // List is read by stencil shaders and as dispatch command
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+}
+
+void ActiveBricks::dispatch() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mActiveBricksSSBO);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, mActiveBricksSSBO);
+    glDispatchComputeIndirect(0);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+void ActiveBricks::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+bool ActiveBricks::isEnabled() const
+{
+    return mEnabled;
+}
+
+void ActiveBricks::setThreshold(float threshold)
+{
+    if (threshold >= 0.f)
+        mThreshold = threshold;
+    else
+        mThreshold = 0.00005f;
+}
@@ -0,0 +1,58 @@
+#ifndef ACTIVEBRICKS_H_
+#define ACTIVEBRICKS_H_
+
+#include "Area.h"
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+#include <string>
+
+enum class BrickCriterion
+{
+    HEAT, FLUID
+};
+
+// Marks bricks which need simulation and compacts them into a list for indirect dispatch
+class ActiveBricks
+{
+public:
+    ActiveBricks(Area &area, int brickSize, BrickCriterion criterion, GLuint materialsSSBO, GLuint fansSSBO = 0, int fanCount = 0);
+    ~ActiveBricks();
+
+    void update(float dt); // Differences below threshold count as settled, the smaller the longer the step
+    void dispatch() const;
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setThreshold(float threshold); // Temperature difference or speed times time step
+
+private:
+    void prepareShader();
+
+    GLuint mBrickMarkingProgram;
+    GLuint mActiveBricksSSBO;
+    GLuint mTemperatureVolume;
+    GLuint mVelocityVolume;
+    GLuint mPropertyVolume;
+    GLenum mTemperatureFormat;
+    GLenum mVelocityFormat;
+    GLuint mMaterialsSSBO;
+    GLuint mFansSSBO;
+    int mTemperatureVolumeLocation;
+    int mVelocityVolumeLocation;
+    int mPropertyVolumeLocation;
+    int mFanCountLocation;
+    int mFluidCriterionLocation;
+    int mMarkAllLocation;
+    int mThresholdLocation;
+    int mBoxMinLocation;
+    int mBoxMaxLocation;
+    int mBrickSize;
+    int mBricksPerAxis;
+    int mFanCount;
+    BrickCriterion mCriterion;
+    bool mEnabled;
+    float mThreshold;
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mBoxMax;
+    std::string mStorageFormatDefines;
+};
+
+#endif // ACTIVEBRICKS_H_
@@ -0,0 +1,79 @@
+#ifndef ADVECTIONSHADER_H_
+#define ADVECTIONSHADER_H_
+
+// Storage format of advected field is prepended as FIELD_FORMAT define.
+// Voxel centers are traced back along the velocity and the field is sampled trilinear there
+const char* advectionComputeShader =
+"layout(local_size_x=8, local_size_y=8, local_size_z=8) in;\n"
+"layout(FIELD_FORMAT, location = 0) uniform writeonly image3D targetVolume;\n"
+"layout(r32ui, location = 1) uniform readonly uimage3D propertyVolume;\n"
+"uniform sampler3D velocitySampler;\n"
+"uniform sampler3D sourceSampler;\n" // Field at begin of step
+"uniform sampler3D forwardSampler;\n" // Result of forward pass
+"uniform sampler3D backwardSampler;\n" // Result of backward pass
+"uniform int pass;\n" // 0: forward, 1: backward, 2: MacCormack correction
+"uniform float timeStep;\n"
+"uniform float edgeLength;\n"
+"uniform ivec3 boxMin;\n"
+"uniform ivec3 boxMax;\n"
+"const uint selfFluid = 1u << 14;\n"
+"vec3 inverseSize;\n"
+
+// Copies of the passes are only defined within the box, so samples must not reach beyond its voxel centers
+"vec3 clampToBox(vec3 position)\n"
+"{\n"
+"   return clamp(position, vec3(boxMin) + 0.5, vec3(boxMax) - 0.5);\n"
+"}\n"
+
+// Midpoint rule in voxel units, positive direction traces back in time
+"vec3 trace(vec3 position, float direction)\n"
+"{\n"
+"   float scale = direction * timeStep / edgeLength;\n"
+"   vec3 midpoint = clampToBox(position - 0.5 * scale * texture(velocitySampler, position * inverseSize).xyz);\n"
+"   return clampToBox(position - scale * texture(velocitySampler, midpoint * inverseSize).xyz);\n"
+"}\n"
+
+"void main()\n"
+"{\n"
+"   ivec3 coords = boxMin + ivec3(gl_GlobalInvocationID);\n"
+"   if(any(greaterThanEqual(coords, boxMax))) { return; }\n"
+"   inverseSize = 1.0 / vec3(textureSize(sourceSampler, 0));\n"
+"   vec3 position = vec3(coords) + 0.5;\n"
+
+//  Only fluid is transported
+"   if((imageLoad(propertyVolume, coords).x & selfFluid) == 0u)\n"
+"   {\n"
+"       vec4 value = pass == 1 ? texelFetch(forwardSampler, coords, 0) : texelFetch(sourceSampler, coords, 0);\n"
+"       imageStore(targetVolume, coords, value);\n"
+"       return;\n"
+"   }\n"
+
+"   if(pass == 0)\n"
+"   {\n"
+"       imageStore(targetVolume, coords, texture(sourceSampler, trace(position, 1.0) * inverseSize));\n"
+"   }\n"
+"   else if(pass == 1)\n"
+"   {\n"
+"       imageStore(targetVolume, coords, texture(forwardSampler, trace(position, -1.0) * inverseSize));\n"
+"   }\n"
+"   else\n"
+"   {\n"
+//      Half of the error of forward and backward pass is removed
+"       vec4 forward = texelFetch(forwardSampler, coords, 0);\n"
+"       vec4 corrected = forward + 0.5 * (texelFetch(sourceSampler, coords, 0) - texelFetch(backwardSampler, coords, 0));\n"
+//      Clamped to values the forward pass interpolated, which keeps the scheme stable
+"       ivec3 base = ivec3(floor(trace(position, 1.0) - 0.5));\n"
+"       vec4 minimum = vec4(1e30);\n"
+"       vec4 maximum = vec4(-1e30);\n"
+"       for(int i = 0; i < 8; i++)\n"
+"       {\n"
+"           ivec3 corner = clamp(base + ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1), boxMin, boxMax - 1);\n"
+"           vec4 value = texelFetch(sourceSampler, corner, 0);\n"
+"           minimum = min(minimum, value);\n"
+"           maximum = max(maximum, value);\n"
+"       }\n"
+"       imageStore(targetVolume, coords, clamp(corrected, minimum, maximum));\n"
+"   }\n"
+"}\n";
+
+#endif // ADVECTIONSHADER_H_
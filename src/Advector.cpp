@@ -0,0 +1,170 @@
+#include "Advector.h"
+#include "AdvectionShader.h"
+
+#include <iostream>
+
+Advector::Advector(Area &area, GLuint fieldVolume, GLenum fieldFormat, const std::string& rFieldFormatDefine)
+{
+    mFieldVolume = fieldVolume;
+    mFieldFormat = fieldFormat;
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mResolution = area.getResolution();
+    mBoxMin = area.getSimulationBoxMin();
+    mBoxMax = area.getSimulationBoxMax();
+
+    // Field is copied before, so no pass samples the volume it writes. Copies cover the simulation
+    // box only and traces are clamped to it
+    mSourceVolume = createVolume();
+    mForwardVolume = createVolume();
+    mBackwardVolume = createVolume();
+
+    // Storage formats of area and format of field as define
+    prepareShader(area.getStorageFormatDefines() + "#define FIELD_FORMAT " + rFieldFormatDefine + "\n");
+}
+
+Advector::~Advector()
+{
+    glDeleteProgram(mAdvectionProgram);
+    glDeleteTextures(1, &mSourceVolume);
+    glDeleteTextures(1, &mForwardVolume);
+    glDeleteTextures(1, &mBackwardVolume);
+}
+
+void Advector::prepareShader(const std::string& rDefines)
+{
+    std::string source = std::string("#version 430 core\n") + rDefines + advectionComputeShader;
+    const char* pSource = source.c_str();
+
+    mAdvectionProgram = glCreateProgram();
+    GLint advectionCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(advectionCS, 1, &pSource, NULL);
+    glCompileShader(advectionCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(advectionCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(advectionCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mAdvectionProgram, advectionCS);
+    glLinkProgram(mAdvectionProgram);
+    glDetachShader(mAdvectionProgram, advectionCS);
+    glDeleteShader(advectionCS);
+
+    mVelocitySamplerLocation = glGetUniformLocation(mAdvectionProgram, "velocitySampler");
+    mSourceSamplerLocation = glGetUniformLocation(mAdvectionProgram, "sourceSampler");
+    mForwardSamplerLocation = glGetUniformLocation(mAdvectionProgram, "forwardSampler");
+    mBackwardSamplerLocation = glGetUniformLocation(mAdvectionProgram, "backwardSampler");
+    mTargetVolumeLocation = glGetUniformLocation(mAdvectionProgram, "targetVolume");
+    mPropertyVolumeLocation = glGetUniformLocation(mAdvectionProgram, "propertyVolume");
+    mPassLocation = glGetUniformLocation(mAdvectionProgram, "pass");
+    mTimestepLocation = glGetUniformLocation(mAdvectionProgram, "timeStep");
+    mEdgeLengthLocation = glGetUniformLocation(mAdvectionProgram, "edgeLength");
+    mBoxMinLocation = glGetUniformLocation(mAdvectionProgram, "boxMin");
+    mBoxMaxLocation = glGetUniformLocation(mAdvectionProgram, "boxMax");
+}
+
+GLuint Advector::createVolume() const
+{
+    // Trilinear sampling, outside of volume like the border of the area volumes
+    GLuint volume;
+    glGenTextures(1, &volume);
+    glBindTexture(GL_TEXTURE_3D, volume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexStorage3D(GL_TEXTURE_3D, 1, mFieldFormat, mResolution, mResolution, mResolution);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return volume;
+}
+
+void Advector::advect(float dt, float edgeLength, AdvectionScheme scheme)
+{
+    if (scheme == AdvectionScheme::CENTERED)
+    {
+        return;
+    }
+
+    // Previous simulation passes must be done before copying
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glm::ivec3 extent = mBoxMax - mBoxMin;
+    glCopyImageSubData(
+        mFieldVolume, GL_TEXTURE_3D, 0, mBoxMin.x, mBoxMin.y, mBoxMin.z,
+        mSourceVolume, GL_TEXTURE_3D, 0, mBoxMin.x, mBoxMin.y, mBoxMin.z,
+        extent.x, extent.y, extent.z);
+
+    glUseProgram(mAdvectionProgram);
+
+    // Velocity advects itself from the copy
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, mFieldVolume == mVelocityVolume ? mSourceVolume : mVelocityVolume);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, mSourceVolume);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_3D, mForwardVolume);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_3D, mBackwardVolume);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindImageTexture(1, mPropertyVolume, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+
+    glUniform1i(mVelocitySamplerLocation, 0);
+    glUniform1i(mSourceSamplerLocation, 1);
+    glUniform1i(mForwardSamplerLocation, 2);
+    glUniform1i(mBackwardSamplerLocation, 3);
+    glUniform1i(mTargetVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1f(mTimestepLocation, dt);
+    glUniform1f(mEdgeLengthLocation, edgeLength);
+    glUniform3i(mBoxMinLocation, mBoxMin.x, mBoxMin.y, mBoxMin.z);
+    glUniform3i(mBoxMaxLocation, mBoxMax.x, mBoxMax.y, mBoxMax.z);
+
+    if (scheme == AdvectionScheme::SEMI_LAGRANGIAN)
+    {
+        glBindImageTexture(0, mFieldVolume, 0, GL_TRUE, 0, GL_WRITE_ONLY, mFieldFormat);
+        dispatch(0);
+    }
+    else
+    {
+        // Forward into first, backward into second volume, corrected into field
+        glBindImageTexture(0, mForwardVolume, 0, GL_TRUE, 0, GL_WRITE_ONLY, mFieldFormat);
+        dispatch(0);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glBindImageTexture(0, mBackwardVolume, 0, GL_TRUE, 0, GL_WRITE_ONLY, mFieldFormat);
+        dispatch(1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        glBindImageTexture(0, mFieldVolume, 0, GL_TRUE, 0, GL_WRITE_ONLY, mFieldFormat);
+        dispatch(2);
+    }
+
+    glUseProgram(0);
+    for (int unit = 3; unit >= 0; unit--)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_3D, 0);
+    }
+
+    // Following simulation reads advected field
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void Advector::dispatch(int pass) const
+{
+    glm::ivec3 extent = mBoxMax - mBoxMin;
+    glUniform1i(mPassLocation, pass);
+    glDispatchCompute((extent.x + 7) / 8, (extent.y + 7) / 8, (extent.z + 7) / 8);
+}
@@ -0,0 +1,54 @@
+#ifndef ADVECTOR_H_
+#define ADVECTOR_H_
+
+#include "Area.h"
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+#include <string>
+
+// CENTERED: explicit scheme inside of the simulation shaders, limited by the CFL condition
+// SEMI_LAGRANGIAN: trace back and sample trilinear, stable for any time step
+// MACCORMACK: semi-Lagrangian with correction by a backward pass, clamped to stay stable
+enum class AdvectionScheme
+{
+    CENTERED, SEMI_LAGRANGIAN, MACCORMACK
+};
+
+// Transports a volume of the area along the velocity volume within the simulation box
+class Advector
+{
+public:
+    Advector(Area &area, GLuint fieldVolume, GLenum fieldFormat, const std::string& rFieldFormatDefine);
+    ~Advector();
+
+    void advect(float dt, float edgeLength, AdvectionScheme scheme);
+
+private:
+    void prepareShader(const std::string& rFieldFormatDefine);
+    GLuint createVolume() const;
+    void dispatch(int pass) const;
+
+    GLuint mAdvectionProgram;
+    GLuint mFieldVolume;
+    GLuint mVelocityVolume;
+    GLuint mPropertyVolume;
+    GLenum mFieldFormat;
+    GLuint mSourceVolume;
+    GLuint mForwardVolume;
+    GLuint mBackwardVolume;
+    int mVelocitySamplerLocation;
+    int mSourceSamplerLocation;
+    int mForwardSamplerLocation;
+    int mBackwardSamplerLocation;
+    int mTargetVolumeLocation;
+    int mPropertyVolumeLocation;
+    int mPassLocation;
+    int mTimestepLocation;
+    int mEdgeLengthLocation;
+    int mBoxMinLocation;
+    int mBoxMaxLocation;
+    int mResolution;
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mBoxMax;
+};
+
+#endif // ADVECTOR_H_
@@ -0,0 +1,70 @@
+#include "AllocationCounter.h"
+
+#ifndef NDEBUG
+
+#include <new>
+#include <cstdlib>
+
+// Per thread, as threads of drivers allocate on their own
+static thread_local size_t allocationCount = 0;
+
+size_t getAllocationCount()
+{
+    return allocationCount;
+}
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    void* pMemory = std::malloc(size > 0 ? size : 1);
+    if (pMemory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    allocationCount++;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+#else
+
+size_t getAllocationCount()
+{
+    return 0;
+}
+
+#endif
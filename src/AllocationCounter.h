@@ -0,0 +1,11 @@
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+
+#include <cstddef>
+
+// Heap allocations of the calling thread through operator new. Counted only in debug builds, where
+// operator new is replaced, so loops can assert that they stopped allocating after warm-up. Release
+// builds always return zero
+size_t getAllocationCount();
+
+#endif // ALLOCATIONCOUNTER_H_
@@ -1,28 +1,43 @@
 #include "Area.h"
+#include "Half.h"
 
 #include <iostream>
 #include <algorithm>
+#include <memory>
 
-Area::Area(int resolution, Materialtype materialtype, State startState) : mIsInitialised(false)
+Area::Area(int resolution, Materialtype materialtype, State startState) : mIsInitialised(false), mPropertiesOutdated(true)
 {
     // Save resolutioin
     mResolution = resolution;
     mVoxelCount = resolution * resolution * resolution;
+    mFillMaterial = materialtype;
+    mStoragePrecision = StoragePrecision::FULL;
+
+    // Whole volume is simulated until cropped
+    mSimulationBoxMin = glm::ivec3(0);
+    mSimulationBoxMax = glm::ivec3(resolution);
 
     // Initialize volumes and lookup data
-    mpMaterials = new Material[mVoxelCount];
-    mStartState = new State[mVoxelCount];
-    mLookupArray = new float[mVoxelCount];
+    mpMaterials = mArena.allocate<Material>(mVoxelCount);
+    mStartState = mArena.allocate<State>(mVoxelCount);
+    mLookupArray = mArena.allocate<float>(mVoxelCount);
+    mPropertyArray = mArena.allocate<GLuint>(mVoxelCount);
+    mpColorStaging = NULL;
+    mpTemperatureStaging = NULL;
+    mpVelocityStaging = NULL;
+    mpHalfStaging = NULL;
 
     // Prepare data
-    std::fill_n(mpMaterials, mVoxelCount, determineMaterial(materialtype));
-    std::fill_n(mStartState, mVoxelCount, startState);
+    std::uninitialized_fill_n(mpMaterials, mVoxelCount, determineMaterial(materialtype));
+    std::uninitialized_fill_n(mStartState, mVoxelCount, startState);
     std::fill_n(mLookupArray, mVoxelCount, static_cast<float>(materialtype));
 
     // Initialize texture
     glGenTextures(1, &mColorVolumeHandle);
-    glGenTextures(1, &mStateVolumeHandle);
+    glGenTextures(1, &mTemperatureVolumeHandle);
+    glGenTextures(1, &mVelocityVolumeHandle);
     glGenTextures(1, &mLookupVolume);
+    glGenTextures(1, &mPropertyVolume);
 
     // Prepare list of available materials
     mMaterialList.push_back(Materialtype::AIR);
@@ -41,12 +56,12 @@ Area::~Area()
 {
     // Delete data
     glDeleteTextures(1, &mColorVolumeHandle);
-    glDeleteTextures(1, &mStateVolumeHandle);
+    glDeleteTextures(1, &mTemperatureVolumeHandle);
+    glDeleteTextures(1, &mVelocityVolumeHandle);
     glDeleteFramebuffers(1, &mLookupVolume);
+    glDeleteTextures(1, &mPropertyVolume);
 
-    delete[] mpMaterials;
-    delete[] mStartState;
-    delete[] mLookupArray;
+    // Buffers are released with arena
 }
 
 void Area::setBlock(Materialtype materialtype, int x, int y, int z, int width, int height, int depth)
@@ -62,6 +77,9 @@ void Area::setBlock(Materialtype materialtype, int x, int y, int z, int width, i
             }
         }
     }
+
+    // Geometry changed
+    mPropertiesOutdated = true;
 }
 
 void Area::printColors() const
@@ -82,6 +100,11 @@ void Area::printColors() const
     return mVoxelCount;
  }
 
+const VolumeArena& Area::getArena() const
+{
+    return mArena;
+}
+
  GLuint Area::getColorVolumeHandle() const
  {
     updateColorVolume();
@@ -94,18 +117,36 @@ GLuint Area::getLookupVolumeHandle() const
     return mLookupVolume;
 }
 
-GLuint Area::getStateVolumeHandle()
+GLuint Area::getPropertyVolumeHandle()
+{
+    if(mPropertiesOutdated)
+        updatePropertyVolume();
+
+    return mPropertyVolume;
+}
+
+GLuint Area::getTemperatureVolumeHandle()
+{
+    if(!mIsInitialised)
+        setInitialState();
+
+    return mTemperatureVolumeHandle;
+}
+
+GLuint Area::getVelocityVolumeHandle()
 {
     if(!mIsInitialised)
         setInitialState();
 
-    return mStateVolumeHandle;
+    return mVelocityVolumeHandle;
 }
 
  void Area::updateColorVolume() const
  {
-    // Copy color information to new array
-    unsigned char* pColorData = new unsigned char[mVoxelCount * 4];
+    // Copy color information to staging array
+    if(mpColorStaging == NULL)
+        mpColorStaging = mArena.allocate<unsigned char>(mVoxelCount * 4);
+    unsigned char* pColorData = mpColorStaging;
     for(int i = 0; i < mVoxelCount; i++)
     {
         pColorData[4*i] = (unsigned char) (255 * mpMaterials[i].color.r);
@@ -124,38 +165,177 @@ GLuint Area::getStateVolumeHandle()
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, mResolution, mResolution, mResolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, pColorData);
     glBindTexture(GL_TEXTURE_3D, 0);
-
-    // Get rid of array
-    delete[] pColorData;
 }
 
 void Area::setInitialState(float startTemperatur)
 {
-    float * stateData = new float[mVoxelCount * 4];
+    // Temperature and velocity are kept in separate volumes
+    if(mpTemperatureStaging == NULL)
+    {
+        mpTemperatureStaging = mArena.allocate<float>(mVoxelCount);
+        mpVelocityStaging = mArena.allocate<float>(mVoxelCount * 4);
+    }
+    float * temperatureData = mpTemperatureStaging;
+    float * velocityData = mpVelocityStaging;
 
     for(int i=0;i<mVoxelCount;i++)
     {
-        stateData[4*i]   = mStartState[i].temperature;
-        stateData[4*i+1] = mStartState[i].velocityX;
-        stateData[4*i+2] = mStartState[i].velocityY;
-        stateData[4*i+3] = mStartState[i].velocityZ;
+        temperatureData[i] = mStartState[i].temperature;
+        velocityData[4*i]   = mStartState[i].velocityX;
+        velocityData[4*i+1] = mStartState[i].velocityY;
+        velocityData[4*i+2] = mStartState[i].velocityZ;
+        velocityData[4*i+3] = 0.f;
     }
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_3D, mStateVolumeHandle);
+    glBindTexture(GL_TEXTURE_3D, mTemperatureVolumeHandle);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage3D(GL_TEXTURE_3D,0,GL_RGBA32F,mResolution,mResolution,mResolution,0,GL_RGBA,GL_FLOAT,stateData);
-    glBindTexture(GL_TEXTURE_3D,0);
+    if(mStoragePrecision == StoragePrecision::HALF)
+    {
+        // Half precision is converted here to upload only half of the data, staging is free again after upload
+        floatsToHalfs(temperatureData, getHalfStaging(), mVoxelCount);
+        glTexImage3D(GL_TEXTURE_3D,0,GL_R16F,mResolution,mResolution,mResolution,0,GL_RED,GL_HALF_FLOAT,getHalfStaging());
+    }
+    else
+    {
+        glTexImage3D(GL_TEXTURE_3D,0,GL_R32F,mResolution,mResolution,mResolution,0,GL_RED,GL_FLOAT,temperatureData);
+    }
 
-    delete []stateData;
+    // Fourth channel is unused, since there is no three channel image format
+    glBindTexture(GL_TEXTURE_3D, mVelocityVolumeHandle);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    if(mStoragePrecision == StoragePrecision::HALF)
+    {
+        floatsToHalfs(velocityData, getHalfStaging(), mVoxelCount * 4);
+        glTexImage3D(GL_TEXTURE_3D,0,GL_RGBA16F,mResolution,mResolution,mResolution,0,GL_RGBA,GL_HALF_FLOAT,getHalfStaging());
+    }
+    else
+    {
+        glTexImage3D(GL_TEXTURE_3D,0,GL_RGBA32F,mResolution,mResolution,mResolution,0,GL_RGBA,GL_FLOAT,velocityData);
+    }
+    glBindTexture(GL_TEXTURE_3D,0);
 
     mIsInitialised = true;
 }
 
+void Area::setStoragePrecision(StoragePrecision precision)
+{
+    mStoragePrecision = precision;
+
+    // Volumes are created again with new format, must happen before simulators are created
+    if(mIsInitialised)
+        setInitialState();
+}
+
+StoragePrecision Area::getStoragePrecision() const
+{
+    return mStoragePrecision;
+}
+
+GLenum Area::getTemperatureFormat() const
+{
+    return mStoragePrecision == StoragePrecision::HALF ? GL_R16F : GL_R32F;
+}
+
+GLenum Area::getVelocityFormat() const
+{
+    return mStoragePrecision == StoragePrecision::HALF ? GL_RGBA16F : GL_RGBA32F;
+}
+
+std::string Area::getStorageFormatDefines() const
+{
+    if(mStoragePrecision == StoragePrecision::HALF)
+        return "#define TEMPERATURE_FORMAT r16f\n#define VELOCITY_FORMAT rgba16f\n";
+    else
+        return "#define TEMPERATURE_FORMAT r32f\n#define VELOCITY_FORMAT rgba32f\n";
+}
+
+std::vector<float> Area::readTemperature()
+{
+    return readVolume(getTemperatureVolumeHandle(), GL_RED, 1);
+}
+
+std::vector<float> Area::readVelocity()
+{
+    return readVolume(getVelocityVolumeHandle(), GL_RGBA, 4);
+}
+
+void Area::writeTemperature(const std::vector<float>& rTemperature)
+{
+    // Simulation must be done with reading the old values
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, getTemperatureVolumeHandle());
+    if(mStoragePrecision == StoragePrecision::HALF)
+    {
+        floatsToHalfs(rTemperature.data(), getHalfStaging(), rTemperature.size());
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, mResolution, mResolution, mResolution, GL_RED, GL_HALF_FLOAT, getHalfStaging());
+    }
+    else
+    {
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, mResolution, mResolution, mResolution, GL_RED, GL_FLOAT, rTemperature.data());
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void Area::writeVelocity(const std::vector<float>& rVelocity)
+{
+    // Simulation must be done with reading the old values
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, getVelocityVolumeHandle());
+    if(mStoragePrecision == StoragePrecision::HALF)
+    {
+        floatsToHalfs(rVelocity.data(), getHalfStaging(), rVelocity.size());
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, mResolution, mResolution, mResolution, GL_RGBA, GL_HALF_FLOAT, getHalfStaging());
+    }
+    else
+    {
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, mResolution, mResolution, mResolution, GL_RGBA, GL_FLOAT, rVelocity.data());
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+std::vector<float> Area::readVolume(GLuint volume, GLenum format, int channels) const
+{
+    // Wait for simulation to write its results
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    std::vector<float> values(mVoxelCount * channels);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, volume);
+    if(mStoragePrecision == StoragePrecision::HALF)
+    {
+        // Read back halfs to transfer only half of the data
+        glGetTexImage(GL_TEXTURE_3D, 0, format, GL_HALF_FLOAT, getHalfStaging());
+        halfsToFloats(getHalfStaging(), values.data(), values.size());
+    }
+    else
+    {
+        glGetTexImage(GL_TEXTURE_3D, 0, format, GL_FLOAT, values.data());
+    }
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    return values;
+}
+
+uint16_t* Area::getHalfStaging() const
+{
+    if(mpHalfStaging == NULL)
+        mpHalfStaging = mArena.allocate<uint16_t>(mVoxelCount * 4);
+    return mpHalfStaging;
+}
+
 void Area::updateLookupVolume() const
 {
     glActiveTexture(GL_TEXTURE0);
@@ -169,11 +349,76 @@ void Area::updateLookupVolume() const
     glBindTexture(GL_TEXTURE_3D,0);
 }
 
+void Area::updatePropertyVolume()
+{
+    // Fluidity per material index
+    std::vector<bool> fluidity;
+    for(const Materialtype& type : mMaterialList)
+    {
+        fluidity.push_back(determineMaterial(type).cisf.w > 0);
+    }
+
+    // Neighbor offsets in order of mask bits
+    const int offsets[6][3] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+
+    for(int z = 0; z < mResolution; z++)
+    {
+        for(int y = 0; y < mResolution; y++)
+        {
+            for(int x = 0; x < mResolution; x++)
+            {
+                int index = x + y * mResolution + z * mResolution * mResolution;
+                GLuint material = static_cast<GLuint>(mLookupArray[index]);
+                GLuint property = material & PROPERTY_MATERIAL_MASK;
+                if(fluidity[material])
+                {
+                    property |= PROPERTY_SELF_FLUID;
+                }
+                for(int i = 0; i < 6; i++)
+                {
+                    int nx = x + offsets[i][0];
+                    int ny = y + offsets[i][1];
+                    int nz = z + offsets[i][2];
+
+                    // Outside of volume is read as air by the shaders
+                    bool neighborFluid = fluidity[0];
+                    if(nx >= 0 && ny >= 0 && nz >= 0 && nx < mResolution && ny < mResolution && nz < mResolution)
+                    {
+                        neighborFluid = fluidity[static_cast<int>(mLookupArray[nx + ny * mResolution + nz * mResolution * mResolution])];
+                    }
+                    if(neighborFluid)
+                    {
+                        property |= 1 << (PROPERTY_NEIGHBOR_FLUID_SHIFT + i);
+                    }
+                }
+                mPropertyArray[index] = property;
+            }
+        }
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, mPropertyVolume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_3D,0,GL_R32UI,mResolution,mResolution,mResolution,0, GL_RED_INTEGER, GL_UNSIGNED_INT, mPropertyArray);
+    glBindTexture(GL_TEXTURE_3D,0);
+
+    mPropertiesOutdated = false;
+}
+
 Material* Area::getMaterialData()
 {
     return mpMaterials;
 }
 
+const float* Area::getLookupData() const
+{
+    return mLookupArray;
+}
+
 Material Area::determineMaterial(const Materialtype &materialtype)
 {
     switch (materialtype)
@@ -206,4 +451,93 @@ Material Area::determineMaterial(const Materialtype &materialtype)
 const std::vector<Materialtype>& Area::getMaterialList() const
 {
     return mMaterialList;
-}
\ No newline at end of file
+}
+
+std::vector<Materialtype> Area::getPresentMaterials() const
+{
+    // Only simulation box is of interest
+    std::vector<bool> present(mMaterialList.size(), false);
+    for(int z = mSimulationBoxMin.z; z < mSimulationBoxMax.z; z++)
+    {
+        for(int y = mSimulationBoxMin.y; y < mSimulationBoxMax.y; y++)
+        {
+            for(int x = mSimulationBoxMin.x; x < mSimulationBoxMax.x; x++)
+            {
+                present[static_cast<int>(mLookupArray[x + y * mResolution + z * mResolution * mResolution])] = true;
+            }
+        }
+    }
+
+    std::vector<Materialtype> materials;
+    for(int i = 0; i < (int)mMaterialList.size(); i++)
+    {
+        if(present[i])
+        {
+            materials.push_back(mMaterialList[i]);
+        }
+    }
+    return materials;
+}
+void Area::cropToOccupiedBox(const std::vector<Fan>& rFans, const std::vector<Sensor>& rSensors, int margin)
+{
+    glm::ivec3 boxMin(mResolution);
+    glm::ivec3 boxMax(0);
+
+    // Voxels differing from material the area was filled with
+    for(int z = 0; z < mResolution; z++)
+    {
+        for(int y = 0; y < mResolution; y++)
+        {
+            for(int x = 0; x < mResolution; x++)
+            {
+                if(mLookupArray[x + y * mResolution + z * mResolution * mResolution] != static_cast<float>(mFillMaterial))
+                {
+                    boxMin = glm::min(boxMin, glm::ivec3(x, y, z));
+                    boxMax = glm::max(boxMax, glm::ivec3(x + 1, y + 1, z + 1));
+                }
+            }
+        }
+    }
+
+    // Fans with radius of their falloff in the fluid simulation
+    for(const Fan& fan : rFans)
+    {
+        glm::vec3 position = fan.getPosition() * (float)mResolution;
+        float radius = 0.2f * mResolution;
+        boxMin = glm::min(boxMin, glm::ivec3(glm::floor(position - radius)));
+        boxMax = glm::max(boxMax, glm::ivec3(glm::ceil(position + radius)));
+    }
+
+    // Sensors
+    for(const Sensor& sensor : rSensors)
+    {
+        glm::ivec3 position = glm::ivec3(sensor.getSensor().position * (float)mResolution);
+        boxMin = glm::min(boxMin, position);
+        boxMax = glm::max(boxMax, position + 1);
+    }
+
+    // Nothing placed at all, so keep everything
+    if(glm::any(glm::greaterThanEqual(boxMin, boxMax)))
+    {
+        return;
+    }
+
+    // Expand by air margin and align to bricks
+    boxMin -= margin;
+    boxMax += margin;
+    boxMin = (glm::max(boxMin, glm::ivec3(0)) / SIMULATION_BOX_ALIGNMENT) * SIMULATION_BOX_ALIGNMENT;
+    boxMax = ((glm::min(boxMax, glm::ivec3(mResolution)) + SIMULATION_BOX_ALIGNMENT - 1) / SIMULATION_BOX_ALIGNMENT) * SIMULATION_BOX_ALIGNMENT;
+
+    mSimulationBoxMin = boxMin;
+    mSimulationBoxMax = glm::min(boxMax, glm::ivec3(mResolution));
+}
+
+glm::ivec3 Area::getSimulationBoxMin() const
+{
+    return mSimulationBoxMin;
+}
+
+glm::ivec3 Area::getSimulationBoxMax() const
+{
+    return mSimulationBoxMax;
+}
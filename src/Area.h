@@ -3,8 +3,28 @@
 
 #include "Material.h"
 #include "State.h"
+#include "Fan.h"
+#include "Sensor.h"
+#include "VolumeArena.h"
 #include "externals/OpenGLLoader/gl_core_4_3.h"
+#include "externals/GLM/glm/glm.hpp"
 #include <vector>
+#include <string>
+#include <cstdint>
+
+// Precision in which temperature and velocity are stored, arithmetic is always done in 32 bit
+enum class StoragePrecision
+{
+    FULL, HALF
+};
+
+// Packed per voxel property word: material index, fluidity of neighbors (+x, -x, +y, -y, +z, -z) and of voxel itself
+const GLuint PROPERTY_MATERIAL_MASK = 0xFF;
+const GLuint PROPERTY_NEIGHBOR_FLUID_SHIFT = 8;
+const GLuint PROPERTY_SELF_FLUID = 1 << 14;
+
+// Simulation box is aligned to largest brick size of simulators
+const int SIMULATION_BOX_ALIGNMENT = 8;
 
 class Area
 {
@@ -16,27 +36,61 @@ public:
     void printColors() const;
     int getResolution() const;
     int getVoxelCount() const;
+    const VolumeArena& getArena() const; // Of volume sized buffers, staging ones are added on first use
     Material *getMaterialData();
+    const float* getLookupData() const;
     GLuint getColorVolumeHandle() const;
     GLuint getLookupVolumeHandle() const;
-    GLuint getStateVolumeHandle();
+    GLuint getPropertyVolumeHandle();
+    GLuint getTemperatureVolumeHandle();
+    GLuint getVelocityVolumeHandle();
     void setInitialState(float startTemperatur = 0.f);
+    void setStoragePrecision(StoragePrecision precision);
+    StoragePrecision getStoragePrecision() const;
+    GLenum getTemperatureFormat() const;
+    GLenum getVelocityFormat() const;
+    std::string getStorageFormatDefines() const;
+    std::vector<float> readTemperature();
+    std::vector<float> readVelocity();
+    void writeTemperature(const std::vector<float>& rTemperature);
+    void writeVelocity(const std::vector<float>& rVelocity);
     Material determineMaterial(const Materialtype &materialtype);
 	const std::vector<Materialtype>& getMaterialList() const;
+    std::vector<Materialtype> getPresentMaterials() const;
+    void cropToOccupiedBox(const std::vector<Fan>& rFans, const std::vector<Sensor>& rSensors, int margin);
+    glm::ivec3 getSimulationBoxMin() const;
+    glm::ivec3 getSimulationBoxMax() const;
 
 private:
     void updateColorVolume() const;
     void updateLookupVolume() const;
+    void updatePropertyVolume();
+    std::vector<float> readVolume(GLuint volume, GLenum format, int channels) const;
+    uint16_t* getHalfStaging() const;
 
+    // Volume sized buffers, staging ones are allocated on first use and reused
+    mutable VolumeArena mArena;
     Material* mpMaterials;
     State* mStartState;
     float* mLookupArray;
+    GLuint* mPropertyArray;
+    mutable unsigned char* mpColorStaging;
+    float* mpTemperatureStaging;
+    float* mpVelocityStaging;
+    mutable uint16_t* mpHalfStaging; // Four channels, shared by uploads and readbacks
     int mResolution;
     int mVoxelCount;
+    Materialtype mFillMaterial;
+    StoragePrecision mStoragePrecision;
+    glm::ivec3 mSimulationBoxMin;
+    glm::ivec3 mSimulationBoxMax;
     GLuint mColorVolumeHandle;
-    GLuint mStateVolumeHandle;
+    GLuint mTemperatureVolumeHandle;
+    GLuint mVelocityVolumeHandle;
     GLuint mLookupVolume;
+    GLuint mPropertyVolume;
     bool mIsInitialised;
+    bool mPropertiesOutdated;
 	std::vector<Materialtype> mMaterialList;
 };
 
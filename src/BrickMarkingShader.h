@@ -0,0 +1,147 @@
+#ifndef BRICKMARKINGSHADER_H_
+#define BRICKMARKINGSHADER_H_
+
+// One workgroup per brick, workgroup size and storage formats are prepended as defines
+const char* brickMarkingComputeShader =
+
+// Structs
+"struct Mat{\n"
+"	vec4 color;\n"
+"	vec4 cisf;\n"
+"	vec4 dppp;\n"
+"};\n"
+"struct FanStruct{\n"
+"   vec3 position;\n"
+"   float speed;\n"
+"   vec3 direction;\n"
+"   float distance;\n"
+"};\n"
+
+// Workgroup settings
+"layout(local_size_x=BRICK_SIZE, local_size_y=BRICK_SIZE, local_size_z=BRICK_SIZE) in;\n"
+
+// SSBOs
+"layout(std430, binding = 0) buffer Material\n"
+"{\n"
+"	Mat m[];\n"
+"};\n"
+"layout(std430, binding = 1) buffer Fan\n"
+"{\n"
+"	FanStruct fans[];\n"
+"};\n"
+"layout(std430, binding = 2) buffer ActiveBricks\n"
+"{\n"
+"	uint numGroupsX;\n" // Doubles as indirect dispatch command
+"	uint numGroupsY;\n"
+"	uint numGroupsZ;\n"
+"	uint bricks[];\n"
+"};\n"
+
+// Uniforms
+"layout(TEMPERATURE_FORMAT, location = 0) uniform image3D temperatureVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(VELOCITY_FORMAT, location = 2) uniform image3D velocityVolume;\n"
+"uniform int fanCount;\n"
+"uniform bool fluidCriterion;\n"
+"uniform bool markAll;\n"
+"uniform float threshold;\n" // Of differences, scaled by the time step as changes grow with it
+"uniform ivec3 boxMin;\n" // Simulated part of the volume, everything outside stays at far-field state
+"uniform ivec3 boxMax;\n"
+
+// Consts
+"const uint materialMask = 0xFFu;\n"
+"const uint anyFluid = 0x7Fu << 8;\n" // Fluid neighbors or fluid itself
+"const ivec3 offsets[6] = ivec3[6](ivec3(1,0,0), ivec3(-1,0,0), ivec3(0,1,0), ivec3(0,-1,0), ivec3(0,0,1), ivec3(0,0,-1));\n"
+
+// Shared memory
+"shared uint brickActive;\n"
+
+// Material lookup (outside of volume is treated like air)
+"Mat getMaterial(ivec3 coords)\n"
+"{\n"
+"	return m[int(imageLoad(propertyVolume, coords).x & materialMask)];\n"
+"}\n"
+
+// Fluid stencil has to run when fluid is around and something moves or is pushed
+"bool fluidActive(ivec3 coords)\n"
+"{\n"
+"	if((imageLoad(propertyVolume, coords).x & anyFluid) == 0u)\n"
+"	{\n"
+"		return false;\n" // Solid only
+"	}\n"
+"	float myTemperature = imageLoad(temperatureVolume, coords).x;\n"
+"	float motion = length(imageLoad(velocityVolume, coords).xyz);\n"
+"	float temperatureDifference = 0;\n"
+"	for(int i = 0; i < 6; i++)\n"
+"	{\n"
+"		motion = max(motion, length(imageLoad(velocityVolume, coords + offsets[i]).xyz));\n"
+"		temperatureDifference = max(temperatureDifference, abs(imageLoad(temperatureVolume, coords + offsets[i]).x - myTemperature));\n"
+"	}\n"
+"	if(motion > threshold || temperatureDifference > threshold)\n" // Uneven buoyancy drives the flow, even one is balanced
+"	{\n"
+"		return true;\n"
+"	}\n"
+"	vec3 relCoords = vec3(coords) / vec3(imageSize(temperatureVolume));\n"
+"	for(int i = 0; i < fanCount; i++)\n"
+"	{\n"
+"		if(length(relCoords - fans[i].position) < 0.2)\n" // Same falloff radius as wind
+"		{\n"
+"			return true;\n"
+"		}\n"
+"	}\n"
+"	return false;\n"
+"}\n"
+
+// Heat stencil has to run when heat can flow and temperature is not settled
+"bool heatActive(ivec3 coords)\n"
+"{\n"
+"	Mat myMaterial = getMaterial(coords);\n"
+"	float myTemperature = imageLoad(temperatureVolume, coords).x;\n"
+"	if(myMaterial.cisf.y > 0 && abs(myTemperature - myMaterial.cisf.y) > threshold)\n" // Heater not at its temperature
+"	{\n"
+"		return true;\n"
+"	}\n"
+"	if(myMaterial.cisf.w > 0 && length(imageLoad(velocityVolume, coords).xyz) > threshold)\n" // Convection
+"	{\n"
+"		return true;\n"
+"	}\n"
+"	for(int i = 0; i < 6; i++)\n"
+"	{\n"
+"		float conductivity = myMaterial.cisf.x + getMaterial(coords + offsets[i]).cisf.x;\n"
+"		if(conductivity > 0 && abs(imageLoad(temperatureVolume, coords + offsets[i]).x - myTemperature) > threshold)\n"
+"		{\n"
+"			return true;\n"
+"		}\n"
+"	}\n"
+"	return false;\n"
+"}\n"
+
+// Main
+"void main()\n"
+"{\n"
+"	if(gl_LocalInvocationIndex == 0)\n"
+"	{\n"
+"		brickActive = 0;\n"
+"	}\n"
+"	barrier();\n"
+"	ivec3 coords = ivec3(gl_GlobalInvocationID);\n"
+"	bool inBox = all(greaterThanEqual(coords, boxMin)) && all(lessThan(coords, boxMax));\n"
+"	bool voxelActive = inBox && markAll;\n"
+"	if(inBox && !markAll)\n"
+"	{\n"
+"		voxelActive = fluidCriterion ? fluidActive(coords) : heatActive(coords);\n"
+"	}\n"
+"	if(voxelActive)\n"
+"	{\n"
+"		atomicOr(brickActive, 1);\n"
+"	}\n"
+"	barrier();\n"
+"	if(gl_LocalInvocationIndex == 0 && brickActive != 0)\n" // Compaction of active bricks into list
+"	{\n"
+"		uvec3 brickCount = gl_NumWorkGroups;\n"
+"		uint index = atomicAdd(numGroupsX, 1);\n"
+"		bricks[index] = gl_WorkGroupID.x + brickCount.x * (gl_WorkGroupID.y + brickCount.y * gl_WorkGroupID.z);\n"
+"	}\n"
+"}\n";
+
+#endif // BRICKMARKINGSHADER_H_
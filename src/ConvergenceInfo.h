@@ -0,0 +1,12 @@
+#ifndef CONVERGENCEINFO_H_
+#define CONVERGENCEINFO_H_
+
+// Telemetry of relaxation in last simulation step
+struct ConvergenceInfo
+{
+    int sweeps; // Performed relaxation sweeps
+    float maxUpdate; // Largest change of a voxel in last checked sweep
+    bool converged; // Largest change went below tolerance before maximum of sweeps
+};
+
+#endif // CONVERGENCEINFO_H_
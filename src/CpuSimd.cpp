@@ -0,0 +1,231 @@
+#include "CpuSimd.h"
+#include "CpuSimdRows.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace
+{
+    // Registers of width one, fallback on CPUs without any of the sets
+    struct ScalarVector
+    {
+        typedef float Register;
+        static const ptrdiff_t WIDTH = 1;
+        static Register load(const float* pValues) { return *pValues; }
+        static void store(float* pValues, Register value) { *pValues = value; }
+        static Register set(float value) { return value; }
+        static Register add(Register a, Register b) { return a + b; }
+        static Register sub(Register a, Register b) { return a - b; }
+        static Register mul(Register a, Register b) { return a * b; }
+        static Register abs(Register value) { return value < 0 ? -value : value; }
+        static Register max(Register a, Register b) { return a > b ? a : b; }
+        static float reduceMax(Register value) { return value; }
+    };
+}
+
+static float relaxHeatRowScalar(const HeatRow<float, float>& rRow)
+{
+    return relaxHeatRowWith<ScalarVector>(rRow);
+}
+
+static float relaxDiffusionRowScalar(const DiffusionRow<float, float>& rRow)
+{
+    return relaxDiffusionRowWith<ScalarVector>(rRow);
+}
+
+static const SimdRowKernels scalarRowKernels = { relaxHeatRowScalar, relaxDiffusionRowScalar };
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+
+static void cpuid(unsigned int leaf, int subleaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, (int)leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+    {
+        registers[i] = (unsigned int)values[i];
+    }
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Register states the operating system saves on context switches
+static unsigned long long xgetbv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+SimdIsa detectSimdIsa()
+{
+    unsigned int registers[4]; // eax, ebx, ecx, edx
+    cpuid(0, 0, registers);
+    unsigned int maxLeaf = registers[0];
+    if (maxLeaf < 1)
+    {
+        return SimdIsa::SCALAR;
+    }
+    cpuid(1, 0, registers);
+    bool sse42 = (registers[2] & (1u << 20)) != 0;
+    bool osxsave = (registers[2] & (1u << 27)) != 0;
+    bool avx = (registers[2] & (1u << 28)) != 0;
+
+    // Wide registers need support of the operating system
+    bool ymmState = false;
+    bool zmmState = false;
+    if (osxsave && avx)
+    {
+        unsigned long long xcr0 = xgetbv();
+        ymmState = (xcr0 & 0x6) == 0x6;
+        zmmState = (xcr0 & 0xE6) == 0xE6;
+    }
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, registers);
+        avx2 = ymmState && (registers[1] & (1u << 5)) != 0;
+        avx512 = zmmState && (registers[1] & (1u << 16)) != 0;
+    }
+
+    if (avx512)
+        return SimdIsa::AVX512;
+    else if (avx2)
+        return SimdIsa::AVX2;
+    else if (sse42)
+        return SimdIsa::SSE42;
+    else
+        return SimdIsa::SCALAR;
+}
+
+// Size of cache from the cache parameters of cpuid, which are in leaf 4 on Intel and 0x8000001D on AMD
+static size_t detectCacheSizeWithLeaf(unsigned int leaf, int level)
+{
+    unsigned int registers[4]; // eax, ebx, ecx, edx
+    for (int subleaf = 0; subleaf < 16; subleaf++)
+    {
+        cpuid(leaf, subleaf, registers);
+        unsigned int type = registers[0] & 0x1F;
+        if (type == 0)
+        {
+            break;
+        }
+        if ((type == 1 || type == 3) && (int)((registers[0] >> 5) & 0x7) == level)
+        {
+            size_t ways = ((registers[1] >> 22) & 0x3FF) + 1;
+            size_t partitions = ((registers[1] >> 12) & 0x3FF) + 1;
+            size_t lineSize = (registers[1] & 0xFFF) + 1;
+            size_t sets = (size_t)registers[2] + 1;
+            return ways * partitions * lineSize * sets;
+        }
+    }
+    return 0;
+}
+
+size_t detectCacheSize(int level)
+{
+    unsigned int registers[4];
+    cpuid(0, 0, registers);
+    if (registers[0] >= 4)
+    {
+        size_t size = detectCacheSizeWithLeaf(4, level);
+        if (size > 0)
+        {
+            return size;
+        }
+    }
+    cpuid(0x80000000, 0, registers);
+    if (registers[0] >= 0x8000001D)
+    {
+        return detectCacheSizeWithLeaf(0x8000001D, level);
+    }
+    return 0;
+}
+
+#else
+
+SimdIsa detectSimdIsa()
+{
+    return SimdIsa::SCALAR;
+}
+
+size_t detectCacheSize(int /*level*/)
+{
+    return 0;
+}
+
+#endif
+
+// Row kernels of widest set not above the given one that the build contains
+static const SimdRowKernels* selectRowKernels(SimdIsa& rIsa)
+{
+    if (rIsa >= SimdIsa::AVX512 && getAvx512RowKernels())
+    {
+        rIsa = SimdIsa::AVX512;
+        return getAvx512RowKernels();
+    }
+    if (rIsa >= SimdIsa::AVX2 && getAvx2RowKernels())
+    {
+        rIsa = SimdIsa::AVX2;
+        return getAvx2RowKernels();
+    }
+    if (rIsa >= SimdIsa::SSE42 && getSse42RowKernels())
+    {
+        rIsa = SimdIsa::SSE42;
+        return getSse42RowKernels();
+    }
+    rIsa = SimdIsa::SCALAR;
+    return &scalarRowKernels;
+}
+
+// Selected at startup
+static SimdIsa detectedIsa = detectSimdIsa();
+static SimdIsa selectedIsa = detectedIsa;
+static const SimdRowKernels* pSelectedRowKernels = selectRowKernels(selectedIsa);
+
+SimdIsa getSimdIsa()
+{
+    return selectedIsa;
+}
+
+void setSimdIsa(SimdIsa isa)
+{
+    selectedIsa = isa < detectedIsa ? isa : detectedIsa;
+    pSelectedRowKernels = selectRowKernels(selectedIsa);
+}
+
+const char* getSimdIsaName(SimdIsa isa)
+{
+    switch (isa)
+    {
+    case SimdIsa::SSE42:
+        return "SSE4.2";
+    case SimdIsa::AVX2:
+        return "AVX2";
+    case SimdIsa::AVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+float relaxVectorizedHeatRow(const HeatRow<float, float>& rRow)
+{
+    return pSelectedRowKernels->relaxHeatRow(rRow);
+}
+
+float relaxVectorizedDiffusionRow(const DiffusionRow<float, float>& rRow)
+{
+    return pSelectedRowKernels->relaxDiffusionRow(rRow);
+}
@@ -0,0 +1,30 @@
+#ifndef CPUSIMD_H_
+#define CPUSIMD_H_
+
+#include "CpuStencilRows.h"
+
+// Vector instruction sets of the CPU kernels
+enum class SimdIsa
+{
+    SCALAR, SSE42, AVX2, AVX512
+};
+
+// Row kernels of one instruction set
+struct SimdRowKernels
+{
+    float (*relaxHeatRow)(const HeatRow<float, float>& rRow);
+    float (*relaxDiffusionRow)(const DiffusionRow<float, float>& rRow);
+};
+
+SimdIsa detectSimdIsa(); // Widest set supported by CPU and operating system, queried with cpuid
+SimdIsa getSimdIsa(); // Set used by the row kernels, widest one at startup
+void setSimdIsa(SimdIsa isa); // Narrower sets for comparison, falls back to the widest available one below
+const char* getSimdIsaName(SimdIsa isa);
+size_t detectCacheSize(int level); // Bytes of data cache at level, zero when unknown
+
+// Each set lives in a translation unit compiled for it, null when the build did not enable the set there
+const SimdRowKernels* getSse42RowKernels();
+const SimdRowKernels* getAvx2RowKernels();
+const SimdRowKernels* getAvx512RowKernels();
+
+#endif // CPUSIMD_H_
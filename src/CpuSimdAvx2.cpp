@@ -0,0 +1,57 @@
+#include "CpuSimd.h"
+
+// Compiled with AVX2 enabled, see CMakeLists.txt
+#if defined(__AVX2__)
+
+#include "CpuSimdRows.h"
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx2Vector
+    {
+        typedef __m256 Register;
+        static const ptrdiff_t WIDTH = 8;
+        static Register load(const float* pValues) { return _mm256_loadu_ps(pValues); }
+        static void store(float* pValues, Register value) { _mm256_storeu_ps(pValues, value); }
+        static Register set(float value) { return _mm256_set1_ps(value); }
+        static Register add(Register a, Register b) { return _mm256_add_ps(a, b); }
+        static Register sub(Register a, Register b) { return _mm256_sub_ps(a, b); }
+        static Register mul(Register a, Register b) { return _mm256_mul_ps(a, b); }
+        static Register abs(Register value) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), value); }
+        static Register max(Register a, Register b) { return _mm256_max_ps(a, b); }
+        static float reduceMax(Register value)
+        {
+            __m128 half = _mm_max_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+            half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+            half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+            return _mm_cvtss_f32(half);
+        }
+    };
+
+    float relaxHeatRowAvx2(const HeatRow<float, float>& rRow)
+    {
+        return relaxHeatRowWith<Avx2Vector>(rRow);
+    }
+
+    float relaxDiffusionRowAvx2(const DiffusionRow<float, float>& rRow)
+    {
+        return relaxDiffusionRowWith<Avx2Vector>(rRow);
+    }
+
+    const SimdRowKernels avx2RowKernels = { relaxHeatRowAvx2, relaxDiffusionRowAvx2 };
+}
+
+const SimdRowKernels* getAvx2RowKernels()
+{
+    return &avx2RowKernels;
+}
+
+#else
+
+const SimdRowKernels* getAvx2RowKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "CpuSimd.h"
+
+// Compiled with AVX-512F enabled, see CMakeLists.txt
+#if defined(__AVX512F__)
+
+#include "CpuSimdRows.h"
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx512Vector
+    {
+        typedef __m512 Register;
+        static const ptrdiff_t WIDTH = 16;
+        static Register load(const float* pValues) { return _mm512_loadu_ps(pValues); }
+        static void store(float* pValues, Register value) { _mm512_storeu_ps(pValues, value); }
+        static Register set(float value) { return _mm512_set1_ps(value); }
+        static Register add(Register a, Register b) { return _mm512_add_ps(a, b); }
+        static Register sub(Register a, Register b) { return _mm512_sub_ps(a, b); }
+        static Register mul(Register a, Register b) { return _mm512_mul_ps(a, b); }
+        static Register abs(Register value) { return _mm512_abs_ps(value); }
+        static Register max(Register a, Register b) { return _mm512_maskz_max_ps(0xFFFF, a, b); } // Unmasked version reads undefined register in GCC 12
+        static float reduceMax(Register value)
+        {
+            // Halves through memory, as the extractions read undefined registers as well. Then as AVX2
+            alignas(64) float values[16];
+            _mm512_store_ps(values, value);
+            __m256 quarter = _mm256_max_ps(_mm256_load_ps(values), _mm256_load_ps(values + 8));
+            __m128 half = _mm_max_ps(_mm256_castps256_ps128(quarter), _mm256_extractf128_ps(quarter, 1));
+            half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+            half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+            return _mm_cvtss_f32(half);
+        }
+    };
+
+    float relaxHeatRowAvx512(const HeatRow<float, float>& rRow)
+    {
+        return relaxHeatRowWith<Avx512Vector>(rRow);
+    }
+
+    float relaxDiffusionRowAvx512(const DiffusionRow<float, float>& rRow)
+    {
+        return relaxDiffusionRowWith<Avx512Vector>(rRow);
+    }
+
+    const SimdRowKernels avx512RowKernels = { relaxHeatRowAvx512, relaxDiffusionRowAvx512 };
+}
+
+const SimdRowKernels* getAvx512RowKernels()
+{
+    return &avx512RowKernels;
+}
+
+#else
+
+const SimdRowKernels* getAvx512RowKernels()
+{
+    return nullptr;
+}
+
+#endif
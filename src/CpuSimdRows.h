@@ -0,0 +1,100 @@
+#ifndef CPUSIMDROWS_H_
+#define CPUSIMDROWS_H_
+
+#include "CpuStencilRows.h"
+
+// Row kernels written once for the registers of an instruction set. Vector provides its Register type,
+// WIDTH and the operations load, store, set, add, sub, mul, abs, max and reduceMax. Only included by the
+// translation units of the instruction sets, which must not use inline functions of other headers, as the
+// linker could pick their versions compiled for wider sets. Operations are in the order of the scalar rows,
+// so results are identical
+
+template<typename Vector>
+float relaxHeatRowWith(const HeatRow<float, float>& rRow)
+{
+    typedef typename Vector::Register Register;
+    const ptrdiff_t sy = rRow.strideY;
+    const ptrdiff_t sz = rRow.strideZ;
+    const float* pT = rRow.pTemperature;
+    const float* pX = rRow.pConductivitySumX;
+    const float* pY = rRow.pConductivitySumY;
+    const float* pZ = rRow.pConductivitySumZ;
+    Register scale = Vector::set(rRow.conductanceScale);
+    Register change = Vector::set(0.f);
+    ptrdiff_t i = 0;
+    for (; i + Vector::WIDTH <= rRow.count; i += Vector::WIDTH)
+    {
+        Register temperature = Vector::load(pT + i);
+        Register neighbors = Vector::mul(Vector::load(pX + i), Vector::load(pT + i + 1));
+        neighbors = Vector::add(neighbors, Vector::mul(Vector::load(pX + i - 1), Vector::load(pT + i - 1)));
+        neighbors = Vector::add(neighbors, Vector::mul(Vector::load(pY + i), Vector::load(pT + i + sy)));
+        neighbors = Vector::add(neighbors, Vector::mul(Vector::load(pY + i - sy), Vector::load(pT + i - sy)));
+        neighbors = Vector::add(neighbors, Vector::mul(Vector::load(pZ + i), Vector::load(pT + i + sz)));
+        neighbors = Vector::add(neighbors, Vector::mul(Vector::load(pZ + i - sz), Vector::load(pT + i - sz)));
+        Register relaxed = Vector::add(
+            Vector::mul(Vector::load(rRow.pSource + i), Vector::load(rRow.pPreviousTemperature + i)),
+            Vector::mul(scale, neighbors));
+        relaxed = Vector::mul(relaxed, Vector::load(rRow.pInverseDiagonal + i));
+        change = Vector::max(change, Vector::abs(Vector::sub(relaxed, temperature)));
+        Vector::store(rRow.pTarget + i, relaxed);
+    }
+    float result = Vector::reduceMax(change);
+
+    // Rest of the row
+    for (; i < rRow.count; i++)
+    {
+        float neighbors
+            = pX[i] * pT[i + 1]
+            + pX[i - 1] * pT[i - 1]
+            + pY[i] * pT[i + sy]
+            + pY[i - sy] * pT[i - sy]
+            + pZ[i] * pT[i + sz]
+            + pZ[i - sz] * pT[i - sz];
+        float relaxed = (rRow.pSource[i] * rRow.pPreviousTemperature[i] + rRow.conductanceScale * neighbors) * rRow.pInverseDiagonal[i];
+        float difference = relaxed - pT[i];
+        difference = difference < 0 ? -difference : difference;
+        result = difference > result ? difference : result;
+        rRow.pTarget[i] = relaxed;
+    }
+    return result;
+}
+
+template<typename Vector>
+float relaxDiffusionRowWith(const DiffusionRow<float, float>& rRow)
+{
+    typedef typename Vector::Register Register;
+    const ptrdiff_t sy = rRow.strideY;
+    const ptrdiff_t sz = rRow.strideZ;
+    const float* pV = rRow.pVelocity;
+    Register h = Vector::set(rRow.h);
+    Register normalization = Vector::set(rRow.normalization);
+    Register change = Vector::set(0.f);
+    ptrdiff_t i = 0;
+    for (; i + Vector::WIDTH <= rRow.count; i += Vector::WIDTH)
+    {
+        Register velocity = Vector::load(pV + i);
+        Register neighbors = Vector::add(Vector::load(pV + i + 1), Vector::load(pV + i - 1));
+        neighbors = Vector::add(neighbors, Vector::load(pV + i + sy));
+        neighbors = Vector::add(neighbors, Vector::load(pV + i - sy));
+        neighbors = Vector::add(neighbors, Vector::load(pV + i + sz));
+        neighbors = Vector::add(neighbors, Vector::load(pV + i - sz));
+        Register relaxed = Vector::mul(Vector::add(Vector::load(rRow.pInitialVelocity + i), Vector::mul(h, neighbors)), normalization);
+        change = Vector::max(change, Vector::abs(Vector::sub(relaxed, velocity)));
+        Vector::store(rRow.pTarget + i, relaxed);
+    }
+    float result = Vector::reduceMax(change);
+
+    // Rest of the row
+    for (; i < rRow.count; i++)
+    {
+        float neighbors = pV[i + 1] + pV[i - 1] + pV[i + sy] + pV[i - sy] + pV[i + sz] + pV[i - sz];
+        float relaxed = (rRow.pInitialVelocity[i] + rRow.h * neighbors) * rRow.normalization;
+        float difference = relaxed - pV[i];
+        difference = difference < 0 ? -difference : difference;
+        result = difference > result ? difference : result;
+        rRow.pTarget[i] = relaxed;
+    }
+    return result;
+}
+
+#endif // CPUSIMDROWS_H_
@@ -0,0 +1,56 @@
+#include "CpuSimd.h"
+
+// Compiled with SSE4.2 enabled, see CMakeLists.txt
+#if defined(__SSE4_2__) || defined(_M_X64)
+
+#include "CpuSimdRows.h"
+#include <nmmintrin.h>
+
+namespace
+{
+    struct Sse42Vector
+    {
+        typedef __m128 Register;
+        static const ptrdiff_t WIDTH = 4;
+        static Register load(const float* pValues) { return _mm_loadu_ps(pValues); }
+        static void store(float* pValues, Register value) { _mm_storeu_ps(pValues, value); }
+        static Register set(float value) { return _mm_set1_ps(value); }
+        static Register add(Register a, Register b) { return _mm_add_ps(a, b); }
+        static Register sub(Register a, Register b) { return _mm_sub_ps(a, b); }
+        static Register mul(Register a, Register b) { return _mm_mul_ps(a, b); }
+        static Register abs(Register value) { return _mm_andnot_ps(_mm_set1_ps(-0.f), value); }
+        static Register max(Register a, Register b) { return _mm_max_ps(a, b); }
+        static float reduceMax(Register value)
+        {
+            value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+            value = _mm_max_ss(value, _mm_shuffle_ps(value, value, 1));
+            return _mm_cvtss_f32(value);
+        }
+    };
+
+    float relaxHeatRowSse42(const HeatRow<float, float>& rRow)
+    {
+        return relaxHeatRowWith<Sse42Vector>(rRow);
+    }
+
+    float relaxDiffusionRowSse42(const DiffusionRow<float, float>& rRow)
+    {
+        return relaxDiffusionRowWith<Sse42Vector>(rRow);
+    }
+
+    const SimdRowKernels sse42RowKernels = { relaxHeatRowSse42, relaxDiffusionRowSse42 };
+}
+
+const SimdRowKernels* getSse42RowKernels()
+{
+    return &sse42RowKernels;
+}
+
+#else
+
+const SimdRowKernels* getSse42RowKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,176 @@
+#include "CpuSimulator.h"
+#include "TimeStepLimits.h"
+
+#include <algorithm>
+#include <cmath>
+
+CpuSimulator::CpuSimulator(Area &area, const std::vector<Fan>& rFans, FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator)
+{
+    mSimulationArea = &area;
+    mpFans = &rFans;
+    mpFluidSimulator = &fluidSimulator;
+    mpHeatSimulator = &heatSimulator;
+
+    mRelaxationSteps = 5;
+    mSweepsPerCheck = 4;
+    mFluidTolerance = 0.000001f;
+    mHeatTolerance = 0.001f;
+    mScalarType = area.getStoragePrecision() == StoragePrecision::HALF ? CpuScalarType::HALF : CpuScalarType::FLOAT;
+    mStorageLayout = StorageLayout::PLANAR;
+    mBlockSize = glm::ivec2(0);
+    mWavefrontDepth = 0;
+    mFluidConvergenceInfo = { 0, 0.f, false };
+    mHeatConvergenceInfo = { 0, 0.f, false };
+    mSubstepCount = 1;
+    mSubstepsClamped = false;
+    mStateLoaded = false;
+    mStateUploaded = true;
+
+    createKernels();
+}
+
+void CpuSimulator::createKernels()
+{
+    // State of the replaced kernels is read again from the volumes
+    upload();
+    mupKernels = createCpuKernels(*mSimulationArea, *mpFans, mScalarType, mStorageLayout);
+    mupKernels->setBlockSize(mBlockSize);
+    mupKernels->setWavefrontDepth(mWavefrontDepth);
+    mStateLoaded = false;
+}
+
+void CpuSimulator::nextStep(float dt)
+{
+    // Volumes may have been changed by others since creation
+    if (!mStateLoaded)
+    {
+        mTemperature = mSimulationArea->readTemperature();
+        mVelocity = mSimulationArea->readVelocity();
+        mupKernels->load(mTemperature, mVelocity);
+        mStateLoaded = true;
+    }
+
+    // Common time step is the one of the faster system, speed is measured by the kernels without a readback
+    float maxSpeed = mupKernels->getMaxSpeed();
+    float stableTimeStep = std::min(mpFluidSimulator->computeStableTimeStep(maxSpeed), mpHeatSimulator->computeStableTimeStep(maxSpeed));
+    mSubstepCount = countSubsteps(dt, stableTimeStep, mSubstepsClamped);
+    for (int i = 0; i < mSubstepCount; i++)
+    {
+        simulate(dt / mSubstepCount);
+    }
+    mStateUploaded = false;
+}
+
+void CpuSimulator::upload()
+{
+    // Volumes are only written when rendering, sensors or checkpoints read them
+    if (mStateLoaded && !mStateUploaded)
+    {
+        mupKernels->store(mTemperature, mVelocity);
+        mSimulationArea->writeTemperature(mTemperature);
+        mSimulationArea->writeVelocity(mVelocity);
+    }
+    mStateUploaded = true;
+}
+
+void CpuSimulator::simulate(float dt)
+{
+    CpuStepSettings settings;
+    settings.timeStep = dt;
+    settings.edgeLength = mpFluidSimulator->getMEdgeLenght();
+    settings.viscosity = mpFluidSimulator->getViscosity();
+    settings.conductanceScale = mpHeatSimulator->getConductanceScale();
+    settings.relaxationSteps = mRelaxationSteps;
+    settings.sweepsPerCheck = mSweepsPerCheck;
+    settings.fluidTolerance = mFluidTolerance;
+    settings.heatTolerance = mHeatTolerance;
+    mupKernels->simulate(settings, mFluidConvergenceInfo, mHeatConvergenceInfo);
+}
+
+int CpuSimulator::getSubstepCount() const
+{
+    return mSubstepCount;
+}
+
+void CpuSimulator::setRelaxationSteps(int steps)
+{
+    if (steps > 0)
+        mRelaxationSteps = steps;
+    else
+        mRelaxationSteps = 5;
+}
+
+void CpuSimulator::setSweepsPerCheck(int sweeps)
+{
+    if (sweeps > 0)
+        mSweepsPerCheck = sweeps;
+    else
+        mSweepsPerCheck = 4;
+}
+
+void CpuSimulator::setFluidTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mFluidTolerance = tolerance;
+    else
+        mFluidTolerance = 0.000001f;
+}
+
+void CpuSimulator::setHeatTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mHeatTolerance = tolerance;
+    else
+        mHeatTolerance = 0.001f;
+}
+
+void CpuSimulator::setScalarType(CpuScalarType type)
+{
+    if (type != mScalarType)
+    {
+        mScalarType = type;
+        createKernels();
+    }
+}
+
+void CpuSimulator::setStorageLayout(StorageLayout layout)
+{
+    if (layout != mStorageLayout)
+    {
+        mStorageLayout = layout;
+        createKernels();
+    }
+}
+
+void CpuSimulator::setBlockSize(int width, int height)
+{
+    if (width > 0 && height > 0)
+        mBlockSize = glm::ivec2(width, height);
+    else
+        mBlockSize = glm::ivec2(0);
+    mupKernels->setBlockSize(mBlockSize);
+}
+
+glm::ivec2 CpuSimulator::getBlockSize() const
+{
+    return mupKernels->getBlockSize();
+}
+
+void CpuSimulator::setWavefrontDepth(int sweeps)
+{
+    if (sweeps > 0)
+        mWavefrontDepth = sweeps;
+    else
+        mWavefrontDepth = 0;
+    mupKernels->setWavefrontDepth(mWavefrontDepth);
+}
+
+ConvergenceInfo CpuSimulator::getFluidConvergenceInfo() const
+{
+    return mFluidConvergenceInfo;
+}
+
+ConvergenceInfo CpuSimulator::getHeatConvergenceInfo() const
+{
+    return mHeatConvergenceInfo;
+}
@@ -0,0 +1,66 @@
+#ifndef CPUSIMULATOR_H_
+#define CPUSIMULATOR_H_
+
+#include "Area.h"
+#include "Fan.h"
+#include "FluidSimulator.h"
+#include "HeatSimulator.h"
+#include "CpuStencilKernels.h"
+#include "ConvergenceInfo.h"
+#include <vector>
+#include <memory>
+
+// Advances fluid and heat simulation on the CPU with the discretization of the fused simulation. Kernels are
+// specialized at compile time for scalar type, layout of velocity and the features present in the area, so their
+// inner loops do not branch on settings. State is read back from the volumes before the first step and written
+// to them by upload, only when rendering, sensors or checkpoints need it. Settings like edge length and stable
+// time steps are taken from the GPU simulators, the speed that limits the step is measured by the kernels
+class CpuSimulator
+{
+public:
+    CpuSimulator(Area &area, const std::vector<Fan>& rFans, FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator);
+
+    void nextStep(float dt);
+    void upload(); // Writes state to the volumes if it changed since the last upload
+    void simulate(float dt);
+    int getSubstepCount() const;
+    void setRelaxationSteps(int steps); // Maximum of sweeps per step
+    void setSweepsPerCheck(int sweeps);
+    void setFluidTolerance(float tolerance);
+    void setHeatTolerance(float tolerance);
+    void setScalarType(CpuScalarType type); // State is read again from the volumes
+    void setStorageLayout(StorageLayout layout);
+    void setBlockSize(int width, int height); // Rows of sweeps in x and y, zero chooses them from the cache size
+    glm::ivec2 getBlockSize() const;
+    void setWavefrontDepth(int sweeps); // Sweeps relaxed in one pass through the box, zero chooses them from the cache size
+    ConvergenceInfo getFluidConvergenceInfo() const;
+    ConvergenceInfo getHeatConvergenceInfo() const;
+
+private:
+    void createKernels();
+
+    int mRelaxationSteps;
+    int mSweepsPerCheck;
+    float mFluidTolerance;
+    float mHeatTolerance;
+    CpuScalarType mScalarType;
+    StorageLayout mStorageLayout;
+    glm::ivec2 mBlockSize;
+    int mWavefrontDepth;
+    ConvergenceInfo mFluidConvergenceInfo;
+    ConvergenceInfo mHeatConvergenceInfo;
+    int mSubstepCount;
+    bool mSubstepsClamped;
+    bool mStateLoaded;
+    bool mStateUploaded;
+
+    Area* mSimulationArea;
+    const std::vector<Fan>* mpFans;
+    FluidSimulator* mpFluidSimulator;
+    HeatSimulator* mpHeatSimulator;
+    std::unique_ptr<CpuKernels> mupKernels;
+    std::vector<float> mTemperature; // Whole volumes for upload
+    std::vector<float> mVelocity;
+};
+
+#endif // CPUSIMULATOR_H_
@@ -0,0 +1,68 @@
+#include "CpuStencilKernels.h"
+
+// Runtime flags are turned into template arguments one after another
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS>
+static CpuKernels* createWithHeaters(Area& area, const std::vector<Fan>& rFans, bool hasHeaters)
+{
+    if (hasHeaters)
+        return new SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, true>(area, rFans);
+    else
+        return new SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, false>(area, rFans);
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID>
+static CpuKernels* createWithFans(Area& area, const std::vector<Fan>& rFans, bool hasFans, bool hasHeaters)
+{
+    if (hasFans)
+        return createWithHeaters<Scalar, LAYOUT, HAS_FLUID, true>(area, rFans, hasHeaters);
+    else
+        return createWithHeaters<Scalar, LAYOUT, HAS_FLUID, false>(area, rFans, hasHeaters);
+}
+
+template<typename Scalar, StorageLayout LAYOUT>
+static CpuKernels* createWithFluid(Area& area, const std::vector<Fan>& rFans, bool hasFluid, bool hasHeaters)
+{
+    // Fans only act on fluid
+    if (hasFluid)
+        return createWithFans<Scalar, LAYOUT, true>(area, rFans, !rFans.empty(), hasHeaters);
+    else
+        return createWithFans<Scalar, LAYOUT, false>(area, rFans, false, hasHeaters);
+}
+
+template<typename Scalar>
+static CpuKernels* createWithLayout(Area& area, const std::vector<Fan>& rFans, StorageLayout layout, bool hasFluid, bool hasHeaters)
+{
+    if (layout == StorageLayout::PLANAR)
+        return createWithFluid<Scalar, StorageLayout::PLANAR>(area, rFans, hasFluid, hasHeaters);
+    else
+        return createWithFluid<Scalar, StorageLayout::INTERLEAVED>(area, rFans, hasFluid, hasHeaters);
+}
+
+std::unique_ptr<CpuKernels> createCpuKernels(Area& area, const std::vector<Fan>& rFans, CpuScalarType scalarType, StorageLayout layout)
+{
+    // Features of the materials inside of the simulation box
+    bool hasFluid = false;
+    bool hasHeaters = false;
+    for (Materialtype type : area.getPresentMaterials())
+    {
+        Material material = area.determineMaterial(type);
+        hasFluid |= material.cisf.w > 0;
+        hasHeaters |= material.cisf.y > 0;
+    }
+
+    CpuKernels* pKernels;
+    switch (scalarType)
+    {
+    case CpuScalarType::DOUBLE:
+        pKernels = createWithLayout<double>(area, rFans, layout, hasFluid, hasHeaters);
+        break;
+    case CpuScalarType::HALF:
+        pKernels = createWithLayout<HalfScalar>(area, rFans, layout, hasFluid, hasHeaters);
+        break;
+    default:
+        pKernels = createWithLayout<float>(area, rFans, layout, hasFluid, hasHeaters);
+        break;
+    }
+    return std::unique_ptr<CpuKernels>(pKernels);
+}
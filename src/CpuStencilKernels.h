@@ -0,0 +1,901 @@
+#ifndef CPUSTENCILKERNELS_H_
+#define CPUSTENCILKERNELS_H_
+
+#include "Area.h"
+#include "Fan.h"
+#include "Half.h"
+#include "ConvergenceInfo.h"
+#include "CpuStencilRows.h"
+#include "CpuSimd.h"
+#include "VolumeArena.h"
+#include "externals/GLM/glm/glm.hpp"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Scalar type in which the CPU kernels store temperature and velocity
+enum class CpuScalarType
+{
+    FLOAT, DOUBLE, HALF
+};
+
+// Arrangement of velocity components in memory
+enum class StorageLayout
+{
+    PLANAR, // One block per component, so rows of a component are contiguous
+    INTERLEAVED // Components of a voxel next to each other like in the volume
+};
+
+// Settings of one step, taken from the GPU simulators
+struct CpuStepSettings
+{
+    float timeStep;
+    float edgeLength;
+    float viscosity;
+    float conductanceScale;
+    int relaxationSteps;
+    int sweepsPerCheck;
+    float fluidTolerance;
+    float heatTolerance;
+};
+
+// Kernels of one specialization, which is selected once per area
+class CpuKernels
+{
+public:
+    virtual ~CpuKernels() {}
+
+    virtual void load(const std::vector<float>& rTemperature, const std::vector<float>& rVelocity) = 0; // Volumes as read from area
+    virtual void store(std::vector<float>& rTemperature, std::vector<float>& rVelocity) const = 0; // Writes simulation box only
+    virtual void simulate(const CpuStepSettings& rSettings, ConvergenceInfo& rFluidInfo, ConvergenceInfo& rHeatInfo) = 0;
+    virtual void setBlockSize(const glm::ivec2& rSize) = 0; // Zero chooses size from cache
+    virtual glm::ivec2 getBlockSize() const = 0;
+    virtual void setWavefrontDepth(int sweeps) = 0; // Zero chooses depth from cache, one sweeps separately
+    virtual float getMaxSpeed() const = 0; // Of the velocity after the last step or load, at least the speed of the fans
+};
+
+// Kernels for scalar type, layout and the features present in area and fans
+std::unique_ptr<CpuKernels> createCpuKernels(Area& area, const std::vector<Fan>& rFans, CpuScalarType scalarType, StorageLayout layout);
+
+// Tag of 16 bit storage
+struct HalfScalar {};
+
+// Storage of scalar types, arithmetic of halfs is done in 32 bit like on the GPU
+template<typename Scalar>
+struct ScalarStorage
+{
+    typedef Scalar Type;
+    typedef Scalar Arithmetic;
+    static Arithmetic load(Type value) { return value; }
+    static Type store(Arithmetic value) { return value; }
+};
+
+template<>
+struct ScalarStorage<HalfScalar>
+{
+    typedef uint16_t Type;
+    typedef float Arithmetic;
+    static float load(uint16_t value) { return halfToFloat(value); }
+    static uint16_t store(float value) { return floatToHalf(value); }
+};
+
+// Index of velocity component
+template<StorageLayout LAYOUT>
+struct ComponentIndex
+{
+    static size_t get(size_t voxel, int component, size_t voxelCount) { return (size_t)component * voxelCount + voxel; }
+};
+
+template<>
+struct ComponentIndex<StorageLayout::INTERLEAVED>
+{
+    static size_t get(size_t voxel, int component, size_t /*voxelCount*/) { return 3 * voxel + (size_t)component; }
+};
+
+// Rows of other scalar types than 32 bit floats stay scalar
+template<typename Stored, typename Real>
+struct VectorizedRows
+{
+    static const bool SUPPORTED = false;
+    static Real relaxHeatRow(const HeatRow<Stored, Real>& /*rRow*/) { return 0; }
+    static Real relaxDiffusionRow(const DiffusionRow<Stored, Real>& /*rRow*/) { return 0; }
+};
+
+template<>
+struct VectorizedRows<float, float>
+{
+    static const bool SUPPORTED = true;
+    static float relaxHeatRow(const HeatRow<float, float>& rRow) { return relaxVectorizedHeatRow(rRow); }
+    static float relaxDiffusionRow(const DiffusionRow<float, float>& rRow) { return relaxVectorizedDiffusionRow(rRow); }
+};
+
+// Same discretization as the fused GPU simulation: forces, implicit conduction of heat and diffusion of velocity,
+// heaters, limitation and collision with solids. Sweeps are Jacobi iterations between two buffers and transport
+// is semi-Lagrangian. Fields cover the simulation box with one voxel of halo, which keeps the values of the
+// volumes around the box, so neighbors are read without any test. Features that are absent in the area
+// are removed at compile time
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+class SpecializedCpuKernels : public CpuKernels
+{
+public:
+    SpecializedCpuKernels(Area& area, const std::vector<Fan>& rFans);
+
+    void load(const std::vector<float>& rTemperature, const std::vector<float>& rVelocity);
+    void store(std::vector<float>& rTemperature, std::vector<float>& rVelocity) const;
+    void simulate(const CpuStepSettings& rSettings, ConvergenceInfo& rFluidInfo, ConvergenceInfo& rHeatInfo);
+    void setBlockSize(const glm::ivec2& rSize);
+    glm::ivec2 getBlockSize() const;
+    void setWavefrontDepth(int sweeps);
+    float getMaxSpeed() const { return mMaxSpeed; }
+
+private:
+    typedef ScalarStorage<Scalar> Storage;
+    typedef typename Storage::Type Stored;
+    typedef typename Storage::Arithmetic Real;
+
+    struct FanState
+    {
+        glm::vec3 position;
+        float speed;
+        glm::vec3 direction;
+    };
+
+    size_t getIndex(int x, int y, int z) const { return (size_t)x + mStrideY * (size_t)y + mStrideZ * (size_t)z; }
+    size_t getComponent(size_t voxel, int component) const { return ComponentIndex<LAYOUT>::get(voxel, component, mVoxelCount); }
+    int getVolumeIndex(int x, int y, int z) const; // Of padded coordinates, -1 outside of volume
+    Real sample(const VolumeVector<Stored>& rField, size_t first, size_t step, const glm::vec3& rPosition) const; // Values at first + step * voxel
+    Real sampleComponent(const VolumeVector<Stored>& rField, int component, const glm::vec3& rPosition) const;
+    glm::vec3 sampleVelocity(const glm::vec3& rPosition) const;
+    void advect(const CpuStepSettings& rSettings);
+    void applyForces(const CpuStepSettings& rSettings);
+    void prepareRelaxation(const CpuStepSettings& rSettings);
+    int getWavefrontDepth(int sweeps, size_t bytesPerVoxel) const; // Sweeps that share a pass through the box
+    Real relaxHeat(const CpuStepSettings& rSettings, int sweeps); // Returns change of last sweep
+    Real relaxHeatBlock(HeatRow<Stored, Real>& rRow, const Stored* pSource, Stored* pTarget, int z, const glm::ivec2& rBegin, const glm::ivec2& rEnd) const;
+    Real relaxHeatRow(const HeatRow<Stored, Real>& rRow) const;
+    Real relaxFluid(const CpuStepSettings& rSettings, int sweeps);
+    Real relaxDiffusionBlock(DiffusionRow<Stored, Real>& rRow, const Stored* pSource, Stored* pTarget, int component, int z, const glm::ivec2& rBegin, const glm::ivec2& rEnd) const;
+    Real relaxDiffusionRow(const DiffusionRow<Stored, Real>& rRow) const;
+    void finishStep();
+
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mExtent; // Inner voxels
+    int mResolution;
+    size_t mStrideY;
+    size_t mStrideZ;
+    size_t mVoxelCount; // Including halo
+    glm::ivec2 mBlockSize; // Sweeps stream along z through blocks of rows
+    int mWavefrontDepth; // Zero chooses depth from cache
+    size_t mCacheSize; // Of level two
+    size_t mLastLevelCacheSize;
+    std::vector<FanState> mFans;
+    float mMaxFanSpeed;
+    float mMaxSpeed; // Measured while the velocity is limited, so no extra pass is needed
+
+    // Fields on huge pages, halo is equal in both buffers and never written
+    VolumeVector<Stored> mTemperature;
+    VolumeVector<Stored> mTemperatureBack;
+    VolumeVector<Stored> mPreviousTemperature;
+    VolumeVector<Stored> mVelocity;
+    VolumeVector<Stored> mVelocityBack;
+    VolumeVector<Stored> mInitialVelocity;
+
+    // Coefficients of materials
+    VolumeVector<float> mCapacity; // Specific heat times density
+    VolumeVector<float> mConductivitySumX; // Of voxel and its neighbor in positive direction
+    VolumeVector<float> mConductivitySumY;
+    VolumeVector<float> mConductivitySumZ;
+    VolumeVector<float> mInternalHeat;
+    VolumeVector<unsigned char> mFluid;
+
+    // Of current time step
+    VolumeVector<Real> mSource;
+    VolumeVector<Real> mInverseDiagonal;
+};
+
+// Consts, same as in the GPU simulations
+const float CPU_THERMAL_EXPANSION_COEFFICIENT = 0.00025f;
+const float CPU_VELOCITY_LIMITATION = 0.07f;
+
+// Blocking of sweeps when the cache size is unknown
+const size_t DEFAULT_CACHE_SIZE = 256 * 1024;
+const int MIN_BLOCK_ROWS = 8;
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::SpecializedCpuKernels(Area& area, const std::vector<Fan>& rFans)
+{
+    mBoxMin = area.getSimulationBoxMin();
+    mExtent = area.getSimulationBoxMax() - mBoxMin;
+    mResolution = area.getResolution();
+    glm::ivec3 padded = mExtent + 2;
+    mStrideY = (size_t)padded.x;
+    mStrideZ = (size_t)padded.x * (size_t)padded.y;
+    mVoxelCount = mStrideZ * (size_t)padded.z;
+
+    mMaxFanSpeed = 0.f;
+    if (HAS_FANS)
+    {
+        for (const Fan& rFan : rFans)
+        {
+            FanState fan = { rFan.getPosition(), rFan.getSpeed(), rFan.getDirection() };
+            mFans.push_back(fan);
+            mMaxFanSpeed = std::max(mMaxFanSpeed, rFan.getSpeed() * glm::length(rFan.getDirection()));
+        }
+    }
+    mMaxSpeed = mMaxFanSpeed;
+
+    // Outside of the volume the GPU reads lookup zero
+    Material* pMaterials = area.getMaterialData();
+    Material outside = area.determineMaterial(area.getMaterialList()[0]);
+    std::vector<float> conductivity(mVoxelCount);
+    mCapacity.resize(mVoxelCount);
+    mInternalHeat.resize(mVoxelCount);
+    mFluid.resize(mVoxelCount);
+    for (int z = 0; z < padded.z; z++)
+    {
+        for (int y = 0; y < padded.y; y++)
+        {
+            for (int x = 0; x < padded.x; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                int volumeIndex = getVolumeIndex(x, y, z);
+                const Material& rMaterial = volumeIndex >= 0 ? pMaterials[volumeIndex] : outside;
+                conductivity[i] = rMaterial.cisf.x;
+                mCapacity[i] = rMaterial.cisf.z * rMaterial.dppp.x;
+                mInternalHeat[i] = rMaterial.cisf.y;
+                mFluid[i] = volumeIndex >= 0 && rMaterial.cisf.w > 0;
+            }
+        }
+    }
+
+    // Conductances are symmetric, so each pair of neighbors is stored once
+    mConductivitySumX.assign(mVoxelCount, 0.f);
+    mConductivitySumY.assign(mVoxelCount, 0.f);
+    mConductivitySumZ.assign(mVoxelCount, 0.f);
+    for (size_t i = 0; i + mStrideZ < mVoxelCount; i++)
+    {
+        mConductivitySumX[i] = conductivity[i] + conductivity[i + 1];
+        mConductivitySumY[i] = conductivity[i] + conductivity[i + mStrideY];
+        mConductivitySumZ[i] = conductivity[i] + conductivity[i + mStrideZ];
+    }
+
+    mTemperature.assign(mVoxelCount, Storage::store(0));
+    mTemperatureBack = mTemperature;
+    mPreviousTemperature = mTemperature;
+    mVelocity.assign(3 * mVoxelCount, Storage::store(0));
+    mVelocityBack = mVelocity;
+    mInitialVelocity = mVelocity;
+    mSource.resize(mVoxelCount);
+    mInverseDiagonal.resize(mVoxelCount);
+
+    mCacheSize = detectCacheSize(2);
+    if (mCacheSize == 0)
+    {
+        mCacheSize = DEFAULT_CACHE_SIZE;
+    }
+    mLastLevelCacheSize = std::max(detectCacheSize(3), mCacheSize);
+    setBlockSize(glm::ivec2(0));
+    setWavefrontDepth(0);
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::setBlockSize(const glm::ivec2& rSize)
+{
+    if (rSize.x > 0 && rSize.y > 0)
+    {
+        mBlockSize = glm::min(rSize, glm::ivec2(mExtent));
+        return;
+    }
+
+    // Conduction keeps three planes of temperature and two of conductivities in z of a block in cache,
+    // which should take about half of the cache, as the other fields stream through it
+    size_t bytesPerColumn = 3 * sizeof(Stored) + 2 * sizeof(float);
+    int columns = (int)std::max(mCacheSize / 2 / bytesPerColumn, (size_t)64);
+    if (columns >= mExtent.x * mExtent.y)
+    {
+        // Whole planes fit
+        mBlockSize = glm::ivec2(mExtent.x, mExtent.y);
+    }
+    else if (columns >= mExtent.x * MIN_BLOCK_ROWS)
+    {
+        // Full rows keep rows long for the vector kernels
+        mBlockSize = glm::ivec2(mExtent.x, columns / mExtent.x);
+    }
+    else
+    {
+        // Rows are split into multiples of the widest vector
+        int width = std::max(columns / MIN_BLOCK_ROWS / 16 * 16, 16);
+        mBlockSize = glm::ivec2(std::min(width, mExtent.x), std::min(columns / width, mExtent.y));
+    }
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+glm::ivec2 SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::getBlockSize() const
+{
+    return mBlockSize;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::setWavefrontDepth(int sweeps)
+{
+    if (sweeps > 0)
+        mWavefrontDepth = sweeps;
+    else
+        mWavefrontDepth = 0;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+int SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::getVolumeIndex(int x, int y, int z) const
+{
+    glm::ivec3 coords = mBoxMin - 1 + glm::ivec3(x, y, z);
+    if (glm::any(glm::lessThan(coords, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(coords, glm::ivec3(mResolution))))
+    {
+        return -1;
+    }
+    return coords.x + coords.y * mResolution + coords.z * mResolution * mResolution;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::load(const std::vector<float>& rTemperature, const std::vector<float>& rVelocity)
+{
+    // Image loads outside of the volume return zero
+    Real maxSquaredSpeed = 0;
+    for (int z = 0; z < mExtent.z + 2; z++)
+    {
+        for (int y = 0; y < mExtent.y + 2; y++)
+        {
+            for (int x = 0; x < mExtent.x + 2; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                int volumeIndex = getVolumeIndex(x, y, z);
+                mTemperature[i] = Storage::store(volumeIndex >= 0 ? (Real)rTemperature[volumeIndex] : 0);
+                Real squaredSpeed = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    Real velocity = volumeIndex >= 0 ? (Real)rVelocity[4 * volumeIndex + c] : 0;
+                    mVelocity[getComponent(i, c)] = Storage::store(velocity);
+                    squaredSpeed += velocity * velocity;
+                }
+                maxSquaredSpeed = std::max(maxSquaredSpeed, squaredSpeed);
+            }
+        }
+    }
+    mTemperatureBack = mTemperature;
+    mVelocityBack = mVelocity;
+    mMaxSpeed = std::max((float)std::sqrt(maxSquaredSpeed), mMaxFanSpeed);
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::store(std::vector<float>& rTemperature, std::vector<float>& rVelocity) const
+{
+    for (int z = 1; z <= mExtent.z; z++)
+    {
+        for (int y = 1; y <= mExtent.y; y++)
+        {
+            for (int x = 1; x <= mExtent.x; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                int volumeIndex = getVolumeIndex(x, y, z);
+                rTemperature[volumeIndex] = (float)Storage::load(mTemperature[i]);
+                for (int c = 0; c < 3; c++)
+                {
+                    rVelocity[4 * volumeIndex + c] = (float)Storage::load(mVelocity[getComponent(i, c)]);
+                }
+            }
+        }
+    }
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::simulate(const CpuStepSettings& rSettings, ConvergenceInfo& rFluidInfo, ConvergenceInfo& rHeatInfo)
+{
+    // Transport before the implicit part
+    if (HAS_FLUID)
+    {
+        advect(rSettings);
+    }
+    applyForces(rSettings);
+    prepareRelaxation(rSettings);
+
+    // Each system is relaxed until its own tolerance is reached
+    rFluidInfo = { 0, 0.f, !HAS_FLUID };
+    rHeatInfo = { 0, 0.f, false };
+    while ((!rFluidInfo.converged && rFluidInfo.sweeps < rSettings.relaxationSteps) || (!rHeatInfo.converged && rHeatInfo.sweeps < rSettings.relaxationSteps))
+    {
+        if (!rHeatInfo.converged && rHeatInfo.sweeps < rSettings.relaxationSteps)
+        {
+            int sweeps = std::min(rSettings.sweepsPerCheck, rSettings.relaxationSteps - rHeatInfo.sweeps);
+            rHeatInfo.maxUpdate = (float)relaxHeat(rSettings, sweeps);
+            rHeatInfo.sweeps += sweeps;
+            rHeatInfo.converged = rHeatInfo.maxUpdate <= rSettings.heatTolerance;
+        }
+        if (HAS_FLUID && !rFluidInfo.converged && rFluidInfo.sweeps < rSettings.relaxationSteps)
+        {
+            int sweeps = std::min(rSettings.sweepsPerCheck, rSettings.relaxationSteps - rFluidInfo.sweeps);
+            rFluidInfo.maxUpdate = (float)relaxFluid(rSettings, sweeps);
+            rFluidInfo.sweeps += sweeps;
+            rFluidInfo.converged = rFluidInfo.maxUpdate <= rSettings.fluidTolerance;
+        }
+    }
+
+    finishStep();
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::sample(const VolumeVector<Stored>& rField, size_t first, size_t step, const glm::vec3& rPosition) const
+{
+    // Trilinear between voxel centers, positions outside of box and halo are clamped
+    glm::vec3 maxBase = glm::vec3(mExtent);
+    glm::vec3 shifted = glm::clamp(rPosition - 0.5f, glm::vec3(0), maxBase + 1.f);
+    glm::vec3 base = glm::min(glm::floor(shifted), maxBase);
+    glm::vec3 weight = shifted - base;
+    size_t i = getIndex((int)base.x, (int)base.y, (int)base.z);
+    Real value = 0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        int dx = corner & 1;
+        int dy = (corner >> 1) & 1;
+        int dz = (corner >> 2) & 1;
+        Real cornerWeight
+            = (Real)(dx ? weight.x : 1.f - weight.x)
+            * (Real)(dy ? weight.y : 1.f - weight.y)
+            * (Real)(dz ? weight.z : 1.f - weight.z);
+        value += cornerWeight * Storage::load(rField[first + step * (i + dx + dy * mStrideY + dz * mStrideZ)]);
+    }
+    return value;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::sampleComponent(const VolumeVector<Stored>& rField, int component, const glm::vec3& rPosition) const
+{
+    size_t first = getComponent(0, component);
+    return sample(rField, first, getComponent(1, component) - first, rPosition);
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+glm::vec3 SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::sampleVelocity(const glm::vec3& rPosition) const
+{
+    return glm::vec3(
+        (float)sampleComponent(mVelocity, 0, rPosition),
+        (float)sampleComponent(mVelocity, 1, rPosition),
+        (float)sampleComponent(mVelocity, 2, rPosition));
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::advect(const CpuStepSettings& rSettings)
+{
+    // Velocity first, temperature follows along transported velocity like with the advectors
+    float scale = rSettings.timeStep / rSettings.edgeLength;
+    for (int field = 0; field < 2; field++)
+    {
+        for (int z = 1; z <= mExtent.z; z++)
+        {
+            for (int y = 1; y <= mExtent.y; y++)
+            {
+                for (int x = 1; x <= mExtent.x; x++)
+                {
+                    size_t i = getIndex(x, y, z);
+                    if (!mFluid[i])
+                    {
+                        // Only fluid is transported
+                        if (field == 0)
+                        {
+                            for (int c = 0; c < 3; c++)
+                            {
+                                mVelocityBack[getComponent(i, c)] = mVelocity[getComponent(i, c)];
+                            }
+                        }
+                        else
+                        {
+                            mTemperatureBack[i] = mTemperature[i];
+                        }
+                        continue;
+                    }
+
+                    // Midpoint rule in voxel units
+                    glm::vec3 position = glm::vec3(x, y, z) + 0.5f;
+                    glm::vec3 midpoint = position - 0.5f * scale * sampleVelocity(position);
+                    glm::vec3 origin = position - scale * sampleVelocity(midpoint);
+                    if (field == 0)
+                    {
+                        for (int c = 0; c < 3; c++)
+                        {
+                            mVelocityBack[getComponent(i, c)] = Storage::store(sampleComponent(mVelocity, c, origin));
+                        }
+                    }
+                    else
+                    {
+                        mTemperatureBack[i] = Storage::store(sample(mTemperature, 0, 1, origin));
+                    }
+                }
+            }
+        }
+        if (field == 0)
+        {
+            mVelocity.swap(mVelocityBack);
+        }
+        else
+        {
+            mTemperature.swap(mTemperatureBack);
+        }
+    }
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::applyForces(const CpuStepSettings& rSettings)
+{
+    // Fans and upthrust, then both fields are saved as start of the implicit step
+    Real upthrust = (Real)(CPU_THERMAL_EXPANSION_COEFFICIENT * rSettings.timeStep);
+    for (int z = 1; z <= mExtent.z; z++)
+    {
+        for (int y = 1; y <= mExtent.y; y++)
+        {
+            for (int x = 1; x <= mExtent.x; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                mPreviousTemperature[i] = mTemperature[i];
+                if (HAS_FLUID)
+                {
+                    glm::vec3 velocity(
+                        (float)Storage::load(mVelocity[getComponent(i, 0)]),
+                        (float)Storage::load(mVelocity[getComponent(i, 1)]),
+                        (float)Storage::load(mVelocity[getComponent(i, 2)]));
+                    if (HAS_FANS)
+                    {
+                        // Strongest wind wins against the velocity
+                        glm::vec3 relCoords = glm::vec3(mBoxMin - 1 + glm::ivec3(x, y, z)) / (float)mResolution;
+                        for (const FanState& rFan : mFans)
+                        {
+                            float inFront = std::max(0.f, glm::sign(glm::dot(relCoords - rFan.position, rFan.direction)));
+                            float distanceFalloff = 1.f - glm::clamp(glm::length(relCoords - rFan.position) / 0.2f, 0.f, 1.f);
+                            glm::vec3 wind = distanceFalloff * inFront * rFan.direction * rFan.speed;
+                            velocity = glm::length(wind) > glm::length(velocity) ? wind : velocity;
+                        }
+                    }
+                    velocity.y += (float)(upthrust * Storage::load(mTemperature[i]));
+                    for (int c = 0; c < 3; c++)
+                    {
+                        mVelocity[getComponent(i, c)] = Storage::store((Real)velocity[c]);
+                        mInitialVelocity[getComponent(i, c)] = mVelocity[getComponent(i, c)];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::prepareRelaxation(const CpuStepSettings& rSettings)
+{
+    // Diagonal of conduction depends on time step only, so it is inverted once per step
+    Real invTimeStep = (Real)1 / (Real)rSettings.timeStep;
+    Real conductanceScale = (Real)rSettings.conductanceScale;
+    for (size_t i = mStrideZ; i + mStrideZ < mVoxelCount; i++)
+    {
+        Real conductances
+            = (Real)mConductivitySumX[i] + (Real)mConductivitySumX[i - 1]
+            + (Real)mConductivitySumY[i] + (Real)mConductivitySumY[i - mStrideY]
+            + (Real)mConductivitySumZ[i] + (Real)mConductivitySumZ[i - mStrideZ];
+        mSource[i] = (Real)mCapacity[i] * invTimeStep;
+        mInverseDiagonal[i] = (Real)1 / (mSource[i] + conductanceScale * conductances);
+    }
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+int SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::getWavefrontDepth(int sweeps, size_t bytesPerVoxel) const
+{
+    if (mWavefrontDepth > 0)
+    {
+        return std::min(mWavefrontDepth, sweeps);
+    }
+
+    // A wavefront of depth d touches d + 2 planes of each field, which should take about half of the
+    // last level cache so they are read from memory only once
+    size_t planeSize = mStrideZ * bytesPerVoxel;
+    int planes = (int)(mLastLevelCacheSize / 2 / planeSize);
+    return std::max(std::min(planes - 2, sweeps), 1);
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxHeat(const CpuStepSettings& rSettings, int sweeps)
+{
+    // Jacobi sweeps over rows of the box
+    HeatRow<Stored, Real> row;
+    row.strideY = (ptrdiff_t)mStrideY;
+    row.strideZ = (ptrdiff_t)mStrideZ;
+    row.conductanceScale = (Real)rSettings.conductanceScale;
+    size_t bytesPerVoxel = 3 * sizeof(Stored) + 3 * sizeof(float) + 2 * sizeof(Real);
+    int depth = getWavefrontDepth(sweeps, bytesPerVoxel);
+    Real change = 0;
+    for (int done = 0; done < sweeps; done += depth)
+    {
+        int batch = std::min(depth, sweeps - done);
+        change = 0;
+        if (batch == 1)
+        {
+            // Blocks of rows are streamed along z, so planes of a block are still in cache when the next
+            // plane needs them as neighbors
+            for (int blockY = 1; blockY <= mExtent.y; blockY += mBlockSize.y)
+            {
+                for (int blockX = 1; blockX <= mExtent.x; blockX += mBlockSize.x)
+                {
+                    glm::ivec2 begin(blockX, blockY);
+                    glm::ivec2 end = glm::min(begin + mBlockSize, glm::ivec2(mExtent.x, mExtent.y) + 1);
+                    for (int z = 1; z <= mExtent.z; z++)
+                    {
+                        change = std::max(change, relaxHeatBlock(row, mTemperature.data(), mTemperatureBack.data(), z, begin, end));
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Wavefront along z, sweep t relaxes the plane behind the one of sweep t - 1. Its neighbor planes
+            // are complete in iterate t - 1 then, while iterate t - 2 in its target plane is not read anymore,
+            // so two buffers suffice and results equal separate sweeps
+            Stored* buffers[2] = { mTemperature.data(), mTemperatureBack.data() };
+            glm::ivec2 begin(1);
+            glm::ivec2 end = glm::ivec2(mExtent.x, mExtent.y) + 1;
+            for (int wave = 1; wave < mExtent.z + batch; wave++)
+            {
+                for (int t = 0; t < batch; t++)
+                {
+                    int z = wave - t;
+                    if (z >= 1 && z <= mExtent.z)
+                    {
+                        Real planeChange = relaxHeatBlock(row, buffers[t % 2], buffers[(t + 1) % 2], z, begin, end);
+                        if (t == batch - 1)
+                        {
+                            change = std::max(change, planeChange);
+                        }
+                    }
+                }
+            }
+        }
+        if (batch % 2 == 1)
+        {
+            mTemperature.swap(mTemperatureBack);
+        }
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxHeatBlock(
+    HeatRow<Stored, Real>& rRow, const Stored* pSource, Stored* pTarget, int z, const glm::ivec2& rBegin, const glm::ivec2& rEnd) const
+{
+    // Rows of block in plane z from source into target buffer, returns largest change
+    typedef VectorizedRows<Stored, Real> Vectorized;
+    rRow.count = rEnd.x - rBegin.x;
+    Real change = 0;
+    for (int y = rBegin.y; y < rEnd.y; y++)
+    {
+        size_t first = getIndex(rBegin.x, y, z);
+        rRow.pTemperature = pSource + first;
+        rRow.pPreviousTemperature = mPreviousTemperature.data() + first;
+        rRow.pConductivitySumX = mConductivitySumX.data() + first;
+        rRow.pConductivitySumY = mConductivitySumY.data() + first;
+        rRow.pConductivitySumZ = mConductivitySumZ.data() + first;
+        rRow.pSource = mSource.data() + first;
+        rRow.pInverseDiagonal = mInverseDiagonal.data() + first;
+        rRow.pTarget = pTarget + first;
+        change = std::max(change, Vectorized::SUPPORTED ? Vectorized::relaxHeatRow(rRow) : relaxHeatRow(rRow));
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxHeatRow(const HeatRow<Stored, Real>& rRow) const
+{
+    Real change = 0;
+    for (ptrdiff_t i = 0; i < rRow.count; i++)
+    {
+        Real neighbors
+            = (Real)rRow.pConductivitySumX[i] * Storage::load(rRow.pTemperature[i + 1])
+            + (Real)rRow.pConductivitySumX[i - 1] * Storage::load(rRow.pTemperature[i - 1])
+            + (Real)rRow.pConductivitySumY[i] * Storage::load(rRow.pTemperature[i + rRow.strideY])
+            + (Real)rRow.pConductivitySumY[i - rRow.strideY] * Storage::load(rRow.pTemperature[i - rRow.strideY])
+            + (Real)rRow.pConductivitySumZ[i] * Storage::load(rRow.pTemperature[i + rRow.strideZ])
+            + (Real)rRow.pConductivitySumZ[i - rRow.strideZ] * Storage::load(rRow.pTemperature[i - rRow.strideZ]);
+        Real relaxed = (rRow.pSource[i] * Storage::load(rRow.pPreviousTemperature[i]) + rRow.conductanceScale * neighbors) * rRow.pInverseDiagonal[i];
+        change = std::max(change, (Real)std::abs(relaxed - Storage::load(rRow.pTemperature[i])));
+        rRow.pTarget[i] = Storage::store(relaxed);
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxFluid(const CpuStepSettings& rSettings, int sweeps)
+{
+    // Same weight and normalization as the diffusion of the GPU simulations, components are independent and
+    // each is blocked like conduction. Planes of one interleaved component span all three
+    DiffusionRow<Stored, Real> row;
+    row.step = (ptrdiff_t)(getComponent(1, 0) - getComponent(0, 0));
+    row.strideY = row.step * (ptrdiff_t)mStrideY;
+    row.strideZ = row.step * (ptrdiff_t)mStrideZ;
+    row.h = (Real)(rSettings.timeStep * rSettings.viscosity);
+    row.normalization = (Real)1 / ((Real)1 + 4 * row.h);
+    size_t bytesPerVoxel = 3 * sizeof(Stored) * (size_t)row.step;
+    int depth = getWavefrontDepth(sweeps, bytesPerVoxel);
+    Real change = 0;
+    for (int done = 0; done < sweeps; done += depth)
+    {
+        int batch = std::min(depth, sweeps - done);
+        change = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            if (batch == 1)
+            {
+                for (int blockY = 1; blockY <= mExtent.y; blockY += mBlockSize.y)
+                {
+                    for (int blockX = 1; blockX <= mExtent.x; blockX += mBlockSize.x)
+                    {
+                        glm::ivec2 begin(blockX, blockY);
+                        glm::ivec2 end = glm::min(begin + mBlockSize, glm::ivec2(mExtent.x, mExtent.y) + 1);
+                        for (int z = 1; z <= mExtent.z; z++)
+                        {
+                            change = std::max(change, relaxDiffusionBlock(row, mVelocity.data(), mVelocityBack.data(), c, z, begin, end));
+                        }
+                    }
+                }
+            }
+            else
+            {
+                // Wavefront like conduction
+                Stored* buffers[2] = { mVelocity.data(), mVelocityBack.data() };
+                glm::ivec2 begin(1);
+                glm::ivec2 end = glm::ivec2(mExtent.x, mExtent.y) + 1;
+                for (int wave = 1; wave < mExtent.z + batch; wave++)
+                {
+                    for (int t = 0; t < batch; t++)
+                    {
+                        int z = wave - t;
+                        if (z >= 1 && z <= mExtent.z)
+                        {
+                            Real planeChange = relaxDiffusionBlock(row, buffers[t % 2], buffers[(t + 1) % 2], c, z, begin, end);
+                            if (t == batch - 1)
+                            {
+                                change = std::max(change, planeChange);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        if (batch % 2 == 1)
+        {
+            mVelocity.swap(mVelocityBack);
+        }
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxDiffusionBlock(
+    DiffusionRow<Stored, Real>& rRow, const Stored* pSource, Stored* pTarget, int component, int z, const glm::ivec2& rBegin, const glm::ivec2& rEnd) const
+{
+    // Planar components are contiguous along rows, so only they go to the vector kernels
+    typedef VectorizedRows<Stored, Real> Vectorized;
+    const bool vectorized = Vectorized::SUPPORTED && LAYOUT == StorageLayout::PLANAR;
+    rRow.count = rEnd.x - rBegin.x;
+    Real change = 0;
+    for (int y = rBegin.y; y < rEnd.y; y++)
+    {
+        size_t first = getComponent(getIndex(rBegin.x, y, z), component);
+        rRow.pVelocity = pSource + first;
+        rRow.pInitialVelocity = mInitialVelocity.data() + first;
+        rRow.pTarget = pTarget + first;
+        change = std::max(change, vectorized ? Vectorized::relaxDiffusionRow(rRow) : relaxDiffusionRow(rRow));
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+typename SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::Real
+SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::relaxDiffusionRow(const DiffusionRow<Stored, Real>& rRow) const
+{
+    Real change = 0;
+    for (ptrdiff_t k = 0, i = 0; k < rRow.count; k++, i += rRow.step)
+    {
+        Real neighbors
+            = Storage::load(rRow.pVelocity[i + rRow.step])
+            + Storage::load(rRow.pVelocity[i - rRow.step])
+            + Storage::load(rRow.pVelocity[i + rRow.strideY])
+            + Storage::load(rRow.pVelocity[i - rRow.strideY])
+            + Storage::load(rRow.pVelocity[i + rRow.strideZ])
+            + Storage::load(rRow.pVelocity[i - rRow.strideZ]);
+        Real relaxed = (Storage::load(rRow.pInitialVelocity[i]) + rRow.h * neighbors) * rRow.normalization;
+        change = std::max(change, (Real)std::abs(relaxed - Storage::load(rRow.pVelocity[i])));
+        rRow.pTarget[i] = Storage::store(relaxed);
+    }
+    return change;
+}
+
+template<typename Scalar, StorageLayout LAYOUT, bool HAS_FLUID, bool HAS_FANS, bool HAS_HEATERS>
+void SpecializedCpuKernels<Scalar, LAYOUT, HAS_FLUID, HAS_FANS, HAS_HEATERS>::finishStep()
+{
+    // Heater and limitation, solids mirror the speed of fluid voxels below
+    Real maxSquaredSpeed = 0;
+    for (int z = 1; z <= mExtent.z; z++)
+    {
+        for (int y = 1; y <= mExtent.y; y++)
+        {
+            for (int x = 1; x <= mExtent.x; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                if (HAS_HEATERS && mInternalHeat[i] > 0)
+                {
+                    mTemperature[i] = Storage::store((Real)mInternalHeat[i]);
+                }
+                if (HAS_FLUID && mFluid[i])
+                {
+                    Real squaredSpeed = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        Real velocity = Storage::load(mVelocity[getComponent(i, c)]);
+                        velocity = std::min(std::max(velocity, (Real)-CPU_VELOCITY_LIMITATION), (Real)CPU_VELOCITY_LIMITATION);
+                        mVelocity[getComponent(i, c)] = Storage::store(velocity);
+                        squaredSpeed += velocity * velocity;
+                    }
+                    maxSquaredSpeed = std::max(maxSquaredSpeed, squaredSpeed);
+                }
+            }
+        }
+    }
+    mMaxSpeed = std::max((float)std::sqrt(maxSquaredSpeed), mMaxFanSpeed);
+    if (!HAS_FLUID)
+    {
+        return;
+    }
+
+    // Solid voxels mirror a fluid neighbor, same precedence of neighbors as in the stencil solver.
+    // Solids only read fluid voxels, so they are updated in place
+    const long offsets[6] = {
+        1, -1,
+        (long)mStrideY, -(long)mStrideY,
+        (long)mStrideZ, -(long)mStrideZ };
+    const int precedence[6] = { 4, 5, 2, 3, 1, 0 };
+    for (int z = 1; z <= mExtent.z; z++)
+    {
+        for (int y = 1; y <= mExtent.y; y++)
+        {
+            for (int x = 1; x <= mExtent.x; x++)
+            {
+                size_t i = getIndex(x, y, z);
+                if (mFluid[i])
+                {
+                    continue;
+                }
+                Real velocity[3] = { 0, 0, 0 };
+                for (int j = 0; j < 6; j++)
+                {
+                    size_t neighbor = (size_t)((long)i + offsets[precedence[j]]);
+                    if (mFluid[neighbor])
+                    {
+                        for (int c = 0; c < 3; c++)
+                        {
+                            velocity[c] = Storage::load(mVelocity[getComponent(neighbor, c)]);
+                        }
+                        velocity[precedence[j] / 2] = -velocity[precedence[j] / 2];
+                        break;
+                    }
+                }
+                for (int c = 0; c < 3; c++)
+                {
+                    mVelocity[getComponent(i, c)] = Storage::store(velocity[c]);
+                }
+            }
+        }
+    }
+}
+
+#endif // CPUSTENCILKERNELS_H_
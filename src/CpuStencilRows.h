@@ -0,0 +1,48 @@
+#ifndef CPUSTENCILROWS_H_
+#define CPUSTENCILROWS_H_
+
+#include <cstddef>
+
+// Rows of the seven point stencils along x. Pointers are at the first voxel of the row and neighbors
+// in y and z are reached by strides. Kept free of other includes, as vector kernels are compiled for
+// instruction sets the running CPU may not have
+
+// Jacobi sweep of conduction
+template<typename Stored, typename Real>
+struct HeatRow
+{
+    const Stored* pTemperature;
+    const Stored* pPreviousTemperature;
+    const float* pConductivitySumX; // Of voxel and its neighbor in positive direction
+    const float* pConductivitySumY;
+    const float* pConductivitySumZ;
+    const Real* pSource;
+    const Real* pInverseDiagonal;
+    Stored* pTarget;
+    ptrdiff_t strideY;
+    ptrdiff_t strideZ;
+    ptrdiff_t count;
+    Real conductanceScale;
+};
+
+// Jacobi sweep of diffusion of one velocity component
+template<typename Stored, typename Real>
+struct DiffusionRow
+{
+    const Stored* pVelocity;
+    const Stored* pInitialVelocity;
+    Stored* pTarget;
+    ptrdiff_t step; // Between components of neighboring voxels in x
+    ptrdiff_t strideY;
+    ptrdiff_t strideZ;
+    ptrdiff_t count;
+    Real h;
+    Real normalization;
+};
+
+// Rows of 32 bit floats with unit step are relaxed by the vector kernels of the instruction set
+// selected at startup, these return the largest change like the scalar rows
+float relaxVectorizedHeatRow(const HeatRow<float, float>& rRow);
+float relaxVectorizedDiffusionRow(const DiffusionRow<float, float>& rRow);
+
+#endif // CPUSTENCILROWS_H_
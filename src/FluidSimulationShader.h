@@ -1,8 +1,10 @@
 #ifndef FLUIDSIMULATIONSHADER_H_
 #define FLUIDSIMULATIONSHADER_H_
 
+// Storage formats of temperature and velocity, GROUP_SIZE and TILE_SIZE are prepended as defines.
+// With a TILE_SIZE, workgroups are cubic tiles and diffusion reads neighbors from a copy of the tile with
+// halo in shared memory. Without, neighbors are read from the volume
 const char* fluidSimComputeShader =
-"#version 430 core\n"
 
 // Structs
 "struct Mat{\n"
@@ -18,7 +20,7 @@ const char* fluidSimComputeShader =
 "};\n"
 
 // Workgroup settings
-"layout(local_size_x=8, local_size_y=8, local_size_z=8) in;\n"
+"layout(local_size_x=GROUP_SIZE, local_size_y=GROUP_SIZE, local_size_z=GROUP_SIZE) in;\n"
 
 // SSBOs
 "layout(std430, binding = 0) buffer Material\n"
@@ -29,51 +31,108 @@ const char* fluidSimComputeShader =
 "{\n"
 "	FanStruct fans[];\n"
 "};\n"
+"layout(std430, binding = 2) buffer ActiveBricks\n"
+"{\n"
+"	uint numGroupsX;\n"
+"	uint numGroupsY;\n"
+"	uint numGroupsZ;\n"
+"	uint bricks[];\n"
+"};\n"
+"layout(std430, binding = 3) buffer MaxUpdate\n"
+"{\n"
+"	uint maxUpdateBits;\n" // Largest change of last sweep, positive floats keep their order as uint
+"};\n"
 
 // Uniforms
-"layout(rgba32f, location = 0) uniform image3D stateVolume;\n"
-"layout(r32f, location = 1) uniform image3D lookupVolume;\n"
+"layout(VELOCITY_FORMAT, location = 0) uniform image3D velocityVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 2) uniform image3D temperatureVolume;\n"
+"layout(VELOCITY_FORMAT, location = 3) uniform image3D initialVelocityVolume;\n" // Velocity after forces, start of diffusion
 "uniform float timeStep;\n"
 "uniform float edgeLength;\n"
-"uniform int relaxationSteps;\n"
+"uniform int stage;\n" // 0: forces and diffusion sweeps, 1: transport
+"uniform int sweeps;\n"
+"uniform bool firstSweeps;\n"
+"uniform int color;\n" // -1: all voxels, 0 and 1: red or black voxels of red-black ordering
+"uniform bool checkedSweep;\n" // Change is measured only in the last sweep of a batch
+"uniform float omega;\n" // Over-relaxation
+"uniform float viscosity;\n"
+"uniform bool centeredAdvection;\n" // Otherwise advector transports velocity before
 "uniform int fanCount;\n"
 
 // Consts
 "const float gravity = -0;\n" // Not set
 "const float thermalExpansionCoefficient = 0.00025;\n"
-"const float viscosity = 0.0001568f;\n"
 "const float limitation = 0.07;\n"
+"const uint neighborFluidShift = 8;\n" // +x, -x, +y, -y, +z, -z
+"const uint selfFluid = 1u << 14;\n"
 
 // Global variables
-"vec4 myState;\n"
+"vec3 myVelocity;\n"
+"float myTemperature;\n"
 "float inverseVoxelEdgeArea;\n"
+"shared uint groupMaxUpdateBits;\n"
+"#if TILE_SIZE > 0\n"
+"#define TILE_EDGE (TILE_SIZE + 2)\n" // Tile with one voxel of halo on each side
+"shared vec3 velocityTile[TILE_EDGE * TILE_EDGE * TILE_EDGE];\n"
+"#endif\n"
 
 // Is fluid
 "bool isFluid(ivec3 coords)"
 "{\n"
-"	float fluid = m[int(imageLoad(lookupVolume, coords).x)].cisf.w;\n"
-"	return bool(fluid > 0);\n"
+"	return (imageLoad(propertyVolume, coords).x & selfFluid) != 0u;\n"
+"}\n"
+
+// Get velocity
+"vec3 getVelocity(ivec3 coords)"
+"{\n"
+"	return imageLoad(velocityVolume, coords).xyz;\n"
+"}\n"
+
+// Is relaxed in current sweep
+"bool isRelaxed(ivec3 coords)"
+"{\n"
+"	return color < 0 || ((coords.x + coords.y + coords.z) & 1) == color;\n"
 "}\n"
 
-// Get state
-"vec4 getState(ivec3 coords)"
+// Get coordinates of invocation inside of active brick
+"ivec3 getBrickCoords()"
 "{\n"
-"	return imageLoad(stateVolume, coords);\n"
+"	uvec3 brickCount = uvec3(imageSize(velocityVolume)) / gl_WorkGroupSize;\n"
+"	uint brick = bricks[gl_WorkGroupID.x];\n"
+"	uvec3 brickCoords = uvec3(brick % brickCount.x, (brick / brickCount.x) % brickCount.y, brick / (brickCount.x * brickCount.y));\n"
+"	return ivec3(brickCoords * gl_WorkGroupSize + gl_LocalInvocationID);\n"
 "}\n"
 
+// Tile of velocity, inner voxels are written by their invocations
+"#if TILE_SIZE > 0\n"
+"void loadVelocityHalo(ivec3 origin)"
+"{\n"
+"   for(int i = int(gl_LocalInvocationIndex); i < TILE_EDGE * TILE_EDGE * TILE_EDGE; i += TILE_SIZE * TILE_SIZE * TILE_SIZE)\n"
+"   {\n"
+"       ivec3 tileCoords = ivec3(i % TILE_EDGE, (i / TILE_EDGE) % TILE_EDGE, i / (TILE_EDGE * TILE_EDGE));\n"
+"       ivec3 border = ivec3(equal(tileCoords, ivec3(0))) + ivec3(equal(tileCoords, ivec3(TILE_EDGE - 1)));\n"
+"       if(border.x + border.y + border.z == 1)\n" // Edges and corners of the halo are no neighbors of the tile
+"       {\n"
+"           velocityTile[i] = getVelocity(origin + tileCoords);\n"
+"       }\n"
+"   }\n"
+"}\n"
+"#endif\n"
+
 // Wind
 "void wind(ivec3 coords)\n"
 "{\n"
 "	for(int i = 0; i < fanCount; i++)\n"
 "	{\n"
 "		vec3 relCoords = coords;\n"
-"		relCoords /= 128.0;\n" // TODO: Voxel count guessed...
+"		relCoords /= float(imageSize(velocityVolume).x);\n"
 "		float inFront = max(0,sign(dot(-fans[i].position+relCoords, fans[i].direction)));\n" // Figure out, whether voxel is in front of fan
 "		float distanceFalloff = 1.0 - clamp(abs(length(relCoords - fans[i].position)) / 0.2, 0, 1);\n" // Falloff by distance
 "		vec3 wind = distanceFalloff * inFront * fans[i].direction * fans[i].speed;\n"
-"		myState.yzw = length(wind) > length(myState.yzw) ? wind : myState.yzw;\n" // Just the wind if it is strong enough
+"		myVelocity = length(wind) > length(myVelocity) ? wind : myVelocity;\n" // Just the wind if it is strong enough
 "	}\n"
-"	imageStore(stateVolume, coords, myState);\n" // Save changed state for other programs
+"	imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n" // Save changed state for other programs
 "	barrier();\n" // Necessary for storing?
 "};\n"
 
@@ -83,84 +142,111 @@ const char* fluidSimComputeShader =
 "	float downForce = gravity * timeStep;\n" // Down (should be negative)
 "	float upForce = thermalExpansionCoefficient * timeStep;\n" // Up
 "   float averageTemperature = 0;\n"  // TODO
-"	myState.z -= (downForce-upForce) * myState.x + upForce * averageTemperature;\n"
+"	myVelocity.y -= (downForce-upForce) * myTemperature + upForce * averageTemperature;\n"
 //  f[i][j] += (g - b) * t[i][j] + b * t0;
-"	imageStore(stateVolume, coords, myState);\n" // Save changed state for other programs
+"	imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n" // Save changed state for other programs
 "	barrier();\n" // Necessary for storing?
 "};\n"
 
-// Diffuse
-"void diffuse(ivec3 coords)"
+// Diffuse, returns change of last sweep
+"float diffuse(ivec3 coords, vec3 myInitialVelocity)"
 "{\n"
-"	vec4 myInitialState = myState;\n"
+"	float change = 0;\n"
 "	float h = timeStep * viscosity * inverseVoxelEdgeArea;\n"
 "	float normalization = 1 / (1 + 2 * (h + h));\n" // TODO: Normalization but in 3D (formula still 2D...)
 //  float dn = 1f / (1 + 2 * (hx + hy));
-"	for(int i = 0; i < relaxationSteps; i++)\n"
+"	bool relaxed = isRelaxed(coords);\n"
+"#if TILE_SIZE > 0\n"
+"   ivec3 origin = coords - ivec3(gl_LocalInvocationID) - ivec3(1);\n" // Tile starts one voxel before the workgroup
+"   int myIndex = int(gl_LocalInvocationID.x + 1u) + TILE_EDGE * (int(gl_LocalInvocationID.y + 1u) + TILE_EDGE * int(gl_LocalInvocationID.z + 1u));\n"
+"#endif\n"
+"	for(int i = 0; i < sweeps; i++)\n"
 "	{\n" // Doing diffusion in all three directions at once per step
-"       vec4 leftState = getState(coords+ivec3(1,0,0));\n"
-"       vec4 rightState = getState(coords+ivec3(-1,0,0));\n"
-"       vec4 topState = getState(coords+ivec3(0,1,0));\n"
-"       vec4 downState = getState(coords+ivec3(0,-1,0));\n"
-"       vec4 frontState = getState(coords+ivec3(0,0,1));\n"
-"       vec4 backState = getState(coords+ivec3(0,0,-1));\n"
-"		myState.y"
-"           = (myInitialState.y "
-"           + h * (leftState.y + rightState.y)"
-"           + h * (topState.y + downState.y)"
-"           + h * (frontState.y + backState.y))"
-"           * normalization;\n"
-"		myState.z"
-"           = (myInitialState.z "
-"           + h * (leftState.z + rightState.z)"
-"           + h * (topState.z + downState.z)"
-"           + h * (frontState.z + backState.z))"
-"           * normalization;\n"
-"		myState.w"
-"           = (myInitialState.w "
-"           + h * (leftState.w + rightState.w)"
-"           + h * (topState.w + downState.w)"
-"           + h * (frontState.w + backState.w))"
-"           * normalization;\n"
-//		f[i][j] = (f0[i][j] + hx * (f[i - 1][j] + f[i + 1][j]) + hy * (f[i][j - 1] + f[i][j + 1])) * dn;
-"		imageStore(stateVolume, coords, myState);\n"
+"#if TILE_SIZE > 0\n"
+"       loadVelocityHalo(origin);\n"
+"       velocityTile[myIndex] = myVelocity;\n"
+"       barrier();\n"
+"#endif\n"
+"       if(relaxed)\n"
+"       {\n"
+"           vec3 previousVelocity = myVelocity;\n"
+"#if TILE_SIZE > 0\n"
+"           vec3 leftVelocity = velocityTile[myIndex + 1];\n"
+"           vec3 rightVelocity = velocityTile[myIndex - 1];\n"
+"           vec3 topVelocity = velocityTile[myIndex + TILE_EDGE];\n"
+"           vec3 downVelocity = velocityTile[myIndex - TILE_EDGE];\n"
+"           vec3 frontVelocity = velocityTile[myIndex + TILE_EDGE * TILE_EDGE];\n"
+"           vec3 backVelocity = velocityTile[myIndex - TILE_EDGE * TILE_EDGE];\n"
+"#else\n"
+"           vec3 leftVelocity = getVelocity(coords+ivec3(1,0,0));\n"
+"           vec3 rightVelocity = getVelocity(coords+ivec3(-1,0,0));\n"
+"           vec3 topVelocity = getVelocity(coords+ivec3(0,1,0));\n"
+"           vec3 downVelocity = getVelocity(coords+ivec3(0,-1,0));\n"
+"           vec3 frontVelocity = getVelocity(coords+ivec3(0,0,1));\n"
+"           vec3 backVelocity = getVelocity(coords+ivec3(0,0,-1));\n"
+"#endif\n"
+"           myVelocity.x"
+"               = (myInitialVelocity.x "
+"               + h * (leftVelocity.x + rightVelocity.x)"
+"               + h * (topVelocity.x + downVelocity.x)"
+"               + h * (frontVelocity.x + backVelocity.x))"
+"               * normalization;\n"
+"           myVelocity.y"
+"               = (myInitialVelocity.y "
+"               + h * (leftVelocity.y + rightVelocity.y)"
+"               + h * (topVelocity.y + downVelocity.y)"
+"               + h * (frontVelocity.y + backVelocity.y))"
+"               * normalization;\n"
+"           myVelocity.z"
+"               = (myInitialVelocity.z "
+"               + h * (leftVelocity.z + rightVelocity.z)"
+"               + h * (topVelocity.z + downVelocity.z)"
+"               + h * (frontVelocity.z + backVelocity.z))"
+"               * normalization;\n"
+//          f[i][j] = (f0[i][j] + hx * (f[i - 1][j] + f[i + 1][j]) + hy * (f[i][j - 1] + f[i][j + 1])) * dn;
+"           myVelocity = mix(previousVelocity, myVelocity, omega);\n"
+"           vec3 difference = abs(myVelocity - previousVelocity);\n"
+"           change = max(difference.x, max(difference.y, difference.z));\n"
+"           imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
+"       }\n"
 "       barrier();\n"
 "	}\n"
+"	return change;\n"
 "}\n"
 
 // Conserve
 "void conserve(ivec3 coords)"
 "{\n"
     // Grab values from neighbors
-"   vec4 leftState = getState(coords+ivec3(1,0,0));\n"
-"   vec4 rightState = getState(coords+ivec3(-1,0,0));\n"
-"   vec4 topState = getState(coords+ivec3(0,1,0));\n"
-"   vec4 downState = getState(coords+ivec3(0,-1,0));\n"
-"   vec4 frontState = getState(coords+ivec3(0,0,1));\n"
-"   vec4 backState = getState(coords+ivec3(0,0,-1));\n"
+"   vec3 leftVelocity = getVelocity(coords+ivec3(1,0,0));\n"
+"   vec3 rightVelocity = getVelocity(coords+ivec3(-1,0,0));\n"
+"   vec3 topVelocity = getVelocity(coords+ivec3(0,1,0));\n"
+"   vec3 downVelocity = getVelocity(coords+ivec3(0,-1,0));\n"
+"   vec3 frontVelocity = getVelocity(coords+ivec3(0,0,1));\n"
+"   vec3 backVelocity = getVelocity(coords+ivec3(0,0,-1));\n"
     // Use volume to save phi and div
 "   float normalization = 0.5 / edgeLength;\n"
 "   vec4 value = vec4(0,0,0,0);\n"
 "   value.x = 0;\n"
 "   value.y "
-"   = ((leftState.y - rightState.y)"
-"   + (topState.z - downState.z)"
-"   + (frontState.w - backState.w)) * normalization;\n"
+"   = ((leftVelocity.x - rightVelocity.x)"
+"   + (topVelocity.y - downVelocity.y)"
+"   + (frontVelocity.z - backVelocity.z)) * normalization;\n"
 //  div[i][j] = (u[i + 1][j] - u[i - 1][j]) * i2dx + (v[i][j + 1] - v[i][j - 1]) * i2dy;
 //	phi[i][j] = 0;
-"   imageStore(stateVolume, coords, value);\n" // Abuse state volume for temporaly value storing
+"   imageStore(velocityVolume, coords, value);\n" // Abuse velocity volume for temporaly value storing
 "   barrier();\n"
 //  Relaxation
 "   float idsq = (1.0 / (2.0 * edgeLength));\n"
 "   normalization = 0.5 / (2.0 * idsq);\n"
-"	for(int i = 0; i < relaxationSteps; i++)\n"
+"	for(int i = 0; i < sweeps; i++)\n"
 "	{\n"
-"       vec4 leftValue = getState(coords+ivec3(1,0,0));\n"
-"       vec4 rightValue = getState(coords+ivec3(-1,0,0));\n"
-"       vec4 topValue = getState(coords+ivec3(0,1,0));\n"
-"       vec4 downValue = getState(coords+ivec3(0,-1,0));\n"
-"       vec4 frontValue = getState(coords+ivec3(0,0,1));\n"
-"       vec4 backValue = getState(coords+ivec3(0,0,-1));\n"
+"       vec4 leftValue = imageLoad(velocityVolume, coords+ivec3(1,0,0));\n"
+"       vec4 rightValue = imageLoad(velocityVolume, coords+ivec3(-1,0,0));\n"
+"       vec4 topValue = imageLoad(velocityVolume, coords+ivec3(0,1,0));\n"
+"       vec4 downValue = imageLoad(velocityVolume, coords+ivec3(0,-1,0));\n"
+"       vec4 frontValue = imageLoad(velocityVolume, coords+ivec3(0,0,1));\n"
+"       vec4 backValue = imageLoad(velocityVolume, coords+ivec3(0,0,-1));\n"
 "       value.x "
 "       = normalization "
 "       * (((leftValue.x + rightValue.x)"
@@ -169,167 +255,202 @@ const char* fluidSimComputeShader =
 "       * idsq)"
 "       - value.y;\n"
 //      phi[i][j] = s * ((phi[i - 1][j] + phi[i + 1][j]) * idxsq + (phi[i][j - 1] + phi[i][j + 1]) * idysq - div[i][j]);
-"		imageStore(stateVolume, coords, value);\n" // Save changed state for neighbors
+"		imageStore(velocityVolume, coords, value);\n" // Save changed state for neighbors
 "       barrier();\n" // Neighbors must update before next cycle
 "   }\n"
-"   vec4 leftValue = getState(coords+ivec3(1,0,0));\n"
-"   vec4 rightValue = getState(coords+ivec3(-1,0,0));\n"
-"   vec4 topValue = getState(coords+ivec3(0,1,0));\n"
-"   vec4 downValue = getState(coords+ivec3(0,-1,0));\n"
-"   vec4 frontValue = getState(coords+ivec3(0,0,1));\n"
-"   vec4 backValue = getState(coords+ivec3(0,0,-1));\n"
+"   vec4 leftValue = imageLoad(velocityVolume, coords+ivec3(1,0,0));\n"
+"   vec4 rightValue = imageLoad(velocityVolume, coords+ivec3(-1,0,0));\n"
+"   vec4 topValue = imageLoad(velocityVolume, coords+ivec3(0,1,0));\n"
+"   vec4 downValue = imageLoad(velocityVolume, coords+ivec3(0,-1,0));\n"
+"   vec4 frontValue = imageLoad(velocityVolume, coords+ivec3(0,0,1));\n"
+"   vec4 backValue = imageLoad(velocityVolume, coords+ivec3(0,0,-1));\n"
 "   float i2d = 0.5 / edgeLength;\n" // Correct?
-"   myState.y -= (leftValue.x - rightValue.x) * i2d;\n"
-"   myState.z -= (topValue.x - downValue.x) * i2d;\n"
-"   myState.w -= (frontValue.x - backValue.x) * i2d;\n"
-"   imageStore(stateVolume, coords, myState);\n" // Save changed state for neighbors
+"   myVelocity.x -= (leftValue.x - rightValue.x) * i2d;\n"
+"   myVelocity.y -= (topValue.x - downValue.x) * i2d;\n"
+"   myVelocity.z -= (frontValue.x - backValue.x) * i2d;\n"
+"   imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n" // Save changed state for neighbors
 "   barrier();"
 "}\n"
 
 // Advect
 "void advect(ivec3 coords)"
 "{\n"
-"   vec4 myOldState = myState;"
+"   vec3 myOldVelocity = myVelocity;"
 "   float normalization = 0.5 * timeStep / edgeLength;\n"
-"   vec4 leftState = getState(coords+ivec3(1,0,0));\n"
-"   vec4 rightState = getState(coords+ivec3(-1,0,0));\n"
-"   vec4 topState = getState(coords+ivec3(0,1,0));\n"
-"   vec4 downState = getState(coords+ivec3(0,-1,0));\n"
-"   vec4 frontState = getState(coords+ivec3(0,0,1));\n"
-"   vec4 backState = getState(coords+ivec3(0,0,-1));\n"
+"   vec3 leftVelocity = getVelocity(coords+ivec3(1,0,0));\n"
+"   vec3 rightVelocity = getVelocity(coords+ivec3(-1,0,0));\n"
+"   vec3 topVelocity = getVelocity(coords+ivec3(0,1,0));\n"
+"   vec3 downVelocity = getVelocity(coords+ivec3(0,-1,0));\n"
+"   vec3 frontVelocity = getVelocity(coords+ivec3(0,0,1));\n"
+"   vec3 backVelocity = getVelocity(coords+ivec3(0,0,-1));\n"
 //  Reduce own state by difference of squared neihgbors' values multiplied with some normalization
-"   myState.y"
-"   = myState.y"
-"   - normalization * (leftState.y*leftState.y - rightState.y*rightState.y)"
-"   - normalization * (topState.y*topState.y - downState.y*downState.y)"
-"   - normalization * (frontState.y*frontState.y - backState.y*backState.y);"
-"   myState.z"
-"   = myState.z"
-"   - normalization * (leftState.z*leftState.z - rightState.z*rightState.z)"
-"   - normalization * (topState.z*topState.z - downState.z*downState.z)"
-"   - normalization * (frontState.z*frontState.z - backState.z*backState.z);"
-"   myState.w"
-"   = myState.w"
-"   - normalization * (leftState.w*leftState.w - rightState.w*rightState.w)"
-"   - normalization * (topState.w*topState.w - downState.w*downState.w)"
-"   - normalization * (frontState.w*frontState.w - backState.w*backState.w);"
+"   myVelocity.x"
+"   = myVelocity.x"
+"   - normalization * (leftVelocity.x*leftVelocity.x - rightVelocity.x*rightVelocity.x)"
+"   - normalization * (topVelocity.x*topVelocity.x - downVelocity.x*downVelocity.x)"
+"   - normalization * (frontVelocity.x*frontVelocity.x - backVelocity.x*backVelocity.x);"
+"   myVelocity.y"
+"   = myVelocity.y"
+"   - normalization * (leftVelocity.y*leftVelocity.y - rightVelocity.y*rightVelocity.y)"
+"   - normalization * (topVelocity.y*topVelocity.y - downVelocity.y*downVelocity.y)"
+"   - normalization * (frontVelocity.y*frontVelocity.y - backVelocity.y*backVelocity.y);"
+"   myVelocity.z"
+"   = myVelocity.z"
+"   - normalization * (leftVelocity.z*leftVelocity.z - rightVelocity.z*rightVelocity.z)"
+"   - normalization * (topVelocity.z*topVelocity.z - downVelocity.z*downVelocity.z)"
+"   - normalization * (frontVelocity.z*frontVelocity.z - backVelocity.z*backVelocity.z);"
 //  f[i][j] = f0[i][j] - tx * (u0[i + 1][j] * f0[i + 1][j] - u0[i - 1][j] * f0[i - 1][j]) - ty * (v0[i][j + 1] * f0[i][j + 1] - v0[i][j - 1] * f0[i][j - 1]);
-"   imageStore(stateVolume, coords, myState);\n"
+"   imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
 "   barrier();\n"
-"   leftState = getState(coords+ivec3(1,0,0));\n"
-"   rightState = getState(coords+ivec3(-1,0,0));\n"
-"   topState = getState(coords+ivec3(0,1,0));\n"
-"   downState = getState(coords+ivec3(0,-1,0));\n"
-"   frontState = getState(coords+ivec3(0,0,1));\n"
-"   backState = getState(coords+ivec3(0,0,-1));\n"
+"   leftVelocity = getVelocity(coords+ivec3(1,0,0));\n"
+"   rightVelocity = getVelocity(coords+ivec3(-1,0,0));\n"
+"   topVelocity = getVelocity(coords+ivec3(0,1,0));\n"
+"   downVelocity = getVelocity(coords+ivec3(0,-1,0));\n"
+"   frontVelocity = getVelocity(coords+ivec3(0,0,1));\n"
+"   backVelocity = getVelocity(coords+ivec3(0,0,-1));\n"
 //  Weight own state with state at beginning of function and differences of neighbors' values
-"   myState.y"
-"   = 0.5 * (myOldState.y + myState.y)\n"
-"   - 0.5 * normalization * myOldState.y * (leftState.y - rightState.y)\n"
-"   - 0.5 * normalization * myOldState.y * (topState.y - downState.y)\n"
-"   - 0.5 * normalization * myOldState.y * (frontState.y - backState.y);\n"
-"   myState.z"
-"   = 0.5 * (myOldState.z + myState.z)\n"
-"   - 0.5 * normalization * myOldState.z * (leftState.z - rightState.z)\n"
-"   - 0.5 * normalization * myOldState.z * (topState.z - downState.z)\n"
-"   - 0.5 * normalization * myOldState.z * (frontState.z - backState.z);\n"
-"   myState.w"
-"   = 0.5 * (myOldState.w + myState.w)\n"
-"   - 0.5 * normalization * myOldState.w * (leftState.w - rightState.w)\n"
-"   - 0.5 * normalization * myOldState.w * (topState.w - downState.w)\n"
-"   - 0.5 * normalization * myOldState.w * (frontState.w - backState.w);\n"
+"   myVelocity.x"
+"   = 0.5 * (myOldVelocity.x + myVelocity.x)\n"
+"   - 0.5 * normalization * myOldVelocity.x * (leftVelocity.x - rightVelocity.x)\n"
+"   - 0.5 * normalization * myOldVelocity.x * (topVelocity.x - downVelocity.x)\n"
+"   - 0.5 * normalization * myOldVelocity.x * (frontVelocity.x - backVelocity.x);\n"
+"   myVelocity.y"
+"   = 0.5 * (myOldVelocity.y + myVelocity.y)\n"
+"   - 0.5 * normalization * myOldVelocity.y * (leftVelocity.y - rightVelocity.y)\n"
+"   - 0.5 * normalization * myOldVelocity.y * (topVelocity.y - downVelocity.y)\n"
+"   - 0.5 * normalization * myOldVelocity.y * (frontVelocity.y - backVelocity.y);\n"
+"   myVelocity.z"
+"   = 0.5 * (myOldVelocity.z + myVelocity.z)\n"
+"   - 0.5 * normalization * myOldVelocity.z * (leftVelocity.z - rightVelocity.z)\n"
+"   - 0.5 * normalization * myOldVelocity.z * (topVelocity.z - downVelocity.z)\n"
+"   - 0.5 * normalization * myOldVelocity.z * (frontVelocity.z - backVelocity.z);\n"
 //  f0[i][j] = 0.5f * (f0[i][j] + f[i][j])
 //  - 0.5f * tx * u0[i][j] * (f[i + 1][j] - f[i - 1][j])
 //  - 0.5f * ty * v0[i][j] * (f[i][j + 1] - f[i][j - 1]);
-"   imageStore(stateVolume, coords, myState);\n"
+"   imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
 "   barrier();\n"
 "}\n"
 
 // Collide with static environment
 "void collide(ivec3 coords)"
 "{\n"
-"   bool fluidLeft = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(1,0,0)).x)].cisf.w;\n"
-"   bool fluidRight = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(-1,0,0)).x)].cisf.w;\n"
-"   bool fluidTop = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(0,1,0)).x)].cisf.w;\n"
-"   bool fluidDown = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(0,-1,0)).x)].cisf.w;\n"
-"   bool fluidFront = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(0,0,1)).x)].cisf.w;\n"
-"   bool fluidBack = 0 < m[int(imageLoad(lookupVolume, coords+ivec3(0,0,-1)).x)].cisf.w;\n"
-"   vec4 leftState = getState(coords+ivec3(1,0,0));\n"
-"   vec4 rightState = getState(coords+ivec3(-1,0,0));\n"
-"   vec4 topState = getState(coords+ivec3(0,1,0));\n"
-"   vec4 downState = getState(coords+ivec3(0,-1,0));\n"
-"   vec4 frontState = getState(coords+ivec3(0,0,1));\n"
-"   vec4 backState = getState(coords+ivec3(0,0,-1));\n"
-"   myState.yzw = vec3(0,0,0);\n"
+"   uint neighborFluid = imageLoad(propertyVolume, coords).x >> neighborFluidShift;\n" // Precomputed mask of fluid neighbors
+"   bool fluidLeft = (neighborFluid & 1u) != 0u;\n"
+"   bool fluidRight = (neighborFluid & 2u) != 0u;\n"
+"   bool fluidTop = (neighborFluid & 4u) != 0u;\n"
+"   bool fluidDown = (neighborFluid & 8u) != 0u;\n"
+"   bool fluidFront = (neighborFluid & 16u) != 0u;\n"
+"   bool fluidBack = (neighborFluid & 32u) != 0u;\n"
+"   vec3 leftVelocity = getVelocity(coords+ivec3(1,0,0));\n"
+"   vec3 rightVelocity = getVelocity(coords+ivec3(-1,0,0));\n"
+"   vec3 topVelocity = getVelocity(coords+ivec3(0,1,0));\n"
+"   vec3 downVelocity = getVelocity(coords+ivec3(0,-1,0));\n"
+"   vec3 frontVelocity = getVelocity(coords+ivec3(0,0,1));\n"
+"   vec3 backVelocity = getVelocity(coords+ivec3(0,0,-1));\n"
+"   myVelocity = vec3(0,0,0);\n"
 "   if(fluidRight)\n"
 "	{\n"
-"       myState.y = -rightState.y;\n"
-"       myState.z = rightState.z;\n"
-"       myState.w = rightState.w;\n"
+"       myVelocity.x = -rightVelocity.x;\n"
+"       myVelocity.y = rightVelocity.y;\n"
+"       myVelocity.z = rightVelocity.z;\n"
 "	}\n"
 "   else if(fluidLeft)\n"
 "	{\n"
-"       myState.y = -leftState.y;\n"
-"       myState.z = leftState.z;\n"
-"       myState.w = leftState.w;\n"
+"       myVelocity.x = -leftVelocity.x;\n"
+"       myVelocity.y = leftVelocity.y;\n"
+"       myVelocity.z = leftVelocity.z;\n"
 "	}\n"
 "   if(fluidTop)\n"
 "	{\n"
-"       myState.y = topState.y;\n"
-"       myState.z = -topState.z;\n"
-"       myState.w = topState.w;\n"
+"       myVelocity.x = topVelocity.x;\n"
+"       myVelocity.y = -topVelocity.y;\n"
+"       myVelocity.z = topVelocity.z;\n"
 "	}\n"
 "   else if(fluidDown)\n"
 "	{\n"
-"       myState.y = downState.y;\n"
-"       myState.z = -downState.z;\n"
-"       myState.w = downState.w;\n"
+"       myVelocity.x = downVelocity.x;\n"
+"       myVelocity.y = -downVelocity.y;\n"
+"       myVelocity.z = downVelocity.z;\n"
 "	}\n"
 "   if(fluidFront)\n"
 "	{\n"
-"       myState.y = frontState.y;\n"
-"       myState.z = frontState.z;\n"
-"       myState.w = -frontState.w;\n"
+"       myVelocity.x = frontVelocity.x;\n"
+"       myVelocity.y = frontVelocity.y;\n"
+"       myVelocity.z = -frontVelocity.z;\n"
 "	}\n"
 "   else if(fluidBack)\n"
 "	{\n"
-"       myState.y = backState.y;\n"
-"       myState.z = backState.z;\n"
-"       myState.w = -backState.w;\n"
+"       myVelocity.x = backVelocity.x;\n"
+"       myVelocity.y = backVelocity.y;\n"
+"       myVelocity.z = -backVelocity.z;\n"
 "	}\n"
-"   imageStore(stateVolume, coords, myState);\n"
+"   imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
 "   barrier();\n"
 "}\n"
 
 // Limitation of speed (not physically correct...)
 "void limit(ivec3 coords)\n"
 "{\n"
-"   myState.y = max(min(myState.y, limitation), -limitation);\n"
-"   myState.z = max(min(myState.z, limitation), -limitation);\n"
-"   myState.w = max(min(myState.w, limitation), -limitation);\n"
-"   imageStore(stateVolume, coords, myState);\n"
+"   myVelocity.x = max(min(myVelocity.x, limitation), -limitation);\n"
+"   myVelocity.y = max(min(myVelocity.y, limitation), -limitation);\n"
+"   myVelocity.z = max(min(myVelocity.z, limitation), -limitation);\n"
+"   imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
 "   barrier();\n"
 "}\n"
 
 // Main
 "void main()\n"
 "{\n"
-"   bool fluid = isFluid(ivec3(gl_GlobalInvocationID));\n"
-"   myState = imageLoad(stateVolume, ivec3(gl_GlobalInvocationID));\n" // Get initial state
-"   vec4 oldState = myState;\n"
-"	inverseVoxelEdgeArea = 1.0 / edgeLength * edgeLength;\n"
-"   wind(ivec3(gl_GlobalInvocationID));\n" // Just the fans overwritting the velocities
-"	buoyancy(ivec3(gl_GlobalInvocationID));\n" // Upthrust depending on average temperature
-"	diffuse(ivec3(gl_GlobalInvocationID));\n" // Do diffusion which is much like smoothing
-"	advect(ivec3(gl_GlobalInvocationID));\n" // Difference of temperature and velocity of neighbors used
-"   // conserve(ivec3(gl_GlobalInvocationID));\n" // Does not work :( and no exact idea what it is doing
-"	limit(ivec3(gl_GlobalInvocationID));\n" // More or less simple replacement for conserve
-"	if(!fluid)\n"
-"	{\n"
-"		myState = oldState;\n"
-"		collide(ivec3(gl_GlobalInvocationID));\n"
-"		imageStore(stateVolume, ivec3(gl_GlobalInvocationID), myState);\n" // Has to be done this way, becaue barrier not allowed inside of an if
-"	}\n"
+"   ivec3 coords = getBrickCoords();\n" // Indirect dispatch over active bricks
+"   bool fluid = isFluid(coords);\n"
+"   myVelocity = getVelocity(coords);\n" // Get initial state
+"   myTemperature = imageLoad(temperatureVolume, coords).x;\n"
+"   inverseVoxelEdgeArea = 1.0 / edgeLength * edgeLength;\n"
+"   if(stage == 0)\n"
+"   {\n"
+"       vec3 myInitialVelocity;\n"
+"       if(firstSweeps)\n"
+"       {\n"
+"           wind(coords);\n" // Just the fans overwritting the velocities
+"           buoyancy(coords);\n" // Upthrust depending on average temperature
+"           myInitialVelocity = myVelocity;\n"
+"           imageStore(initialVelocityVolume, coords, vec4(myInitialVelocity, 0));\n"
+"       }\n"
+"       else\n"
+"       {\n"
+"           myInitialVelocity = imageLoad(initialVelocityVolume, coords).xyz;\n"
+"       }\n"
+"       float change = diffuse(coords, myInitialVelocity);\n" // Do diffusion which is much like smoothing
+//      Largest change of workgroup goes into global maximum
+"       if(checkedSweep)\n"
+"       {\n"
+"           if(gl_LocalInvocationIndex == 0u)\n"
+"           {\n"
+"               groupMaxUpdateBits = 0u;\n"
+"           }\n"
+"           barrier();\n"
+"           atomicMax(groupMaxUpdateBits, floatBitsToUint(change));\n"
+"           barrier();\n"
+"           if(gl_LocalInvocationIndex == 0u)\n"
+"           {\n"
+"               atomicMax(maxUpdateBits, groupMaxUpdateBits);\n"
+"           }\n"
+"       }\n"
+"   }\n"
+"   else\n"
+"   {\n"
+"       if(centeredAdvection)\n"
+"       {\n"
+"           advect(coords);\n" // Difference of temperature and velocity of neighbors used
+"       }\n"
+"       // conserve(coords);\n" // Does not work :( and no exact idea what it is doing
+"       limit(coords);\n" // More or less simple replacement for conserve
+"       if(!fluid)\n"
+"       {\n"
+"           collide(coords);\n"
+"           imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n" // Has to be done this way, becaue barrier not allowed inside of an if
+"       }\n"
+"   }\n"
 "}\n";
 
 #endif // FLUIDSIMULATIONSHADER_H_
@@ -1,38 +1,96 @@
 #include "FluidSimulator.h"
 #include "FluidSimulationShader.h"
+#include "TimeStepLimits.h"
+#include "externals/GLM/glm/gtc/constants.hpp"
 
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <sstream>
+
+// Fraction of voxel edge the advection may transport velocity per step
+const float COURANT_NUMBER = 0.5f;
+
+// Lattice speed the lattice Boltzmann backend may reach per step, low to keep it incompressible
+const float LATTICE_SPEED_LIMIT = 0.1f;
+
+// Kinematic viscosity of air
+const float VISCOSITY = 0.0001568f;
 
 FluidSimulator::FluidSimulator(Area &area, const std::vector<Fan> &fanList)
 {
     mResolution = area.getResolution();
     mVoxelCount = area.getVoxelCount();
 
-    mStateVolume = area.getStateVolumeHandle();
-    mLookupVolume = area.getLookupVolumeHandle();
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mTemperatureVolume = area.getTemperatureVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mTemperatureFormat = area.getTemperatureFormat();
+    mVelocityFormat = area.getVelocityFormat();
 
     mSimulationArea = &area;
 
     mEdgeLenght = 1.f;
     mRelaxationSteps = 5;
+    mSweepsPerCheck = 2;
+    mTolerance = 0.000001f;
+    mRelaxationMethod = RelaxationMethod::JACOBI;
+    mAdvectionScheme = AdvectionScheme::CENTERED;
+    mBackend = FluidBackend::STENCIL;
+    mConvergenceInfo = { 0, 0.f, false };
+    mTileSize = 0;
 	mFanCount = (int)fanList.size();
+    mFansSSBO = 0;
+
+    // Fans set velocity before it can be measured
+    mMaxFanSpeed = 0.f;
+    for (const Fan& fan : fanList)
+    {
+        mMaxFanSpeed = std::max(mMaxFanSpeed, fan.getSpeed() * glm::length(fan.getDirection()));
+    }
 
     prepareMaterialSSBO(area.getMaterialList());
     prepareFansSSBO(fanList);
+    prepareVolumes();
     prepareShader();
+
+    // Bricks have size of workgroup
+    mupActiveBricks = std::unique_ptr<ActiveBricks>(new ActiveBricks(area, getGroupSize(), BrickCriterion::FLUID, mMaterialsSSBO, mFansSSBO, mFanCount));
+
+    // Advection limits the time step of both systems, heat takes the speed from here
+    mupVelocityReduction = std::unique_ptr<VelocityReduction>(new VelocityReduction(area));
+
+    // Alternative transport of velocity
+    mupAdvector = std::unique_ptr<Advector>(new Advector(area, mVelocityVolume, mVelocityFormat, "VELOCITY_FORMAT"));
 }
 
 FluidSimulator::~FluidSimulator()
 {
     // Delete shader
     glDeleteProgram(mFluidSimulationProgram);
+
+    glDeleteTextures(1, &mInitialVelocityVolume);
+    glDeleteBuffers(2, mMaxUpdateSSBOs);
 }
 
 void FluidSimulator::prepareShader()
 {
+    // Storage formats, workgroup and tile size are prepended as defines
+    std::stringstream source;
+    source << "#version 430 core\n";
+    source << "#define GROUP_SIZE " << getGroupSize() << "\n";
+    source << "#define TILE_SIZE " << mTileSize << "\n";
+    source << mSimulationArea->getStorageFormatDefines();
+    source << fluidSimComputeShader;
+    std::string sourceString = source.str();
+    const char* pSource = sourceString.c_str();
+
     mFluidSimulationProgram = glCreateProgram();
     GLint fluidSimulationCS = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(fluidSimulationCS, 1, &fluidSimComputeShader, NULL);
+    glShaderSource(fluidSimulationCS, 1, &pSource, NULL);
     glCompileShader(fluidSimulationCS);
 
     // Get length of compiling log
@@ -57,16 +115,59 @@ void FluidSimulator::prepareShader()
     glDetachShader(mFluidSimulationProgram, fluidSimulationCS);
     glDeleteShader(fluidSimulationCS);
 
-    mStateVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "stateVolume");
+    mVelocityVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "velocityVolume");
+    mTemperatureVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "temperatureVolume");
+    mInitialVelocityVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "initialVelocityVolume");
     mTimestepLocation = glGetUniformLocation(mFluidSimulationProgram, "timeStep");
-    mRelaxationStepsLocation = glGetUniformLocation(mFluidSimulationProgram, "relaxationSteps");
+    mStageLocation = glGetUniformLocation(mFluidSimulationProgram, "stage");
+    mSweepsLocation = glGetUniformLocation(mFluidSimulationProgram, "sweeps");
+    mFirstSweepsLocation = glGetUniformLocation(mFluidSimulationProgram, "firstSweeps");
+    mColorLocation = glGetUniformLocation(mFluidSimulationProgram, "color");
+    mCheckedSweepLocation = glGetUniformLocation(mFluidSimulationProgram, "checkedSweep");
+    mCenteredAdvectionLocation = glGetUniformLocation(mFluidSimulationProgram, "centeredAdvection");
+    mOmegaLocation = glGetUniformLocation(mFluidSimulationProgram, "omega");
+    mViscosityLocation = glGetUniformLocation(mFluidSimulationProgram, "viscosity");
     mEdgeLengthLocation = glGetUniformLocation(mFluidSimulationProgram, "edgeLength");
 	mFanCountLocation = glGetUniformLocation(mFluidSimulationProgram, "fanCount");
-    mLookupVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "lookupVolume");
+    mPropertyVolumeLocation = glGetUniformLocation(mFluidSimulationProgram, "propertyVolume");
+}
+
+float FluidSimulator::measureMaxSpeed()
+{
+    return std::max(mupVelocityReduction->computeMaxSpeed(), mMaxFanSpeed);
 }
 
-void FluidSimulator::nextStep(float dt)
+float FluidSimulator::computeStableTimeStep(float maxSpeed) const
 {
+    // Advective limit, diffusion is implicit and does not restrict the step
+    if (maxSpeed > 0)
+    {
+        float courantNumber = mAdvectionScheme == AdvectionScheme::CENTERED ? COURANT_NUMBER : SEMI_LAGRANGIAN_COURANT_NUMBER;
+        if (mBackend == FluidBackend::LATTICE_BOLTZMANN)
+        {
+            courantNumber = LATTICE_SPEED_LIMIT;
+        }
+        return courantNumber * mEdgeLenght / maxSpeed;
+    }
+    return std::numeric_limits<float>::infinity();
+}
+
+void FluidSimulator::simulate(float dt)
+{
+    // Lattice streams and collides in a single pass without relaxation sweeps
+    if (mBackend == FluidBackend::LATTICE_BOLTZMANN)
+    {
+        mupLatticeBoltzmann->step(dt, mEdgeLenght, VISCOSITY);
+        mConvergenceInfo = { 1, 0.f, true };
+        return;
+    }
+
+    // Transport by advector happens first, so bricks are marked by advected velocity
+    mupAdvector->advect(dt, mEdgeLenght, mAdvectionScheme);
+
+    // Collect bricks with fluid in motion
+    mupActiveBricks->update(dt);
+
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mMaterialsSSBO);
 
 	if (mFanCount > 0)
@@ -77,38 +178,207 @@ void FluidSimulator::nextStep(float dt)
     glUseProgram(mFluidSimulationProgram);
 
     glBindImageTexture(0,
-        mStateVolume,
+        mVelocityVolume,
         0,
         GL_TRUE,
         0,
         GL_READ_WRITE,
-        GL_RGBA32F);
+        mVelocityFormat);
 
     glBindImageTexture(1,
-        mLookupVolume,
+        mPropertyVolume,
         0,
         GL_TRUE,
         0,
         GL_READ_ONLY,
-        GL_R32F);
+        GL_R32UI);
+
+    // Temperature is only read for buoyancy
+    glBindImageTexture(2,
+        mTemperatureVolume,
+        0,
+        GL_TRUE,
+        0,
+        GL_READ_ONLY,
+        mTemperatureFormat);
+
+    glBindImageTexture(3,
+        mInitialVelocityVolume,
+        0,
+        GL_TRUE,
+        0,
+        GL_READ_WRITE,
+        mVelocityFormat);
 
     // update volume texture <-> unit location
-    glUniform1i(mStateVolumeLocation, 0);
-    glUniform1i(mLookupVolumeLocation, 1);
+    glUniform1i(mVelocityVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1i(mTemperatureVolumeLocation, 2);
+    glUniform1i(mInitialVelocityVolumeLocation, 3);
 
     // fill uniforms
     glUniform1f(mTimestepLocation, dt);
     glUniform1f(mEdgeLengthLocation, mEdgeLenght);
-    glUniform1i(mRelaxationStepsLocation, mRelaxationSteps);
 	glUniform1i(mFanCountLocation, mFanCount);
+    glUniform1i(mCenteredAdvectionLocation, mAdvectionScheme == AdvectionScheme::CENTERED);
+    glUniform1f(mViscosityLocation, VISCOSITY);
+
+    // Forces with first sweeps, then diffuse until largest change is below tolerance
+    glUniform1i(mStageLocation, 0);
+    mConvergenceInfo = { 0, 0.f, false };
+    if (mRelaxationMethod == RelaxationMethod::JACOBI)
+    {
+        relaxJacobi();
+    }
+    else
+    {
+        relaxRedBlack(dt);
+    }
 
-    glDispatchCompute(mResolution / 8, mResolution / 8, mResolution / 8);
+    // Advection and collision
+    glUniform1i(mStageLocation, 1);
+    mupActiveBricks->dispatch();
 
     glUseProgram(0);
 
-    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    // Next substep or heat simulation reads results
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+
+void FluidSimulator::prepareVolumes()
+{
+    // Velocity after forces, start of diffusion for all sweeps
+    glGenTextures(1, &mInitialVelocityVolume);
+    glBindTexture(GL_TEXTURE_3D, mInitialVelocityVolume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_3D, 0, mVelocityFormat, mResolution, mResolution, mResolution, 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    // Largest update of a sweep, checks alternate between two buffers
+    GLuint initialData = 0;
+    glGenBuffers(2, mMaxUpdateSSBOs);
+    for (GLuint maxUpdateSSBO : mMaxUpdateSSBOs)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &initialData, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void FluidSimulator::relaxJacobi()
+{
+    // All voxels per sweep and several sweeps per dispatch, checked every few sweeps
+    glUniform1i(mColorLocation, -1);
+    glUniform1i(mCheckedSweepLocation, 1);
+    glUniform1f(mOmegaLocation, 1.f);
+    for (int check = 0; mConvergenceInfo.sweeps < mRelaxationSteps; check++)
+    {
+        int sweeps = std::min(mSweepsPerCheck, mRelaxationSteps - mConvergenceInfo.sweeps);
+        resetMaxUpdate(check);
+
+        glUniform1i(mSweepsLocation, sweeps);
+        glUniform1i(mFirstSweepsLocation, mConvergenceInfo.sweeps == 0);
+        mupActiveBricks->dispatch();
+        mConvergenceInfo.sweeps += sweeps;
+
+        // Sweeps read results of previous ones
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+}
+
+void FluidSimulator::relaxRedBlack(float dt)
+{
+    // Voxels of one color only read neighbors of the other color, so each half sweep
+    // is a dispatch of its own and the dispatches synchronize the whole volume
+    float spectralRadius = estimateSpectralRadius(dt);
+    float omega = mRelaxationMethod == RelaxationMethod::SOR ? optimalOmega(spectralRadius) : 1.f;
+    int halfSweeps = 0;
+
+    // Apply forces and save initial velocity without diffusing
+    glUniform1i(mColorLocation, -1);
+    glUniform1i(mSweepsLocation, 0);
+    glUniform1i(mFirstSweepsLocation, 1);
+    glUniform1i(mCheckedSweepLocation, 0);
+    mupActiveBricks->dispatch();
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    glUniform1i(mSweepsLocation, 1);
+    glUniform1i(mFirstSweepsLocation, 0);
+    for (int check = 0; mConvergenceInfo.sweeps < mRelaxationSteps; check++)
+    {
+        int sweeps = std::min(mSweepsPerCheck, mRelaxationSteps - mConvergenceInfo.sweeps);
+        resetMaxUpdate(check);
+        for (int i = 0; i < sweeps; i++)
+        {
+            // Check covers last sweep of the batch
+            glUniform1i(mCheckedSweepLocation, i == sweeps - 1);
+            for (int color = 0; color < 2; color++)
+            {
+                glUniform1i(mColorLocation, color);
+                glUniform1f(mOmegaLocation, omega);
+                mupActiveBricks->dispatch();
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                if (mRelaxationMethod == RelaxationMethod::CHEBYSHEV)
+                {
+                    omega = nextChebyshevOmega(omega, spectralRadius, halfSweeps == 0);
+                }
+                halfSweeps++;
+            }
+        }
+        mConvergenceInfo.sweeps += sweeps;
+
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+}
+
+float FluidSimulator::estimateSpectralRadius(float dt) const
+{
+    // Jacobi iteration of diffusion with six neighbors weighted like the shader does,
+    // damped by the lowest mode of the simulation box
+    float h = dt * VISCOSITY / mEdgeLenght * mEdgeLenght;
+    float radius = 6.f * h / (1.f + 4.f * h);
+    glm::ivec3 extent = mSimulationArea->getSimulationBoxMax() - mSimulationArea->getSimulationBoxMin();
+    int maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    radius *= std::cos(glm::pi<float>() / (float)std::max(maxExtent, 2));
+    return std::min(radius, 0.999f);
+}
+
+void FluidSimulator::resetMaxUpdate(int check) const
+{
+    GLuint zero = 0;
+    GLuint maxUpdateSSBO = mMaxUpdateSSBOs[check % 2];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, maxUpdateSSBO);
 }
 
+bool FluidSimulator::readMaxUpdate(int check)
+{
+    // Result of the check before is read while the GPU relaxes the batch of this one. Convergence
+    // is noticed one batch late, but the pipeline is not drained at every check
+    if (check == 0)
+    {
+        return false;
+    }
+    GLuint maxUpdateBits = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMaxUpdateSSBOs[(check - 1) % 2]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &maxUpdateBits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::memcpy(&mConvergenceInfo.maxUpdate, &maxUpdateBits, sizeof(float));
+    mConvergenceInfo.converged = mConvergenceInfo.maxUpdate <= mTolerance;
+    return mConvergenceInfo.converged;
+}
 
 void FluidSimulator::prepareMaterialSSBO(const std::vector<Materialtype> &materialList)
 {
@@ -194,3 +464,114 @@ int FluidSimulator::getRelaxationSteps()
 {
     return mRelaxationSteps;
 }
+
+void FluidSimulator::setSweepsPerCheck(int sweeps)
+{
+    if (sweeps > 0)
+        mSweepsPerCheck = sweeps;
+    else
+        mSweepsPerCheck = 2;
+}
+
+void FluidSimulator::setTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mTolerance = tolerance;
+    else
+        mTolerance = 0.000001f;
+}
+
+float FluidSimulator::getTolerance() const
+{
+    return mTolerance;
+}
+
+void FluidSimulator::setRelaxationMethod(RelaxationMethod method)
+{
+    mRelaxationMethod = method;
+}
+
+RelaxationMethod FluidSimulator::getRelaxationMethod() const
+{
+    return mRelaxationMethod;
+}
+
+void FluidSimulator::setAdvectionScheme(AdvectionScheme scheme)
+{
+    mAdvectionScheme = scheme;
+}
+
+void FluidSimulator::setBackend(FluidBackend backend)
+{
+    mBackend = backend;
+    if (mBackend == FluidBackend::LATTICE_BOLTZMANN)
+    {
+        if (!mupLatticeBoltzmann)
+        {
+            mupLatticeBoltzmann = std::unique_ptr<LatticeBoltzmann>(new LatticeBoltzmann(*mSimulationArea, mFansSSBO, mFanCount));
+        }
+        mupLatticeBoltzmann->reset();
+    }
+}
+
+FluidBackend FluidSimulator::getBackend() const
+{
+    return mBackend;
+}
+
+ConvergenceInfo FluidSimulator::getConvergenceInfo() const
+{
+    return mConvergenceInfo;
+}
+
+void FluidSimulator::setUseActiveBricks(bool useActiveBricks)
+{
+    mupActiveBricks->setEnabled(useActiveBricks);
+}
+
+void FluidSimulator::setTileSize(int size)
+{
+    // Larger tiles reuse more of their loads, but workgroups are limited in size and shared memory
+    if (size != 0 && size != 4 && size != 8)
+    {
+        std::cout << "Error: tile size " << size << " of fluid simulation is not supported, use 0, 4 or 8" << std::endl;
+        return;
+    }
+    mTileSize = size;
+
+    // Bricks have size of workgroup
+    glDeleteProgram(mFluidSimulationProgram);
+    prepareShader();
+    bool enabled = mupActiveBricks->isEnabled();
+    mupActiveBricks = std::unique_ptr<ActiveBricks>(new ActiveBricks(*mSimulationArea, getGroupSize(), BrickCriterion::FLUID, mMaterialsSSBO, mFansSSBO, mFanCount));
+    mupActiveBricks->setEnabled(enabled);
+}
+
+float FluidSimulator::getViscosity() const
+{
+    return VISCOSITY;
+}
+
+GLuint FluidSimulator::getMaterialsSSBO() const
+{
+    return mMaterialsSSBO;
+}
+
+GLuint FluidSimulator::getFansSSBO() const
+{
+    return mFansSSBO;
+}
+
+int FluidSimulator::getFanCount() const
+{
+    return mFanCount;
+}
+
+int FluidSimulator::getGroupSize() const
+{
+    // Untiled workgroups keep their edge of 8
+    if (mTileSize > 0)
+        return mTileSize;
+    else
+        return 8;
+}
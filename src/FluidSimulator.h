@@ -4,8 +4,15 @@
 #include "Material.h"
 #include "Area.h"
 #include "Fan.h"
+#include "ActiveBricks.h"
+#include "VelocityReduction.h"
+#include "Advector.h"
+#include "LatticeBoltzmann.h"
+#include "ConvergenceInfo.h"
+#include "RelaxationMethod.h"
 #include "externals/OpenGLLoader/gl_core_4_3.h"
 #include <vector>
+#include <memory>
 
 class FluidSimulator
 {
@@ -13,34 +20,84 @@ public:
     FluidSimulator(Area &area, const std::vector<Fan> &fanList);
     ~FluidSimulator();
 
-    void nextStep(float dt);
+    void simulate(float dt);
+    float measureMaxSpeed(); // Of the previous frame, the reduction is read back with one frame of lag
+    float computeStableTimeStep(float maxSpeed) const;
     float getMEdgeLenght(); const
     void setMEdgeLenght(float edgeLenght);
-    void setRelaxationSteps(int steps);
+    void setRelaxationSteps(int steps); // Maximum of sweeps per step
     int getRelaxationSteps();
+    void setSweepsPerCheck(int sweeps);
+    void setTolerance(float tolerance);
+    float getTolerance() const;
+    void setRelaxationMethod(RelaxationMethod method);
+    RelaxationMethod getRelaxationMethod() const;
+    void setAdvectionScheme(AdvectionScheme scheme);
+    void setBackend(FluidBackend backend);
+    FluidBackend getBackend() const;
+    ConvergenceInfo getConvergenceInfo() const;
+    void setUseActiveBricks(bool useActiveBricks);
+    void setTileSize(int size); // Edge of workgroups and their tiles in shared memory, 4 or 8. Untiled with 0
+    float estimateSpectralRadius(float dt) const;
+    float getViscosity() const;
+    GLuint getMaterialsSSBO() const;
+    GLuint getFansSSBO() const;
+    int getFanCount() const;
 
 private:
     GLuint mFluidSimulationProgram;
-    GLuint mStateVolume;
-    GLuint mLookupVolume;
+    GLuint mVelocityVolume;
+    GLuint mTemperatureVolume;
+    GLuint mPropertyVolume;
+    GLenum mTemperatureFormat;
+    GLenum mVelocityFormat;
+    GLuint mInitialVelocityVolume;
     GLuint mMaterialsSSBO;
     GLuint mFansSSBO;
+    GLuint mMaxUpdateSSBOs[2];
 
-    int mStateVolumeLocation;
+    int mVelocityVolumeLocation;
+    int mTemperatureVolumeLocation;
+    int mInitialVelocityVolumeLocation;
     int mTimestepLocation;
-    int mRelaxationStepsLocation;
+    int mStageLocation;
+    int mSweepsLocation;
+    int mFirstSweepsLocation;
+    int mColorLocation;
+    int mCheckedSweepLocation;
+    int mCenteredAdvectionLocation;
+    int mOmegaLocation;
+    int mViscosityLocation;
     int mEdgeLengthLocation;
 	int mFanCountLocation;
-    int mLookupVolumeLocation;
+    int mPropertyVolumeLocation;
     float mEdgeLenght;
     int mRelaxationSteps;
+    int mSweepsPerCheck;
+    float mTolerance;
+    RelaxationMethod mRelaxationMethod;
+    AdvectionScheme mAdvectionScheme;
+    FluidBackend mBackend;
+    ConvergenceInfo mConvergenceInfo;
+    int mTileSize;
 	int mFanCount;
+    float mMaxFanSpeed;
 
     Area* mSimulationArea;
+    std::unique_ptr<ActiveBricks> mupActiveBricks;
+    std::unique_ptr<VelocityReduction> mupVelocityReduction;
+    std::unique_ptr<Advector> mupAdvector;
+    std::unique_ptr<LatticeBoltzmann> mupLatticeBoltzmann; // Created when backend is selected
 
     void prepareShader();
+    int getGroupSize() const;
     void prepareMaterialSSBO(const std::vector<Materialtype> &materialList);
     void prepareFansSSBO(const std::vector<Fan> &fanList);
+    void prepareVolumes();
+    void resetMaxUpdate(int check) const;
+    bool readMaxUpdate(int check);
+    void relaxJacobi();
+    void relaxRedBlack(float dt);
 
     int mResolution;
     int mVoxelCount;
@@ -0,0 +1,167 @@
+#ifndef FUSEDSIMULATIONSHADER_H_
+#define FUSEDSIMULATIONSHADER_H_
+
+// Storage formats of temperature and velocity are prepended as defines.
+// Fluid and heat update of the simulation box in one traversal per half sweep. Property and materials
+// of the voxel and its neighbors are loaded once and used by diffusion of velocity and conduction of heat
+const char* fusedSimComputeShader =
+
+// Structs
+"struct Mat{\n"
+"   vec4 color;\n"
+"   vec4 cisf;\n"
+"   vec4 dppp;\n"
+"};\n"
+"struct FanStruct{\n"
+"   vec3 position;\n"
+"   float speed;\n"
+"   vec3 direction;\n"
+"   float distance;\n"
+"};\n"
+
+// Workgroup settings
+"layout(local_size_x=8, local_size_y=8, local_size_z=8) in;\n"
+
+// SSBOs
+"layout(std430, binding = 0) buffer Material\n"
+"{\n"
+"   Mat m[];\n"
+"};\n"
+"layout(std430, binding = 1) buffer Fan\n"
+"{\n"
+"   FanStruct fans[];\n"
+"};\n"
+"layout(std430, binding = 3) buffer MaxUpdate\n"
+"{\n"
+"   uint fluidMaxUpdateBits;\n" // Largest changes of last sweep, positive floats keep their order as uint
+"   uint heatMaxUpdateBits;\n"
+"};\n"
+
+// Uniforms
+"layout(VELOCITY_FORMAT, location = 0) uniform image3D velocityVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 2) uniform image3D temperatureVolume;\n"
+"layout(VELOCITY_FORMAT, location = 3) uniform image3D initialVelocityVolume;\n" // Velocity after forces
+"layout(TEMPERATURE_FORMAT, location = 4) uniform image3D previousTemperatureVolume;\n" // Temperature at begin of step
+"uniform int pass;\n" // 0: forces and begin of step, 1: half sweep, 2: heater and limitation, 3: collision
+"uniform int color;\n" // Parity of half sweep
+"uniform bool checkedSweep;\n" // Changes are measured only in the last sweep of a batch
+"uniform float fluidOmega;\n"
+"uniform float heatOmega;\n"
+"uniform float timeStep;\n"
+"uniform float edgeLength;\n"
+"uniform float viscosity;\n"
+"uniform float conductanceScale;\n"
+"uniform ivec3 boxMin;\n"
+"uniform ivec3 boxMax;\n"
+"uniform int fanCount;\n"
+
+// Consts, same as in the separate simulations
+"const float thermalExpansionCoefficient = 0.00025;\n"
+"const float limitation = 0.07;\n"
+"const uint materialMask = 0xFFu;\n"
+"const uint neighborFluidShift = 8;\n" // +x, -x, +y, -y, +z, -z
+"const uint selfFluid = 1u << 14;\n"
+"const ivec3 offsets[6] = ivec3[6](ivec3(1,0,0), ivec3(-1,0,0), ivec3(0,1,0), ivec3(0,-1,0), ivec3(0,0,1), ivec3(0,0,-1));\n"
+
+// Wind of fans, strongest one wins against the velocity
+"vec3 wind(ivec3 coords, vec3 velocity)\n"
+"{\n"
+"   for(int i = 0; i < fanCount; i++)\n"
+"   {\n"
+"       vec3 relCoords = vec3(coords) / float(imageSize(velocityVolume).x);\n"
+"       float inFront = max(0,sign(dot(-fans[i].position+relCoords, fans[i].direction)));\n"
+"       float distanceFalloff = 1.0 - clamp(abs(length(relCoords - fans[i].position)) / 0.2, 0, 1);\n"
+"       vec3 wind = distanceFalloff * inFront * fans[i].direction * fans[i].speed;\n"
+"       velocity = length(wind) > length(velocity) ? wind : velocity;\n"
+"   }\n"
+"   return velocity;\n"
+"}\n"
+
+// Main
+"void main()\n"
+"{\n"
+"   ivec3 coords = boxMin + ivec3(gl_GlobalInvocationID);\n"
+"   if(any(greaterThanEqual(coords, boxMax))) { return; }\n"
+"   uint myProperty = imageLoad(propertyVolume, coords).x;\n"
+"   bool fluid = (myProperty & selfFluid) != 0u;\n"
+"   int myLookup = int(myProperty & materialMask);\n"
+"   vec3 myVelocity = imageLoad(velocityVolume, coords).xyz;\n"
+"   float myTemperature = imageLoad(temperatureVolume, coords).x;\n"
+
+"   if(pass == 0)\n"
+"   {\n"
+//      Fans and upthrust, then both fields are saved as start of the implicit step
+"       myVelocity = wind(coords, myVelocity);\n"
+"       myVelocity.y += thermalExpansionCoefficient * timeStep * myTemperature;\n"
+"       imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
+"       imageStore(initialVelocityVolume, coords, vec4(myVelocity, 0));\n"
+"       imageStore(previousTemperatureVolume, coords, vec4(myTemperature));\n"
+"   }\n"
+"   else if(pass == 1)\n"
+"   {\n"
+"       if(((coords.x + coords.y + coords.z) & 1) != color) { return; }\n"
+"       float rij = m[myLookup].cisf.x;\n"
+"       float sij = m[myLookup].cisf.z * m[myLookup].dppp.x / timeStep;\n"
+"       float h = timeStep * viscosity / edgeLength * edgeLength;\n"
+"       float conductanceSum = 0;\n"
+"       float heatSum = 0;\n"
+"       vec3 velocitySum = vec3(0);\n"
+//      One load of property, temperature and velocity per neighbor
+"       for(int i = 0; i < 6; i++)\n"
+"       {\n"
+"           ivec3 neighbor = coords + offsets[i];\n"
+"           int neighborLookup = int(imageLoad(propertyVolume, neighbor).x & materialMask);\n"
+"           float conductance = conductanceScale * (rij + m[neighborLookup].cisf.x);\n"
+"           conductanceSum += conductance;\n"
+"           heatSum += conductance * imageLoad(temperatureVolume, neighbor).x;\n"
+"           velocitySum += imageLoad(velocityVolume, neighbor).xyz;\n"
+"       }\n"
+//      Conduction
+"       float relaxedTemperature = (sij * imageLoad(previousTemperatureVolume, coords).x + heatSum) / (sij + conductanceSum);\n"
+"       relaxedTemperature = mix(myTemperature, relaxedTemperature, heatOmega);\n"
+"       imageStore(temperatureVolume, coords, vec4(relaxedTemperature));\n"
+"       uint heatChangeBits = floatBitsToUint(abs(relaxedTemperature - myTemperature));\n"
+"       if(checkedSweep && heatChangeBits > heatMaxUpdateBits) { atomicMax(heatMaxUpdateBits, heatChangeBits); }\n" // Skip atomics that cannot raise the maximum
+//      Diffusion of velocity with the normalization of the stencil solver
+"       vec3 relaxedVelocity = (imageLoad(initialVelocityVolume, coords).xyz + h * velocitySum) / (1 + 2 * (h + h));\n"
+"       relaxedVelocity = mix(myVelocity, relaxedVelocity, fluidOmega);\n"
+"       imageStore(velocityVolume, coords, vec4(relaxedVelocity, 0));\n"
+"       vec3 difference = abs(relaxedVelocity - myVelocity);\n"
+"       uint fluidChangeBits = floatBitsToUint(max(difference.x, max(difference.y, difference.z)));\n"
+"       if(checkedSweep && fluidChangeBits > fluidMaxUpdateBits) { atomicMax(fluidMaxUpdateBits, fluidChangeBits); }\n"
+"   }\n"
+"   else if(pass == 2)\n"
+"   {\n"
+"       float internalHeat = m[myLookup].cisf.y;\n"
+"       if(internalHeat > 0)\n"
+"       {\n"
+"           imageStore(temperatureVolume, coords, vec4(internalHeat));\n"
+"       }\n"
+"       if(fluid)\n"
+"       {\n"
+"           myVelocity = clamp(myVelocity, vec3(-limitation), vec3(limitation));\n"
+"           imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
+"       }\n"
+"   }\n"
+"   else if(!fluid)\n"
+"   {\n"
+//      Solid voxels mirror a fluid neighbor, same precedence of neighbors as in the stencil solver
+"       const int precedence[6] = int[6](4, 5, 2, 3, 1, 0);\n"
+"       uint neighborFluid = myProperty >> neighborFluidShift;\n"
+"       myVelocity = vec3(0);\n"
+"       for(int j = 0; j < 6; j++)\n"
+"       {\n"
+"           int i = precedence[j];\n"
+"           if((neighborFluid & (1u << uint(i))) != 0u)\n"
+"           {\n"
+"               myVelocity = imageLoad(velocityVolume, coords + offsets[i]).xyz;\n"
+"               myVelocity[i / 2] = -myVelocity[i / 2];\n"
+"               break;\n"
+"           }\n"
+"       }\n"
+"       imageStore(velocityVolume, coords, vec4(myVelocity, 0));\n"
+"   }\n"
+"}\n";
+
+#endif // FUSEDSIMULATIONSHADER_H_
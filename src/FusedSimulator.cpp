@@ -0,0 +1,338 @@
+#include "FusedSimulator.h"
+#include "FusedSimulationShader.h"
+#include "RelaxationMethod.h"
+#include "TimeStepLimits.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+FusedSimulator::FusedSimulator(Area &area, FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator)
+{
+    mResolution = area.getResolution();
+    mBoxMin = area.getSimulationBoxMin();
+    mBoxMax = area.getSimulationBoxMax();
+
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mTemperatureVolume = area.getTemperatureVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mTemperatureFormat = area.getTemperatureFormat();
+    mVelocityFormat = area.getVelocityFormat();
+
+    mSimulationArea = &area;
+    mpFluidSimulator = &fluidSimulator;
+    mpHeatSimulator = &heatSimulator;
+
+    mRelaxationSteps = 5;
+    mSweepsPerCheck = 2;
+    mFluidTolerance = 0.000001f;
+    mHeatTolerance = 0.001f;
+    mAdvectionScheme = AdvectionScheme::SEMI_LAGRANGIAN;
+    mFluidConvergenceInfo = { 0, 0.f, false };
+    mHeatConvergenceInfo = { 0, 0.f, false };
+    mSubstepCount = 1;
+    mSubstepsClamped = false;
+
+    // Fused pass implements only the stencil backend with Chebyshev accelerated red-black sweeps
+    if (fluidSimulator.getBackend() != FluidBackend::STENCIL)
+    {
+        std::cout << "Warning: fused simulation ignores the fluid backend and uses the stencil solver" << std::endl;
+    }
+    if (fluidSimulator.getRelaxationMethod() != RelaxationMethod::CHEBYSHEV
+        || heatSimulator.getRelaxationMethod() != RelaxationMethod::CHEBYSHEV)
+    {
+        std::cout << "Warning: fused simulation ignores the relaxation methods and uses Chebyshev acceleration" << std::endl;
+    }
+
+    prepareVolumes();
+    prepareShader();
+
+    mupVelocityAdvector = std::unique_ptr<Advector>(new Advector(area, mVelocityVolume, mVelocityFormat, "VELOCITY_FORMAT"));
+    mupTemperatureAdvector = std::unique_ptr<Advector>(new Advector(area, mTemperatureVolume, mTemperatureFormat, "TEMPERATURE_FORMAT"));
+}
+
+FusedSimulator::~FusedSimulator()
+{
+    glDeleteProgram(mFusedSimulationProgram);
+    glDeleteTextures(1, &mInitialVelocityVolume);
+    glDeleteTextures(1, &mPreviousTemperatureVolume);
+    glDeleteBuffers(2, mMaxUpdateSSBOs);
+}
+
+void FusedSimulator::prepareShader()
+{
+    // Storage formats are prepended as defines
+    std::string source = std::string("#version 430 core\n") + mSimulationArea->getStorageFormatDefines() + fusedSimComputeShader;
+    const char* pSource = source.c_str();
+
+    mFusedSimulationProgram = glCreateProgram();
+    GLint fusedSimulationCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(fusedSimulationCS, 1, &pSource, NULL);
+    glCompileShader(fusedSimulationCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(fusedSimulationCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(fusedSimulationCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mFusedSimulationProgram, fusedSimulationCS);
+    glLinkProgram(mFusedSimulationProgram);
+    glDetachShader(mFusedSimulationProgram, fusedSimulationCS);
+    glDeleteShader(fusedSimulationCS);
+
+    mVelocityVolumeLocation = glGetUniformLocation(mFusedSimulationProgram, "velocityVolume");
+    mPropertyVolumeLocation = glGetUniformLocation(mFusedSimulationProgram, "propertyVolume");
+    mTemperatureVolumeLocation = glGetUniformLocation(mFusedSimulationProgram, "temperatureVolume");
+    mInitialVelocityVolumeLocation = glGetUniformLocation(mFusedSimulationProgram, "initialVelocityVolume");
+    mPreviousTemperatureVolumeLocation = glGetUniformLocation(mFusedSimulationProgram, "previousTemperatureVolume");
+    mPassLocation = glGetUniformLocation(mFusedSimulationProgram, "pass");
+    mColorLocation = glGetUniformLocation(mFusedSimulationProgram, "color");
+    mCheckedSweepLocation = glGetUniformLocation(mFusedSimulationProgram, "checkedSweep");
+    mFluidOmegaLocation = glGetUniformLocation(mFusedSimulationProgram, "fluidOmega");
+    mHeatOmegaLocation = glGetUniformLocation(mFusedSimulationProgram, "heatOmega");
+    mTimestepLocation = glGetUniformLocation(mFusedSimulationProgram, "timeStep");
+    mEdgeLengthLocation = glGetUniformLocation(mFusedSimulationProgram, "edgeLength");
+    mViscosityLocation = glGetUniformLocation(mFusedSimulationProgram, "viscosity");
+    mConductanceScaleLocation = glGetUniformLocation(mFusedSimulationProgram, "conductanceScale");
+    mBoxMinLocation = glGetUniformLocation(mFusedSimulationProgram, "boxMin");
+    mBoxMaxLocation = glGetUniformLocation(mFusedSimulationProgram, "boxMax");
+    mFanCountLocation = glGetUniformLocation(mFusedSimulationProgram, "fanCount");
+}
+
+void FusedSimulator::prepareVolumes()
+{
+    // Velocity after forces, start of diffusion for all sweeps
+    glGenTextures(1, &mInitialVelocityVolume);
+    glBindTexture(GL_TEXTURE_3D, mInitialVelocityVolume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_3D, 0, mVelocityFormat, mResolution, mResolution, mResolution, 0, GL_RGBA, GL_FLOAT, NULL);
+
+    // Temperature at begin of step, used by all sweeps
+    glGenTextures(1, &mPreviousTemperatureVolume);
+    glBindTexture(GL_TEXTURE_3D, mPreviousTemperatureVolume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_3D, 0, mTemperatureFormat, mResolution, mResolution, mResolution, 0, GL_RED, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    // Largest updates of fluid and heat of a sweep, checks alternate between two buffers
+    GLuint initialData[2] = { 0, 0 };
+    glGenBuffers(2, mMaxUpdateSSBOs);
+    for (GLuint maxUpdateSSBO : mMaxUpdateSSBOs)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(initialData), initialData, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void FusedSimulator::nextStep(float dt)
+{
+    // Common time step is the one of the faster system
+    float maxSpeed = mpFluidSimulator->measureMaxSpeed();
+    float stableTimeStep = std::min(mpFluidSimulator->computeStableTimeStep(maxSpeed), mpHeatSimulator->computeStableTimeStep(maxSpeed));
+    mSubstepCount = countSubsteps(dt, stableTimeStep, mSubstepsClamped);
+    for (int i = 0; i < mSubstepCount; i++)
+    {
+        simulate(dt / mSubstepCount);
+    }
+}
+
+int FusedSimulator::getSubstepCount() const
+{
+    return mSubstepCount;
+}
+
+void FusedSimulator::simulate(float dt)
+{
+    float edgeLength = mpFluidSimulator->getMEdgeLenght();
+
+    // Transport of both fields before the implicit part
+    mupVelocityAdvector->advect(dt, edgeLength, mAdvectionScheme);
+    mupTemperatureAdvector->advect(dt, edgeLength, mAdvectionScheme);
+
+    glUseProgram(mFusedSimulationProgram);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mpFluidSimulator->getMaterialsSSBO());
+    if (mpFluidSimulator->getFanCount() > 0)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mpFluidSimulator->getFansSSBO());
+    }
+
+    glBindImageTexture(0, mVelocityVolume, 0, GL_TRUE, 0, GL_READ_WRITE, mVelocityFormat);
+    glBindImageTexture(1, mPropertyVolume, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+    glBindImageTexture(2, mTemperatureVolume, 0, GL_TRUE, 0, GL_READ_WRITE, mTemperatureFormat);
+    glBindImageTexture(3, mInitialVelocityVolume, 0, GL_TRUE, 0, GL_READ_WRITE, mVelocityFormat);
+    glBindImageTexture(4, mPreviousTemperatureVolume, 0, GL_TRUE, 0, GL_READ_WRITE, mTemperatureFormat);
+
+    // update volume texture <-> unit location
+    glUniform1i(mVelocityVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1i(mTemperatureVolumeLocation, 2);
+    glUniform1i(mInitialVelocityVolumeLocation, 3);
+    glUniform1i(mPreviousTemperatureVolumeLocation, 4);
+
+    // fill uniforms
+    glUniform1f(mTimestepLocation, dt);
+    glUniform1f(mEdgeLengthLocation, edgeLength);
+    glUniform1f(mViscosityLocation, mpFluidSimulator->getViscosity());
+    glUniform1f(mConductanceScaleLocation, mpHeatSimulator->getConductanceScale());
+    glUniform3i(mBoxMinLocation, mBoxMin.x, mBoxMin.y, mBoxMin.z);
+    glUniform3i(mBoxMaxLocation, mBoxMax.x, mBoxMax.y, mBoxMax.z);
+    glUniform1i(mFanCountLocation, mpFluidSimulator->getFanCount());
+
+    // Forces and begin of step
+    dispatch(0);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // Chebyshev accelerated red-black sweeps, each system with its own spectral radius
+    float fluidSpectralRadius = mpFluidSimulator->estimateSpectralRadius(dt);
+    float heatSpectralRadius = mpHeatSimulator->estimateSpectralRadius(dt);
+    float fluidOmega = 1.f;
+    float heatOmega = 1.f;
+    int halfSweeps = 0;
+    int sweeps = 0;
+    mFluidConvergenceInfo = { 0, 0.f, false };
+    mHeatConvergenceInfo = { 0, 0.f, false };
+    for (int check = 0; sweeps < mRelaxationSteps; check++)
+    {
+        int batch = std::min(mSweepsPerCheck, mRelaxationSteps - sweeps);
+        resetMaxUpdate(check);
+        for (int i = 0; i < batch; i++)
+        {
+            // Check covers last sweep of the batch
+            glUniform1i(mCheckedSweepLocation, i == batch - 1);
+            for (int color = 0; color < 2; color++)
+            {
+                glUniform1i(mColorLocation, color);
+                glUniform1f(mFluidOmegaLocation, fluidOmega);
+                glUniform1f(mHeatOmegaLocation, heatOmega);
+                dispatch(1);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                fluidOmega = nextChebyshevOmega(fluidOmega, fluidSpectralRadius, halfSweeps == 0);
+                heatOmega = nextChebyshevOmega(heatOmega, heatSpectralRadius, halfSweeps == 0);
+                halfSweeps++;
+            }
+        }
+        sweeps += batch;
+        mFluidConvergenceInfo.sweeps = sweeps;
+        mHeatConvergenceInfo.sweeps = sweeps;
+
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+
+    // Heater and limitation, then solid voxels mirror the final velocity of their neighbors
+    dispatch(2);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    dispatch(3);
+
+    glUseProgram(0);
+
+    // Next substep reads results
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void FusedSimulator::dispatch(int pass) const
+{
+    glm::ivec3 extent = mBoxMax - mBoxMin;
+    glUniform1i(mPassLocation, pass);
+    glDispatchCompute((extent.x + 7) / 8, (extent.y + 7) / 8, (extent.z + 7) / 8);
+}
+
+void FusedSimulator::resetMaxUpdate(int check) const
+{
+    GLuint zero[2] = { 0, 0 };
+    GLuint maxUpdateSSBO = mMaxUpdateSSBOs[check % 2];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, maxUpdateSSBO);
+}
+
+bool FusedSimulator::readMaxUpdate(int check)
+{
+    // Result of the check before is read while the GPU relaxes the batch of this one. Convergence
+    // is noticed one batch late, but the pipeline is not drained at every check
+    if (check == 0)
+    {
+        return false;
+    }
+    GLuint maxUpdateBits[2] = { 0, 0 };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMaxUpdateSSBOs[(check - 1) % 2]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(maxUpdateBits), maxUpdateBits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::memcpy(&mFluidConvergenceInfo.maxUpdate, &maxUpdateBits[0], sizeof(float));
+    std::memcpy(&mHeatConvergenceInfo.maxUpdate, &maxUpdateBits[1], sizeof(float));
+    mFluidConvergenceInfo.converged = mFluidConvergenceInfo.maxUpdate <= mFluidTolerance;
+    mHeatConvergenceInfo.converged = mHeatConvergenceInfo.maxUpdate <= mHeatTolerance;
+    return mFluidConvergenceInfo.converged && mHeatConvergenceInfo.converged;
+}
+
+void FusedSimulator::setRelaxationSteps(int steps)
+{
+    if (steps > 0)
+        mRelaxationSteps = steps;
+    else
+        mRelaxationSteps = 5;
+}
+
+void FusedSimulator::setSweepsPerCheck(int sweeps)
+{
+    if (sweeps > 0)
+        mSweepsPerCheck = sweeps;
+    else
+        mSweepsPerCheck = 2;
+}
+
+void FusedSimulator::setFluidTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mFluidTolerance = tolerance;
+    else
+        mFluidTolerance = 0.000001f;
+}
+
+void FusedSimulator::setHeatTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mHeatTolerance = tolerance;
+    else
+        mHeatTolerance = 0.001f;
+}
+
+void FusedSimulator::setAdvectionScheme(AdvectionScheme scheme)
+{
+    if (scheme != AdvectionScheme::CENTERED)
+        mAdvectionScheme = scheme;
+    else
+        mAdvectionScheme = AdvectionScheme::SEMI_LAGRANGIAN;
+}
+
+ConvergenceInfo FusedSimulator::getFluidConvergenceInfo() const
+{
+    return mFluidConvergenceInfo;
+}
+
+ConvergenceInfo FusedSimulator::getHeatConvergenceInfo() const
+{
+    return mHeatConvergenceInfo;
+}
@@ -0,0 +1,90 @@
+#ifndef FUSEDSIMULATOR_H_
+#define FUSEDSIMULATOR_H_
+
+#include "Area.h"
+#include "FluidSimulator.h"
+#include "HeatSimulator.h"
+#include "Advector.h"
+#include "ConvergenceInfo.h"
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+#include <memory>
+
+// Advances fluid and heat simulation with a common time step, where each half sweep of the implicit
+// diffusion of velocity and conduction of heat is a single pass over the simulation box. Neighbors
+// are loaded once for both systems and there is no barrier between them. Settings like edge length,
+// stable time steps and spectral radii are taken from the separate simulators. Transport is done by
+// advectors, as the centered schemes need synchronization within the pass. Backend and relaxation
+// methods of the separate simulators are ignored, with a warning when they are set
+class FusedSimulator
+{
+public:
+    FusedSimulator(Area &area, FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator);
+    ~FusedSimulator();
+
+    void nextStep(float dt);
+    void simulate(float dt);
+    int getSubstepCount() const;
+    void setRelaxationSteps(int steps); // Maximum of sweeps per step
+    void setSweepsPerCheck(int sweeps);
+    void setFluidTolerance(float tolerance);
+    void setHeatTolerance(float tolerance);
+    void setAdvectionScheme(AdvectionScheme scheme); // Centered scheme falls back to semi-Lagrangian
+    ConvergenceInfo getFluidConvergenceInfo() const;
+    ConvergenceInfo getHeatConvergenceInfo() const;
+
+private:
+    void prepareShader();
+    void prepareVolumes();
+    void resetMaxUpdate(int check) const;
+    bool readMaxUpdate(int check);
+    void dispatch(int pass) const;
+
+    GLuint mFusedSimulationProgram;
+    GLuint mVelocityVolume;
+    GLuint mTemperatureVolume;
+    GLuint mPropertyVolume;
+    GLenum mTemperatureFormat;
+    GLenum mVelocityFormat;
+    GLuint mInitialVelocityVolume;
+    GLuint mPreviousTemperatureVolume;
+    GLuint mMaxUpdateSSBOs[2];
+
+    int mVelocityVolumeLocation;
+    int mPropertyVolumeLocation;
+    int mTemperatureVolumeLocation;
+    int mInitialVelocityVolumeLocation;
+    int mPreviousTemperatureVolumeLocation;
+    int mPassLocation;
+    int mColorLocation;
+    int mCheckedSweepLocation;
+    int mFluidOmegaLocation;
+    int mHeatOmegaLocation;
+    int mTimestepLocation;
+    int mEdgeLengthLocation;
+    int mViscosityLocation;
+    int mConductanceScaleLocation;
+    int mBoxMinLocation;
+    int mBoxMaxLocation;
+    int mFanCountLocation;
+
+    int mRelaxationSteps;
+    int mSweepsPerCheck;
+    float mFluidTolerance;
+    float mHeatTolerance;
+    AdvectionScheme mAdvectionScheme;
+    ConvergenceInfo mFluidConvergenceInfo;
+    ConvergenceInfo mHeatConvergenceInfo;
+    int mSubstepCount;
+    bool mSubstepsClamped;
+
+    Area* mSimulationArea;
+    FluidSimulator* mpFluidSimulator;
+    HeatSimulator* mpHeatSimulator;
+    std::unique_ptr<Advector> mupVelocityAdvector;
+    std::unique_ptr<Advector> mupTemperatureAdvector;
+    int mResolution;
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mBoxMax;
+};
+
+#endif // FUSEDSIMULATOR_H_
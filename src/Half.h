@@ -0,0 +1,139 @@
+#ifndef HALF_H_
+#define HALF_H_
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+// Conversion between 32 bit floats and 16 bit halfs for upload and readback of volumes.
+// Uses F16C instructions when compiled for them, otherwise the scalar versions below
+
+// Round to nearest even, overflow results in infinity
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Infinity and NaN
+    if(exponent == 0xFF)
+    {
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+
+    int halfExponent = (int)exponent - 127 + 15;
+
+    // Too large
+    if(halfExponent >= 31)
+    {
+        return (uint16_t)(sign | 0x7C00);
+    }
+
+    // Subnormal or zero
+    if(halfExponent <= 0)
+    {
+        if(halfExponent < -10)
+        {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - halfExponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // Carry of rounding may correctly propagate into exponent
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+    if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+inline float halfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+
+    if(exponent == 0)
+    {
+        if(mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // Normalize subnormal
+            exponent = 127 - 15 + 1;
+            while(!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FF;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    }
+    else if(exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void floatsToHalfs(const float* pSource, uint16_t* pTarget, size_t count)
+{
+    size_t i = 0;
+#ifdef __F16C__
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 values = _mm256_loadu_ps(pSource + i);
+        _mm_storeu_si128((__m128i*)(pTarget + i), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        pTarget[i] = floatToHalf(pSource[i]);
+    }
+}
+
+inline void halfsToFloats(const uint16_t* pSource, float* pTarget, size_t count)
+{
+    size_t i = 0;
+#ifdef __F16C__
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i*)(pSource + i));
+        _mm256_storeu_ps(pTarget + i, _mm256_cvtph_ps(values));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        pTarget[i] = halfToFloat(pSource[i]);
+    }
+}
+
+#endif // HALF_H_
@@ -1,36 +1,91 @@
 #ifndef HEATSIMULATIONSHADER_H_
 #define HEATSIMULATIONSHADER_H_
 
+// Storage formats of temperature and velocity, GROUP_SIZE and TILE_SIZE are prepended as defines.
+// With a TILE_SIZE, workgroups are cubic tiles and relaxation reads neighbors from a copy of the tile with
+// halo in shared memory. Without, neighbors are read from the volume
 const char* heatSimComputeShader =
-"#version 430 core\n"
 "struct Mat{\n"
 "   vec4 color;\n"
 "   vec4 cisf;\n"
 "   vec4 dppp;\n"
 "};\n"
-"layout(local_size_x=4, local_size_y=4, local_size_z=4) in;\n"
-"layout(rgba32f, location = 0) uniform image3D stateVolume;\n"
-"layout(r32f, location = 1) uniform image3D lookupVolume;\n"
+"layout(local_size_x=GROUP_SIZE, local_size_y=GROUP_SIZE, local_size_z=GROUP_SIZE) in;\n"
+"layout(TEMPERATURE_FORMAT, location = 0) uniform image3D temperatureVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(VELOCITY_FORMAT, location = 2) uniform image3D velocityVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 3) uniform image3D previousTemperatureVolume;\n" // Temperature at begin of step
 "layout(std430, binding=0) buffer Material\n"
 "{\n"
 "   Mat m[];\n"
 "};\n"
+"layout(std430, binding=2) buffer ActiveBricks\n"
+"{\n"
+"   uint numGroupsX;\n"
+"   uint numGroupsY;\n"
+"   uint numGroupsZ;\n"
+"   uint bricks[];\n"
+"};\n"
+"layout(std430, binding=3) buffer MaxUpdate\n"
+"{\n"
+"   uint maxUpdateBits;\n" // Largest change of last sweep, positive floats keep their order as uint
+"};\n"
 "uniform float timeStep;\n"
 "uniform float edgeLength;\n"
-"uniform int relaxationSteps;\n"
+"uniform int stage;\n" // 0: relaxation sweeps, 1: heater and convection
+"uniform int sweeps;\n"
+"uniform bool firstSweeps;\n"
+"uniform int color;\n" // -1: all voxels, 0 and 1: red or black voxels of red-black ordering
+"uniform bool checkedSweep;\n" // Change is measured only in the last sweep of a batch
+"uniform float omega;\n" // Over-relaxation
+"uniform float conductanceScale;\n" // Weight of conduction between voxels
+"uniform bool centeredConvection;\n"
+"const uint materialMask = 0xFFu;\n"
+"const uint selfFluid = 1u << 14;\n"
+"shared uint groupMaxUpdateBits;\n"
+"#if TILE_SIZE > 0\n"
+"#define TILE_EDGE (TILE_SIZE + 2)\n" // Tile with one voxel of halo on each side
+"shared float temperatureTile[TILE_EDGE * TILE_EDGE * TILE_EDGE];\n"
+"shared int lookupTile[TILE_EDGE * TILE_EDGE * TILE_EDGE];\n"
+"#endif\n"
 "float getTemperature(ivec3 coords){\n"
-"   return imageLoad(stateVolume, coords).x;\n"
+"   return imageLoad(temperatureVolume, coords).x;\n"
+"}\n"
+"bool isRelaxed(ivec3 coords){\n"
+"   return color < 0 || ((coords.x + coords.y + coords.z) & 1) == color;\n"
+"}\n"
+"#if TILE_SIZE > 0\n"
+"ivec3 getTileCoords(int index){\n"
+"   return ivec3(index % TILE_EDGE, (index / TILE_EDGE) % TILE_EDGE, index / (TILE_EDGE * TILE_EDGE));\n"
+"}\n"
+"bool isFaceHalo(ivec3 tileCoords){\n" // Edges and corners of the halo are no neighbors of the tile
+"   ivec3 border = ivec3(equal(tileCoords, ivec3(0))) + ivec3(equal(tileCoords, ivec3(TILE_EDGE - 1)));\n"
+"   return border.x + border.y + border.z == 1;\n"
+"}\n"
+"void loadLookupTile(ivec3 origin){\n" // Whole tile, as lookups do not change during dispatch
+"   for(int i = int(gl_LocalInvocationIndex); i < TILE_EDGE * TILE_EDGE * TILE_EDGE; i += TILE_SIZE * TILE_SIZE * TILE_SIZE){\n"
+"       lookupTile[i] = int(imageLoad(propertyVolume, origin + getTileCoords(i)).x & materialMask);\n"
+"   }\n"
+"}\n"
+"void loadTemperatureHalo(ivec3 origin){\n" // Inner voxels are written by their invocations
+"   for(int i = int(gl_LocalInvocationIndex); i < TILE_EDGE * TILE_EDGE * TILE_EDGE; i += TILE_SIZE * TILE_SIZE * TILE_SIZE){\n"
+"       ivec3 tileCoords = getTileCoords(i);\n"
+"       if(isFaceHalo(tileCoords)) { temperatureTile[i] = getTemperature(origin + tileCoords); }\n"
+"   }\n"
+"}\n"
+"#endif\n"
+"ivec3 getBrickCoords(){\n"
+"   uvec3 brickCount = uvec3(imageSize(temperatureVolume)) / gl_WorkGroupSize;\n"
+"   uint brick = bricks[gl_WorkGroupID.x];\n"
+"   uvec3 brickCoords = uvec3(brick % brickCount.x, (brick / brickCount.x) % brickCount.y, brick / (brickCount.x * brickCount.y));\n"
+"   return ivec3(brickCoords * gl_WorkGroupSize + gl_LocalInvocationID);\n"
 "}\n"
 "void main()\n"
 "{\n"
-//  Hacking values...
-"   float weight = 10000;\n"
 //  Initialize values
-"   ivec3 coords = ivec3(gl_GlobalInvocationID);\n"
-"   float area = 0.5 / edgeLength*edgeLength;\n" // TODO
+"   ivec3 coords = getBrickCoords();\n" // Indirect dispatch over active bricks
 "   float invTimeStep = 1.0 / timeStep;\n" // Quite high, fasten things up
-"   vec4 myState = imageLoad(stateVolume, coords);"
-"   vec4 oldState = myState;\n"
+"   float myTemperature = getTemperature(coords);\n"
 //  Neighors
 "   ivec3 left = ivec3(coords.x+1, coords.y, coords.z);\n"
 "   ivec3 right = ivec3(coords.x-1, coords.y, coords.z);\n"
@@ -39,81 +94,153 @@ const char* heatSimComputeShader =
 "   ivec3 front = ivec3(coords.x, coords.y, coords.z+1);\n"
 "   ivec3 back = ivec3(coords.x, coords.y, coords.z-1);\n"
 //  Pepare neighbor stuff
-"   int myLookup = int(imageLoad(lookupVolume, coords).x);\n"
-"   int leftLookup = int(imageLoad(lookupVolume, left).x);\n"
-"   int rightLookup = int(imageLoad(lookupVolume, right).x);\n"
-"   int topLookup = int(imageLoad(lookupVolume, top).x);\n"
-"   int downLookup = int(imageLoad(lookupVolume, down).x);\n"
-"   int frontookup = int(imageLoad(lookupVolume, front).x);\n"
-"   int backLookup = int(imageLoad(lookupVolume, back).x);\n"
-//  Prepare values for relaxations
-"   float sij = m[myLookup].cisf.z * m[myLookup].dppp.x * invTimeStep;\n"
-"   float rij = m[myLookup].cisf.x;\n"
-"   float axij = weight * area * (rij + m[leftLookup].cisf.x);\n"
-"   float bxij = weight * area * (rij + m[rightLookup].cisf.x);\n"
-"   float ayij = weight * area * (rij + m[topLookup].cisf.x);\n"
-"   float byij = weight * area * (rij + m[downLookup].cisf.x);\n"
-"   float azij = weight * area * (rij + m[frontookup].cisf.x);\n"
-"   float bzij = weight * area * (rij + m[backLookup].cisf.x);\n"
-"   float normalization = 1.0 / (sij + axij + bxij + ayij + byij + azij + bzij);\n"
-//  Do relaxation
-"   for(int i = 0; i < relaxationSteps; i++)\n"
-"   {\n"
-"       myState.x "
-"       = oldState.x * sij"
-"       + axij * getTemperature(left)"
-"       + bxij * getTemperature(right)"
-"       + ayij * getTemperature(top)"
-"       + byij * getTemperature(down)"
-"       + azij * getTemperature(front)"
-"       + bzij * getTemperature(back);"
-"       myState.x *= normalization;\n"
-"       imageStore(stateVolume, coords, myState);\n"
-"       barrier();"
-"   }\n"
-//  Heater
-"   float internalHeat = m[myLookup].cisf.y;"
-"   if(internalHeat > 0)\n"
+"   uint myProperty = imageLoad(propertyVolume, coords).x;\n"
+"   bool fluid = (myProperty & selfFluid) != 0u;\n"
+"   int myLookup = int(myProperty & materialMask);\n"
+"   if(stage == 0)\n"
 "   {\n"
-"       myState.x = internalHeat;\n"
-"       imageStore(stateVolume, coords, myState);\n"
+"       float oldTemperature;\n"
+"       if(firstSweeps)\n"
+"       {\n"
+"           oldTemperature = myTemperature;\n"
+"           imageStore(previousTemperatureVolume, coords, vec4(oldTemperature));\n"
+"       }\n"
+"       else\n"
+"       {\n"
+"           oldTemperature = imageLoad(previousTemperatureVolume, coords).x;\n"
+"       }\n"
+//      Prepare values for relaxations
+"       float sij = m[myLookup].cisf.z * m[myLookup].dppp.x * invTimeStep;\n"
+"       float rij = m[myLookup].cisf.x;\n"
+"#if TILE_SIZE > 0\n"
+//      Tile starts one voxel before the workgroup
+"       ivec3 origin = coords - ivec3(gl_LocalInvocationID) - ivec3(1);\n"
+"       int myIndex = int(gl_LocalInvocationID.x + 1u) + TILE_EDGE * (int(gl_LocalInvocationID.y + 1u) + TILE_EDGE * int(gl_LocalInvocationID.z + 1u));\n"
+"       const int strideY = TILE_EDGE;\n"
+"       const int strideZ = TILE_EDGE * TILE_EDGE;\n"
+"       loadLookupTile(origin);\n"
+"       barrier();\n"
+"       float axij = conductanceScale * (rij + m[lookupTile[myIndex + 1]].cisf.x);\n"
+"       float bxij = conductanceScale * (rij + m[lookupTile[myIndex - 1]].cisf.x);\n"
+"       float ayij = conductanceScale * (rij + m[lookupTile[myIndex + strideY]].cisf.x);\n"
+"       float byij = conductanceScale * (rij + m[lookupTile[myIndex - strideY]].cisf.x);\n"
+"       float azij = conductanceScale * (rij + m[lookupTile[myIndex + strideZ]].cisf.x);\n"
+"       float bzij = conductanceScale * (rij + m[lookupTile[myIndex - strideZ]].cisf.x);\n"
+"#else\n"
+"       int leftLookup = int(imageLoad(propertyVolume, left).x & materialMask);\n"
+"       int rightLookup = int(imageLoad(propertyVolume, right).x & materialMask);\n"
+"       int topLookup = int(imageLoad(propertyVolume, top).x & materialMask);\n"
+"       int downLookup = int(imageLoad(propertyVolume, down).x & materialMask);\n"
+"       int frontookup = int(imageLoad(propertyVolume, front).x & materialMask);\n"
+"       int backLookup = int(imageLoad(propertyVolume, back).x & materialMask);\n"
+"       float axij = conductanceScale * (rij + m[leftLookup].cisf.x);\n"
+"       float bxij = conductanceScale * (rij + m[rightLookup].cisf.x);\n"
+"       float ayij = conductanceScale * (rij + m[topLookup].cisf.x);\n"
+"       float byij = conductanceScale * (rij + m[downLookup].cisf.x);\n"
+"       float azij = conductanceScale * (rij + m[frontookup].cisf.x);\n"
+"       float bzij = conductanceScale * (rij + m[backLookup].cisf.x);\n"
+"#endif\n"
+"       float normalization = 1.0 / (sij + axij + bxij + ayij + byij + azij + bzij);\n"
+//      Do relaxation
+"       float change = 0;\n"
+"       bool relaxed = isRelaxed(coords);\n"
+"       for(int i = 0; i < sweeps; i++)\n"
+"       {\n"
+//          Halo comes from the volume, inner voxels from the invocations
+"#if TILE_SIZE > 0\n"
+"           loadTemperatureHalo(origin);\n"
+"           temperatureTile[myIndex] = myTemperature;\n"
+"           barrier();\n"
+"#endif\n"
+"           if(relaxed)\n"
+"           {\n"
+"#if TILE_SIZE > 0\n"
+"               float relaxedTemperature "
+"               = oldTemperature * sij"
+"               + axij * temperatureTile[myIndex + 1]"
+"               + bxij * temperatureTile[myIndex - 1]"
+"               + ayij * temperatureTile[myIndex + strideY]"
+"               + byij * temperatureTile[myIndex - strideY]"
+"               + azij * temperatureTile[myIndex + strideZ]"
+"               + bzij * temperatureTile[myIndex - strideZ];\n"
+"#else\n"
+"               float relaxedTemperature "
+"               = oldTemperature * sij"
+"               + axij * getTemperature(left)"
+"               + bxij * getTemperature(right)"
+"               + ayij * getTemperature(top)"
+"               + byij * getTemperature(down)"
+"               + azij * getTemperature(front)"
+"               + bzij * getTemperature(back);\n"
+"#endif\n"
+"               relaxedTemperature *= normalization;\n"
+"               relaxedTemperature = mix(myTemperature, relaxedTemperature, omega);\n"
+"               change = abs(relaxedTemperature - myTemperature);\n"
+"               myTemperature = relaxedTemperature;\n"
+"               imageStore(temperatureVolume, coords, vec4(myTemperature));\n"
+"           }\n"
+"           barrier();"
+"       }\n"
+//      Largest change of workgroup goes into global maximum
+"       if(checkedSweep)\n"
+"       {\n"
+"           if(gl_LocalInvocationIndex == 0u)\n"
+"           {\n"
+"               groupMaxUpdateBits = 0u;\n"
+"           }\n"
+"           barrier();\n"
+"           atomicMax(groupMaxUpdateBits, floatBitsToUint(change));\n"
+"           barrier();\n"
+"           if(gl_LocalInvocationIndex == 0u)\n"
+"           {\n"
+"               atomicMax(maxUpdateBits, groupMaxUpdateBits);\n"
+"           }\n"
+"       }\n"
 "   }\n"
-"   barrier();"
-//  Convection (DOES NOT WORK AT THE MOMENT)
-"   float t = 0.5f * timeStep / edgeLength;\n" // 0.5 correct
-"   float temperature;\n"
-"   if(m[myLookup].cisf.w > 0.f)\n"
+"   else\n"
 "   {\n"
-"       vec4 stateLeft = imageLoad(stateVolume, left);\n"
-"       vec4 stateRight = imageLoad(stateVolume, right);\n"
-"       vec4 stateTop = imageLoad(stateVolume, top);\n"
-"       vec4 stateDown = imageLoad(stateVolume, down);\n"
-"       vec4 stateFront = imageLoad(stateVolume, front);\n"
-"       vec4 stateBack = imageLoad(stateVolume, back);\n"
-"       temperature"
-"       = myState.x"
-"       - t * (stateLeft.y * stateLeft.x - stateRight.y * stateRight.x)\n"
-"       - t * (stateTop.z * stateTop.x - stateDown.z * stateDown.x)\n"
-"       - t * (stateFront.w * stateFront.x - stateBack.w * stateFront.x);\n"
-"       imageStore(stateVolume, coords, myState);\n"
-"   }\n"
-"   barrier();\n" // Has to be outside of if
+//  Heater
+"       float internalHeat = m[myLookup].cisf.y;"
+"       if(internalHeat > 0)\n"
+"       {\n"
+"           myTemperature = internalHeat;\n"
+"           imageStore(temperatureVolume, coords, vec4(myTemperature));\n"
+"       }\n"
+"       barrier();"
+//  Convection (DOES NOT WORK AT THE MOMENT), skipped when advector transports temperature
+"       if(centeredConvection)\n"
+"       {\n"
+"           float t = 0.5f * timeStep / edgeLength;\n" // 0.5 correct
+"           float temperature;\n"
+"           if(fluid)\n"
+"           {\n"
+"               temperature"
+"               = myTemperature"
+"               - t * (imageLoad(velocityVolume, left).x * getTemperature(left) - imageLoad(velocityVolume, right).x * getTemperature(right))\n"
+"               - t * (imageLoad(velocityVolume, top).y * getTemperature(top) - imageLoad(velocityVolume, down).y * getTemperature(down))\n"
+"               - t * (imageLoad(velocityVolume, front).z * getTemperature(front) - imageLoad(velocityVolume, back).z * getTemperature(front));\n"
+"               imageStore(temperatureVolume, coords, vec4(myTemperature));\n"
+"           }\n"
+"           barrier();\n" // Has to be outside of if
 //  Save some values
-"   float tempSaveLeft = getTemperature(left);\n"
-"   float tempSaveRight = getTemperature(right);\n"
-"   float tempSaveTop = getTemperature(top);\n"
-"   float tempSaveDown = getTemperature(down);\n"
-"   float tempSaveFront = getTemperature(front);\n"
-"   float tempSaveBack = getTemperature(back);\n"
-"   barrier();\n"
-"   if(m[myLookup].cisf.w > 0.f)\n"
-"   {\n"
-"       myState.x"
-"       = 0.5 * (myState.x + temperature)"
-"       - 0.5 * t * myState.y * (tempSaveLeft - tempSaveRight)"
-"       - 0.5 * t * myState.z * (tempSaveTop - tempSaveDown)"
-"       - 0.5 * t * myState.w * (tempSaveFront - tempSaveBack);\n"
-"       imageStore(stateVolume, coords, myState);\n"
+"           float tempSaveLeft = getTemperature(left);\n"
+"           float tempSaveRight = getTemperature(right);\n"
+"           float tempSaveTop = getTemperature(top);\n"
+"           float tempSaveDown = getTemperature(down);\n"
+"           float tempSaveFront = getTemperature(front);\n"
+"           float tempSaveBack = getTemperature(back);\n"
+"           barrier();\n"
+"           if(fluid)\n"
+"           {\n"
+"               vec3 myVelocity = imageLoad(velocityVolume, coords).xyz;\n"
+"               myTemperature"
+"               = 0.5 * (myTemperature + temperature)"
+"               - 0.5 * t * myVelocity.x * (tempSaveLeft - tempSaveRight)"
+"               - 0.5 * t * myVelocity.y * (tempSaveTop - tempSaveDown)"
+"               - 0.5 * t * myVelocity.z * (tempSaveFront - tempSaveBack);\n"
+"               imageStore(temperatureVolume, coords, vec4(myTemperature));\n"
+"           }\n"
+"       }\n"
 "   }\n"
 "}\n";
 
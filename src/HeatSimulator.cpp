@@ -1,36 +1,92 @@
 #include "HeatSimulator.h"
 #include "HeatSimulationShader.h"
+#include "LineRelaxationShader.h"
+#include "TimeStepLimits.h"
+#include "externals/GLM/glm/gtc/constants.hpp"
 
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <sstream>
+
+// Hacking value for conduction between voxels
+const float CONDUCTANCE_WEIGHT = 10000.f;
+
+// Conduction is tuned per voxel pair and kept fixed over edge lengths, as the original
+// shader divided and multiplied by the edge length
+const float CONDUCTANCE_SCALE = CONDUCTANCE_WEIGHT * 0.5f;
+
+// Fraction of voxel edge the convection may transport heat per step
+const float COURANT_NUMBER = 0.5f;
 
 HeatSimulator::HeatSimulator(Area &area)
 {
     mResolution = area.getResolution();
     mVoxelCount = area.getVoxelCount();
 
-    mStateVolume = area.getStateVolumeHandle();
-    mLookupVolume = area.getLookupVolumeHandle();
+    mTemperatureVolume = area.getTemperatureVolumeHandle();
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mTemperatureFormat = area.getTemperatureFormat();
+    mVelocityFormat = area.getVelocityFormat();
 
     mSimulationArea = &area;
 
     mEdgeLenght = 1.f;
     mRelaxationSteps = 5;
+    mSweepsPerCheck = 2;
+    mTolerance = 0.001f;
+    mRelaxationMethod = RelaxationMethod::JACOBI;
+    mAdvectionScheme = AdvectionScheme::CENTERED;
+    mConvergenceInfo = { 0, 0.f, false };
+    mTileSize = 0;
+
+    // Conductivities of present materials bound the spectral radius
+    for (const Materialtype& type : area.getPresentMaterials())
+    {
+        mPresentMaterials.push_back(area.determineMaterial(type));
+    }
 
     prepareSSBO(area.getMaterialList());
+    prepareVolumes();
     prepareShader();
+    prepareLineShader();
+
+    // Bricks have size of workgroup
+    mupActiveBricks = std::unique_ptr<ActiveBricks>(new ActiveBricks(area, getGroupSize(), BrickCriterion::HEAT, mMaterialsSSBO));
+
+    // Alternative transport of temperature
+    mupAdvector = std::unique_ptr<Advector>(new Advector(area, mTemperatureVolume, mTemperatureFormat, "TEMPERATURE_FORMAT"));
 }
 
 HeatSimulator::~HeatSimulator()
 {
     // Delete shader
     glDeleteProgram(mHeatSimulationProgram);
+    glDeleteProgram(mLineRelaxationProgram);
+
+    glDeleteTextures(1, &mPreviousTemperatureVolume);
+    glDeleteBuffers(2, mMaxUpdateSSBOs);
 }
 
 void HeatSimulator::prepareShader()
 {
+    // Storage formats, workgroup and tile size are prepended as defines
+    std::stringstream source;
+    source << "#version 430 core\n";
+    source << "#define GROUP_SIZE " << getGroupSize() << "\n";
+    source << "#define TILE_SIZE " << mTileSize << "\n";
+    source << mSimulationArea->getStorageFormatDefines();
+    source << heatSimComputeShader;
+    std::string sourceString = source.str();
+    const char* pSource = sourceString.c_str();
+
     mHeatSimulationProgram = glCreateProgram();
     GLint heatSimulationCS = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(heatSimulationCS, 1 , &heatSimComputeShader, NULL);
+    glShaderSource(heatSimulationCS, 1 , &pSource, NULL);
     glCompileShader(heatSimulationCS);
 
     // Get length of compiling log
@@ -55,61 +111,387 @@ void HeatSimulator::prepareShader()
     glDetachShader(mHeatSimulationProgram, heatSimulationCS);
     glDeleteShader(heatSimulationCS);
 
-    mStateVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "stateVolume");
+    mTemperatureVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "temperatureVolume");
+    mVelocityVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "velocityVolume");
+    mPreviousTemperatureVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "previousTemperatureVolume");
     mTimestepLocation = glGetUniformLocation(mHeatSimulationProgram, "timeStep");
-    mRelaxationStepsLocation = glGetUniformLocation(mHeatSimulationProgram, "relaxationSteps");
+    mStageLocation = glGetUniformLocation(mHeatSimulationProgram, "stage");
+    mSweepsLocation = glGetUniformLocation(mHeatSimulationProgram, "sweeps");
+    mFirstSweepsLocation = glGetUniformLocation(mHeatSimulationProgram, "firstSweeps");
+    mColorLocation = glGetUniformLocation(mHeatSimulationProgram, "color");
+    mCheckedSweepLocation = glGetUniformLocation(mHeatSimulationProgram, "checkedSweep");
+    mCenteredConvectionLocation = glGetUniformLocation(mHeatSimulationProgram, "centeredConvection");
+    mOmegaLocation = glGetUniformLocation(mHeatSimulationProgram, "omega");
     mEdgeLengthLocation = glGetUniformLocation(mHeatSimulationProgram,"edgeLength");
-    mLookupVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "lookupVolume");
+    mConductanceScaleLocation = glGetUniformLocation(mHeatSimulationProgram, "conductanceScale");
+    mPropertyVolumeLocation = glGetUniformLocation(mHeatSimulationProgram, "propertyVolume");
+}
+
+void HeatSimulator::prepareLineShader()
+{
+    // Whole line is kept in local arrays of the invocation, sized to the longest line of the box
+    glm::ivec3 extent = mSimulationArea->getSimulationBoxMax() - mSimulationArea->getSimulationBoxMin();
+    std::stringstream source;
+    source << "#version 430 core\n";
+    source << "#define MAX_LINE_LENGTH " << std::max(extent.x, std::max(extent.y, extent.z)) << "\n";
+    source << mSimulationArea->getStorageFormatDefines();
+    source << lineRelaxationComputeShader;
+    std::string sourceString = source.str();
+    const char* pSource = sourceString.c_str();
+
+    mLineRelaxationProgram = glCreateProgram();
+    GLint lineRelaxationCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(lineRelaxationCS, 1, &pSource, NULL);
+    glCompileShader(lineRelaxationCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(lineRelaxationCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(lineRelaxationCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mLineRelaxationProgram, lineRelaxationCS);
+    glLinkProgram(mLineRelaxationProgram);
+    glDetachShader(mLineRelaxationProgram, lineRelaxationCS);
+    glDeleteShader(lineRelaxationCS);
+
+    mLineTemperatureVolumeLocation = glGetUniformLocation(mLineRelaxationProgram, "temperatureVolume");
+    mLinePropertyVolumeLocation = glGetUniformLocation(mLineRelaxationProgram, "propertyVolume");
+    mLinePreviousTemperatureVolumeLocation = glGetUniformLocation(mLineRelaxationProgram, "previousTemperatureVolume");
+    mLineTimestepLocation = glGetUniformLocation(mLineRelaxationProgram, "timeStep");
+    mLineConductanceScaleLocation = glGetUniformLocation(mLineRelaxationProgram, "conductanceScale");
+    mLineDirectionLocation = glGetUniformLocation(mLineRelaxationProgram, "direction");
+    mLineColorLocation = glGetUniformLocation(mLineRelaxationProgram, "color");
+    mLineCheckedSweepLocation = glGetUniformLocation(mLineRelaxationProgram, "checkedSweep");
+    mLineBoxMinLocation = glGetUniformLocation(mLineRelaxationProgram, "boxMin");
+    mLineBoxMaxLocation = glGetUniformLocation(mLineRelaxationProgram, "boxMax");
+}
+
+float HeatSimulator::computeStableTimeStep(float maxSpeed) const
+{
+    // Advective limit of convection, conduction is implicit and does not restrict the step
+    if (maxSpeed > 0)
+    {
+        float courantNumber = mAdvectionScheme == AdvectionScheme::CENTERED ? COURANT_NUMBER : SEMI_LAGRANGIAN_COURANT_NUMBER;
+        return courantNumber * mEdgeLenght / maxSpeed;
+    }
+    return std::numeric_limits<float>::infinity();
 }
 
-void HeatSimulator::nextStep(float dt)
+float HeatSimulator::getConductanceScale() const
 {
+    return CONDUCTANCE_SCALE;
+}
+
+void HeatSimulator::simulate(float dt)
+{
+    // Convection by advector happens first, so bricks are marked by transported temperature
+    mupAdvector->advect(dt, mEdgeLenght, mAdvectionScheme);
+
+    // Collect bricks which are not settled
+    mupActiveBricks->update(dt);
+
 	glUseProgram(mHeatSimulationProgram);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mMaterialsSSBO);
 
     
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_3D, mStateVolume);
+    glBindTexture(GL_TEXTURE_3D, mTemperatureVolume);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_3D, mLookupVolume);
+    glBindTexture(GL_TEXTURE_3D, mPropertyVolume);
 
     glBindImageTexture(0,
-                       mStateVolume,
+                       mTemperatureVolume,
                        0,
                        GL_TRUE,
                        0,
                        GL_READ_WRITE,
-                       GL_RGBA32F);
+                       mTemperatureFormat);
 
     glBindImageTexture(1,
-                       mLookupVolume,
+                       mPropertyVolume,
+                       0,
+                       GL_TRUE,
+                       0,
+                       GL_READ_ONLY,
+                       GL_R32UI);
+
+    // Velocity is only read for convection
+    glBindImageTexture(2,
+                       mVelocityVolume,
                        0,
                        GL_TRUE,
                        0,
                        GL_READ_ONLY,
-                       GL_R32F);
+                       mVelocityFormat);
+
+    glBindImageTexture(3,
+                       mPreviousTemperatureVolume,
+                       0,
+                       GL_TRUE,
+                       0,
+                       GL_READ_WRITE,
+                       mTemperatureFormat);
 
     // update volume texture<->unit location
-    glUniform1i(mStateVolumeLocation, 0);
-    glUniform1i(mLookupVolumeLocation, 1);
+    glUniform1i(mTemperatureVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1i(mVelocityVolumeLocation, 2);
+    glUniform1i(mPreviousTemperatureVolumeLocation, 3);
 
     // update time step location
     glUniform1f(mTimestepLocation, dt);
     glUniform1f(mEdgeLengthLocation, mEdgeLenght);
-    glUniform1i(mRelaxationStepsLocation, mRelaxationSteps);
+    glUniform1f(mConductanceScaleLocation, getConductanceScale());
+    glUniform1i(mCenteredConvectionLocation, mAdvectionScheme == AdvectionScheme::CENTERED);
+
+    // Relax until largest change is below tolerance
+    glUniform1i(mStageLocation, 0);
+    mConvergenceInfo = { 0, 0.f, false };
+    if (mRelaxationMethod == RelaxationMethod::JACOBI)
+    {
+        relaxJacobi();
+    }
+    else if (mRelaxationMethod == RelaxationMethod::LINE)
+    {
+        relaxLines(dt);
+    }
+    else
+    {
+        relaxRedBlack(dt);
+    }
 
-    glDispatchCompute(mResolution/4,mResolution/4,mResolution/4);
+    // Heater and convection
+    glUniform1i(mStageLocation, 1);
+    mupActiveBricks->dispatch();
 
-    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(0, 0, 0, GL_TRUE, 0, GL_READ_WRITE, mTemperatureFormat);
 
     glUseProgram(0);
 
-    //glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    // Next substep or fluid simulation reads results
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 
     glBindTexture(GL_TEXTURE_3D,0);
 }
 
 
+void HeatSimulator::prepareVolumes()
+{
+    // Temperature at begin of step, used by all sweeps
+    glGenTextures(1, &mPreviousTemperatureVolume);
+    glBindTexture(GL_TEXTURE_3D, mPreviousTemperatureVolume);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexImage3D(GL_TEXTURE_3D, 0, mTemperatureFormat, mResolution, mResolution, mResolution, 0, GL_RED, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    // Largest update of a sweep, checks alternate between two buffers
+    GLuint initialData = 0;
+    glGenBuffers(2, mMaxUpdateSSBOs);
+    for (GLuint maxUpdateSSBO : mMaxUpdateSSBOs)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &initialData, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void HeatSimulator::relaxJacobi()
+{
+    // All voxels per sweep and several sweeps per dispatch, checked every few sweeps
+    glUniform1i(mColorLocation, -1);
+    glUniform1i(mCheckedSweepLocation, 1);
+    glUniform1f(mOmegaLocation, 1.f);
+    for (int check = 0; mConvergenceInfo.sweeps < mRelaxationSteps; check++)
+    {
+        int sweeps = std::min(mSweepsPerCheck, mRelaxationSteps - mConvergenceInfo.sweeps);
+        resetMaxUpdate(check);
+
+        glUniform1i(mSweepsLocation, sweeps);
+        glUniform1i(mFirstSweepsLocation, mConvergenceInfo.sweeps == 0);
+        mupActiveBricks->dispatch();
+        mConvergenceInfo.sweeps += sweeps;
+
+        // Sweeps read results of previous ones
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+}
+
+void HeatSimulator::relaxRedBlack(float dt)
+{
+    // Voxels of one color only read neighbors of the other color, so each half sweep
+    // is a dispatch of its own and the dispatches synchronize the whole volume
+    float spectralRadius = estimateSpectralRadius(dt);
+    float omega = mRelaxationMethod == RelaxationMethod::SOR ? optimalOmega(spectralRadius) : 1.f;
+    int halfSweeps = 0;
+
+    // Save temperature at begin of step without relaxing
+    glUniform1i(mColorLocation, -1);
+    glUniform1i(mSweepsLocation, 0);
+    glUniform1i(mFirstSweepsLocation, 1);
+    glUniform1i(mCheckedSweepLocation, 0);
+    mupActiveBricks->dispatch();
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    glUniform1i(mSweepsLocation, 1);
+    glUniform1i(mFirstSweepsLocation, 0);
+    for (int check = 0; mConvergenceInfo.sweeps < mRelaxationSteps; check++)
+    {
+        int sweeps = std::min(mSweepsPerCheck, mRelaxationSteps - mConvergenceInfo.sweeps);
+        resetMaxUpdate(check);
+        for (int i = 0; i < sweeps; i++)
+        {
+            // Check covers last sweep of the batch
+            glUniform1i(mCheckedSweepLocation, i == sweeps - 1);
+            for (int color = 0; color < 2; color++)
+            {
+                glUniform1i(mColorLocation, color);
+                glUniform1f(mOmegaLocation, omega);
+                mupActiveBricks->dispatch();
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                if (mRelaxationMethod == RelaxationMethod::CHEBYSHEV)
+                {
+                    omega = nextChebyshevOmega(omega, spectralRadius, halfSweeps == 0);
+                }
+                halfSweeps++;
+            }
+        }
+        mConvergenceInfo.sweeps += sweeps;
+
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+}
+
+void HeatSimulator::relaxLines(float dt)
+{
+    // Lines cover the whole simulation box, active bricks are not considered.
+    // Thin structures of high conductivity are solved exactly along their extent
+    glm::ivec3 boxMin = mSimulationArea->getSimulationBoxMin();
+    glm::ivec3 boxMax = mSimulationArea->getSimulationBoxMax();
+    glm::ivec3 extent = boxMax - boxMin;
+
+    // Temperature at begin of step of the whole box, after previous passes wrote it
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glCopyImageSubData(
+        mTemperatureVolume, GL_TEXTURE_3D, 0, boxMin.x, boxMin.y, boxMin.z,
+        mPreviousTemperatureVolume, GL_TEXTURE_3D, 0, boxMin.x, boxMin.y, boxMin.z,
+        extent.x, extent.y, extent.z);
+
+    // Images stay bound to the units of the simulation program
+    glUseProgram(mLineRelaxationProgram);
+    glUniform1i(mLineTemperatureVolumeLocation, 0);
+    glUniform1i(mLinePropertyVolumeLocation, 1);
+    glUniform1i(mLinePreviousTemperatureVolumeLocation, 3);
+    glUniform1f(mLineTimestepLocation, dt);
+    glUniform1f(mLineConductanceScaleLocation, getConductanceScale());
+    glUniform3i(mLineBoxMinLocation, boxMin.x, boxMin.y, boxMin.z);
+    glUniform3i(mLineBoxMaxLocation, boxMax.x, boxMax.y, boxMax.z);
+
+    // One sweep solves all lines of each axis, lines of one parity per dispatch
+    for (int check = 0; mConvergenceInfo.sweeps < mRelaxationSteps; check++)
+    {
+        int sweeps = std::min(mSweepsPerCheck, mRelaxationSteps - mConvergenceInfo.sweeps);
+        resetMaxUpdate(check);
+        for (int i = 0; i < sweeps; i++)
+        {
+            // Check covers last sweep of the batch
+            glUniform1i(mLineCheckedSweepLocation, i == sweeps - 1);
+            for (int direction = 0; direction < 3; direction++)
+            {
+                int extentA = extent[(direction + 1) % 3];
+                int extentB = extent[(direction + 2) % 3];
+                glUniform1i(mLineDirectionLocation, direction);
+                for (int color = 0; color < 2; color++)
+                {
+                    glUniform1i(mLineColorLocation, color);
+                    glDispatchCompute((extentA + 7) / 8, (extentB + 7) / 8, 1);
+                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                }
+            }
+        }
+        mConvergenceInfo.sweeps += sweeps;
+
+        if (readMaxUpdate(check))
+        {
+            break;
+        }
+    }
+
+    glUseProgram(mHeatSimulationProgram);
+}
+
+float HeatSimulator::estimateSpectralRadius(float dt) const
+{
+    // Bound of Jacobi iteration per material with most conductive neighbors, which is
+    // damped by the lowest mode of the simulation box like for the plain Laplacian
+    float maxConductivity = 0.f;
+    for (const Material& material : mPresentMaterials)
+    {
+        maxConductivity = std::max(maxConductivity, material.cisf.x);
+    }
+    float radius = 0.f;
+    for (const Material& material : mPresentMaterials)
+    {
+        float offDiagonal = 6.f * getConductanceScale() * (material.cisf.x + maxConductivity);
+        float diagonal = material.cisf.z * material.dppp.x / dt + offDiagonal;
+        if (diagonal > 0)
+        {
+            radius = std::max(radius, offDiagonal / diagonal);
+        }
+    }
+    glm::ivec3 extent = mSimulationArea->getSimulationBoxMax() - mSimulationArea->getSimulationBoxMin();
+    int maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    radius *= std::cos(glm::pi<float>() / (float)std::max(maxExtent, 2));
+    return std::min(radius, 0.999f);
+}
+
+void HeatSimulator::resetMaxUpdate(int check) const
+{
+    GLuint zero = 0;
+    GLuint maxUpdateSSBO = mMaxUpdateSSBOs[check % 2];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxUpdateSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, maxUpdateSSBO);
+}
+
+bool HeatSimulator::readMaxUpdate(int check)
+{
+    // Result of the check before is read while the GPU relaxes the batch of this one. Convergence
+    // is noticed one batch late, but the pipeline is not drained at every check
+    if (check == 0)
+    {
+        return false;
+    }
+    GLuint maxUpdateBits = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMaxUpdateSSBOs[(check - 1) % 2]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &maxUpdateBits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::memcpy(&mConvergenceInfo.maxUpdate, &maxUpdateBits, sizeof(float));
+    mConvergenceInfo.converged = mConvergenceInfo.maxUpdate <= mTolerance;
+    return mConvergenceInfo.converged;
+}
+
 void HeatSimulator::prepareSSBO(const std::vector<Materialtype> &materialList)
 {
 	// Create list of materials
@@ -151,3 +533,76 @@ int HeatSimulator::getRelaxationSteps()
 {
     return mRelaxationSteps;
 }
+
+void HeatSimulator::setSweepsPerCheck(int sweeps)
+{
+    if(sweeps > 0)
+        mSweepsPerCheck = sweeps;
+    else
+        mSweepsPerCheck = 2;
+}
+
+void HeatSimulator::setTolerance(float tolerance)
+{
+    if(tolerance >= 0.f)
+        mTolerance = tolerance;
+    else
+        mTolerance = 0.001f;
+}
+
+float HeatSimulator::getTolerance() const
+{
+    return mTolerance;
+}
+
+void HeatSimulator::setRelaxationMethod(RelaxationMethod method)
+{
+    mRelaxationMethod = method;
+}
+
+RelaxationMethod HeatSimulator::getRelaxationMethod() const
+{
+    return mRelaxationMethod;
+}
+
+void HeatSimulator::setAdvectionScheme(AdvectionScheme scheme)
+{
+    mAdvectionScheme = scheme;
+}
+
+ConvergenceInfo HeatSimulator::getConvergenceInfo() const
+{
+    return mConvergenceInfo;
+}
+
+void HeatSimulator::setUseActiveBricks(bool useActiveBricks)
+{
+    mupActiveBricks->setEnabled(useActiveBricks);
+}
+
+void HeatSimulator::setTileSize(int size)
+{
+    // Larger tiles reuse more of their loads, but workgroups are limited in size and shared memory
+    if (size != 0 && size != 4 && size != 8)
+    {
+        std::cout << "Error: tile size " << size << " of heat simulation is not supported, use 0, 4 or 8" << std::endl;
+        return;
+    }
+    mTileSize = size;
+
+    // Bricks have size of workgroup
+    glDeleteProgram(mHeatSimulationProgram);
+    prepareShader();
+    bool enabled = mupActiveBricks->isEnabled();
+    mupActiveBricks = std::unique_ptr<ActiveBricks>(new ActiveBricks(*mSimulationArea, getGroupSize(), BrickCriterion::HEAT, mMaterialsSSBO));
+    mupActiveBricks->setEnabled(enabled);
+}
+
+int HeatSimulator::getGroupSize() const
+{
+    // Untiled workgroups keep their edge of 4
+    if (mTileSize > 0)
+        return mTileSize;
+    else
+        return 4;
+}
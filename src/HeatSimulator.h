@@ -3,8 +3,13 @@
 
 #include "Material.h"
 #include "Area.h"
+#include "ActiveBricks.h"
+#include "Advector.h"
+#include "ConvergenceInfo.h"
+#include "RelaxationMethod.h"
 #include "externals/OpenGLLoader/gl_core_4_3.h"
 #include <vector>
+#include <memory>
 
 class HeatSimulator
 {
@@ -12,28 +17,82 @@ public:
     HeatSimulator(Area &area);
     ~HeatSimulator();
 
-    void nextStep(float dt);
+    void simulate(float dt);
+    float computeStableTimeStep(float maxSpeed) const; // Of the velocity measured by the fluid simulator
     float getMEdgeLenght(); const
     void setMEdgeLenght(float edgeLenght);
-    void setRelaxationSteps(int steps);
+    void setRelaxationSteps(int steps); // Maximum of sweeps per step
     int getRelaxationSteps();
+    void setSweepsPerCheck(int sweeps);
+    void setTolerance(float tolerance);
+    float getTolerance() const;
+    void setRelaxationMethod(RelaxationMethod method);
+    RelaxationMethod getRelaxationMethod() const;
+    void setAdvectionScheme(AdvectionScheme scheme);
+    ConvergenceInfo getConvergenceInfo() const;
+    void setUseActiveBricks(bool useActiveBricks);
+    void setTileSize(int size); // Edge of workgroups and their tiles in shared memory, 4 or 8. Untiled with 0
+    float getConductanceScale() const; // Fixed weight of conduction between voxels, independent of edge length
+    float estimateSpectralRadius(float dt) const;
 
 private:
 	void prepareShader();
+	int getGroupSize() const;
+    void prepareLineShader();
 	void prepareSSBO(const std::vector<Materialtype> &materialList);
+    void prepareVolumes();
+    void resetMaxUpdate(int check) const;
+    bool readMaxUpdate(int check);
+    void relaxJacobi();
+    void relaxRedBlack(float dt);
+    void relaxLines(float dt);
 
     GLuint mHeatSimulationProgram;
-    GLuint mStateVolume;
-    GLuint mLookupVolume;
+    GLuint mLineRelaxationProgram;
+    GLuint mTemperatureVolume;
+    GLuint mVelocityVolume;
+    GLuint mPropertyVolume;
+    GLenum mTemperatureFormat;
+    GLenum mVelocityFormat;
+    GLuint mPreviousTemperatureVolume;
     GLuint mMaterialsSSBO;
-    int mStateVolumeLocation;
+    GLuint mMaxUpdateSSBOs[2];
+    int mTemperatureVolumeLocation;
+    int mVelocityVolumeLocation;
+    int mPreviousTemperatureVolumeLocation;
     int mTimestepLocation;
-    int mRelaxationStepsLocation;
+    int mStageLocation;
+    int mSweepsLocation;
+    int mFirstSweepsLocation;
+    int mColorLocation;
+    int mCheckedSweepLocation;
+    int mCenteredConvectionLocation;
+    int mOmegaLocation;
     int mEdgeLengthLocation;
-    int mLookupVolumeLocation;
+    int mConductanceScaleLocation;
+    int mPropertyVolumeLocation;
+    int mLineTemperatureVolumeLocation;
+    int mLinePropertyVolumeLocation;
+    int mLinePreviousTemperatureVolumeLocation;
+    int mLineTimestepLocation;
+    int mLineConductanceScaleLocation;
+    int mLineDirectionLocation;
+    int mLineColorLocation;
+    int mLineCheckedSweepLocation;
+    int mLineBoxMinLocation;
+    int mLineBoxMaxLocation;
     float mEdgeLenght;
     int mRelaxationSteps;
+    int mSweepsPerCheck;
+    float mTolerance;
+    RelaxationMethod mRelaxationMethod;
+    AdvectionScheme mAdvectionScheme;
+    ConvergenceInfo mConvergenceInfo;
+    int mTileSize;
+    std::vector<Material> mPresentMaterials;
     Area* mSimulationArea;
+    std::unique_ptr<ActiveBricks> mupActiveBricks;
+    std::unique_ptr<Advector> mupAdvector;
     int mResolution;
     int mVoxelCount;
 };
@@ -0,0 +1,153 @@
+#include "LatticeBoltzmann.h"
+#include "LatticeBoltzmannShader.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+// Directions of the D3Q19 lattice
+const int LATTICE_DIRECTIONS = 19;
+
+// Lower bound of relaxation time, BGK collision gets unstable towards one half
+const float MIN_TAU = 0.51f;
+
+LatticeBoltzmann::LatticeBoltzmann(Area &area, GLuint fansSSBO, int fanCount)
+{
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mTemperatureVolume = area.getTemperatureVolumeHandle();
+    mPropertyVolume = area.getPropertyVolumeHandle();
+    mTemperatureFormat = area.getTemperatureFormat();
+    mVelocityFormat = area.getVelocityFormat();
+    mFansSSBO = fansSSBO;
+    mFanCount = fanCount;
+    mPreviousTimeStep = 0.f;
+    mBoxMin = area.getSimulationBoxMin();
+    mBoxMax = area.getSimulationBoxMax();
+
+    // Distributions only cover the simulation box, structure of arrays per direction
+    glm::ivec3 extent = mBoxMax - mBoxMin;
+    GLsizeiptr size = sizeof(GLfloat) * LATTICE_DIRECTIONS * extent.x * extent.y * extent.z;
+    glGenBuffers(1, &mSourceSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSourceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &mTargetSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTargetSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    prepareShader(area.getStorageFormatDefines());
+}
+
+LatticeBoltzmann::~LatticeBoltzmann()
+{
+    glDeleteProgram(mLatticeBoltzmannProgram);
+    glDeleteBuffers(1, &mSourceSSBO);
+    glDeleteBuffers(1, &mTargetSSBO);
+}
+
+void LatticeBoltzmann::prepareShader(const std::string& rDefines)
+{
+    std::string source = std::string("#version 430 core\n") + rDefines + latticeBoltzmannComputeShader;
+    const char* pSource = source.c_str();
+
+    mLatticeBoltzmannProgram = glCreateProgram();
+    GLint latticeBoltzmannCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(latticeBoltzmannCS, 1, &pSource, NULL);
+    glCompileShader(latticeBoltzmannCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(latticeBoltzmannCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(latticeBoltzmannCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mLatticeBoltzmannProgram, latticeBoltzmannCS);
+    glLinkProgram(mLatticeBoltzmannProgram);
+    glDetachShader(mLatticeBoltzmannProgram, latticeBoltzmannCS);
+    glDeleteShader(latticeBoltzmannCS);
+
+    mVelocityVolumeLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "velocityVolume");
+    mPropertyVolumeLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "propertyVolume");
+    mTemperatureVolumeLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "temperatureVolume");
+    mStageLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "stage");
+    mTimestepLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "timeStep");
+    mEdgeLengthLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "edgeLength");
+    mTauLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "tau");
+    mVelocityRescaleLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "velocityRescale");
+    mBoxMinLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "boxMin");
+    mBoxMaxLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "boxMax");
+    mFanCountLocation = glGetUniformLocation(mLatticeBoltzmannProgram, "fanCount");
+}
+
+void LatticeBoltzmann::step(float dt, float edgeLength, float viscosity)
+{
+    glUseProgram(mLatticeBoltzmannProgram);
+
+    glBindImageTexture(0, mVelocityVolume, 0, GL_TRUE, 0, GL_READ_WRITE, mVelocityFormat);
+    glBindImageTexture(1, mPropertyVolume, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+    glBindImageTexture(2, mTemperatureVolume, 0, GL_TRUE, 0, GL_READ_ONLY, mTemperatureFormat);
+    glUniform1i(mVelocityVolumeLocation, 0);
+    glUniform1i(mPropertyVolumeLocation, 1);
+    glUniform1i(mTemperatureVolumeLocation, 2);
+
+    if (mFanCount > 0)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mFansSSBO);
+    }
+
+    // Relaxation time from kinematic viscosity in lattice units
+    float tau = std::max(3.f * viscosity * dt / (edgeLength * edgeLength) + 0.5f, MIN_TAU);
+
+    glUniform1f(mTimestepLocation, dt);
+    glUniform1f(mEdgeLengthLocation, edgeLength);
+    glUniform1f(mTauLocation, tau);
+    glUniform3i(mBoxMinLocation, mBoxMin.x, mBoxMin.y, mBoxMin.z);
+    glUniform3i(mBoxMaxLocation, mBoxMax.x, mBoxMax.y, mBoxMax.z);
+    glUniform1i(mFanCountLocation, mFanCount);
+
+    // First step starts from velocity volume
+    if (mPreviousTimeStep <= 0.f)
+    {
+        glUniform1i(mStageLocation, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mSourceSSBO);
+        dispatch();
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        mPreviousTimeStep = dt;
+    }
+
+    // Stream and collide from one buffer into the other
+    glUniform1i(mStageLocation, 1);
+    glUniform1f(mVelocityRescaleLocation, dt / mPreviousTimeStep);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mSourceSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mTargetSSBO);
+    dispatch();
+    std::swap(mSourceSSBO, mTargetSSBO);
+    mPreviousTimeStep = dt;
+
+    glUseProgram(0);
+
+    // Next step reads distributions, heat simulation reads velocity
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void LatticeBoltzmann::reset()
+{
+    mPreviousTimeStep = 0.f;
+}
+
+void LatticeBoltzmann::dispatch() const
+{
+    glm::ivec3 extent = mBoxMax - mBoxMin;
+    glDispatchCompute((extent.x + 7) / 8, (extent.y + 7) / 8, (extent.z + 7) / 8);
+}
@@ -0,0 +1,59 @@
+#ifndef LATTICEBOLTZMANN_H_
+#define LATTICEBOLTZMANN_H_
+
+#include "Area.h"
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+#include <string>
+
+// STENCIL: forces, implicit diffusion sweeps and transport as passes over the velocity volume
+// LATTICE_BOLTZMANN: D3Q19 lattice with one local stream and collide pass per step
+enum class FluidBackend
+{
+    STENCIL, LATTICE_BOLTZMANN
+};
+
+// D3Q19 lattice Boltzmann fluid with BGK collision on the simulation box. Solid voxels bounce back,
+// fans impose their velocity and temperature adds upthrust. Resulting velocity is written into the
+// velocity volume of the area, where the heat simulator transports temperature as passive scalar
+class LatticeBoltzmann
+{
+public:
+    LatticeBoltzmann(Area &area, GLuint fansSSBO, int fanCount);
+    ~LatticeBoltzmann();
+
+    void step(float dt, float edgeLength, float viscosity);
+    void reset(); // Next step starts from equilibrium of velocity volume
+
+private:
+    void prepareShader(const std::string& rDefines);
+    void dispatch() const;
+
+    GLuint mLatticeBoltzmannProgram;
+    GLuint mVelocityVolume;
+    GLuint mTemperatureVolume;
+    GLuint mPropertyVolume;
+    GLenum mTemperatureFormat;
+    GLenum mVelocityFormat;
+    GLuint mFansSSBO;
+    GLuint mSourceSSBO;
+    GLuint mTargetSSBO;
+
+    int mVelocityVolumeLocation;
+    int mPropertyVolumeLocation;
+    int mTemperatureVolumeLocation;
+    int mStageLocation;
+    int mTimestepLocation;
+    int mEdgeLengthLocation;
+    int mTauLocation;
+    int mVelocityRescaleLocation;
+    int mBoxMinLocation;
+    int mBoxMaxLocation;
+    int mFanCountLocation;
+
+    int mFanCount;
+    float mPreviousTimeStep; // Zero until distributions are initialized
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mBoxMax;
+};
+
+#endif // LATTICEBOLTZMANN_H_
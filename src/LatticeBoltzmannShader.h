@@ -0,0 +1,178 @@
+#ifndef LATTICEBOLTZMANNSHADER_H_
+#define LATTICEBOLTZMANNSHADER_H_
+
+// Storage formats of temperature and velocity are prepended as defines.
+// One invocation per voxel of the simulation box pulls the distributions of its neighbors,
+// collides them and writes them into the other buffer, so no barrier is necessary
+const char* latticeBoltzmannComputeShader =
+
+// Structs
+"struct FanStruct{\n"
+"   vec3 position;\n"
+"   float speed;\n"
+"   vec3 direction;\n"
+"   float distance;\n"
+"};\n"
+
+// Workgroup settings
+"layout(local_size_x=8, local_size_y=8, local_size_z=8) in;\n"
+
+// SSBOs
+"layout(std430, binding = 1) buffer Fan\n"
+"{\n"
+"   FanStruct fans[];\n"
+"};\n"
+"layout(std430, binding = 4) buffer SourceDistributions\n"
+"{\n"
+"   float source[];\n" // Collided distributions of last step, one block of cells per direction
+"};\n"
+"layout(std430, binding = 5) buffer TargetDistributions\n"
+"{\n"
+"   float target[];\n"
+"};\n"
+
+// Uniforms
+"layout(VELOCITY_FORMAT, location = 0) uniform image3D velocityVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 2) uniform image3D temperatureVolume;\n"
+"uniform int stage;\n" // 0: equilibrium of velocity volume, 1: stream and collide
+"uniform float timeStep;\n"
+"uniform float edgeLength;\n"
+"uniform float tau;\n" // Relaxation time from viscosity
+"uniform float velocityRescale;\n" // Ratio of time step to the one of last step
+"uniform ivec3 boxMin;\n"
+"uniform ivec3 boxMax;\n"
+"uniform int fanCount;\n"
+
+// Consts
+"const float thermalExpansionCoefficient = 0.00025;\n" // Same upthrust as the stencil solver
+"const float maxLatticeSpeed = 0.3;\n" // Far above it the lattice gets unstable
+"const uint selfFluid = 1u << 14;\n"
+
+// D3Q19 lattice, opposite direction follows each direction
+"const ivec3 directions[19] = ivec3[19]("
+"   ivec3(0,0,0),"
+"   ivec3(1,0,0), ivec3(-1,0,0), ivec3(0,1,0), ivec3(0,-1,0), ivec3(0,0,1), ivec3(0,0,-1),"
+"   ivec3(1,1,0), ivec3(-1,-1,0), ivec3(1,-1,0), ivec3(-1,1,0),"
+"   ivec3(1,0,1), ivec3(-1,0,-1), ivec3(1,0,-1), ivec3(-1,0,1),"
+"   ivec3(0,1,1), ivec3(0,-1,-1), ivec3(0,1,-1), ivec3(0,-1,1));\n"
+"const float weights[19] = float[19]("
+"   1.0/3.0,"
+"   1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0, 1.0/18.0,"
+"   1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0,"
+"   1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0);\n"
+
+// Opposite direction
+"int opposite(int i)\n"
+"{\n"
+"   return i == 0 ? 0 : ((i & 1) != 0 ? i + 1 : i - 1);\n"
+"}\n"
+
+// Cell of voxel inside of the box
+"int getCell(ivec3 coords)\n"
+"{\n"
+"   ivec3 extent = boxMax - boxMin;\n"
+"   ivec3 local = coords - boxMin;\n"
+"   return local.x + extent.x * (local.y + extent.y * local.z);\n"
+"}\n"
+
+// Is fluid, outside of the box is treated like a wall
+"bool isFluid(ivec3 coords)\n"
+"{\n"
+"   if(any(lessThan(coords, boxMin)) || any(greaterThanEqual(coords, boxMax))) { return false; }\n"
+"   return (imageLoad(propertyVolume, coords).x & selfFluid) != 0u;\n"
+"}\n"
+
+// Equilibrium distribution
+"float equilibrium(int i, float density, vec3 velocity)\n"
+"{\n"
+"   float cu = dot(vec3(directions[i]), velocity);\n"
+"   return weights[i] * density * (1.0 + 3.0 * cu + 4.5 * cu * cu - 1.5 * dot(velocity, velocity));\n"
+"}\n"
+
+// Strongest wind of fans at voxel, same falloff as in the stencil solver
+"vec3 wind(ivec3 coords)\n"
+"{\n"
+"   vec3 strongest = vec3(0);\n"
+"   for(int i = 0; i < fanCount; i++)\n"
+"   {\n"
+"       vec3 relCoords = vec3(coords) / float(imageSize(velocityVolume).x);\n"
+"       float inFront = max(0,sign(dot(-fans[i].position+relCoords, fans[i].direction)));\n"
+"       float distanceFalloff = 1.0 - clamp(abs(length(relCoords - fans[i].position)) / 0.2, 0, 1);\n"
+"       vec3 wind = distanceFalloff * inFront * fans[i].direction * fans[i].speed;\n"
+"       strongest = length(wind) > length(strongest) ? wind : strongest;\n"
+"   }\n"
+"   return strongest;\n"
+"}\n"
+
+// Main function
+"void main()\n"
+"{\n"
+"   ivec3 coords = boxMin + ivec3(gl_GlobalInvocationID);\n"
+"   if(!isFluid(coords)) { return; }\n" // Also leaves invocations outside of the box
+"   ivec3 extent = boxMax - boxMin;\n"
+"   int cellCount = extent.x * extent.y * extent.z;\n"
+"   int cell = getCell(coords);\n"
+"   float toLattice = timeStep / edgeLength;\n"
+
+//  Start at rest density with velocity of volume
+"   if(stage == 0)\n"
+"   {\n"
+"       vec3 velocity = imageLoad(velocityVolume, coords).xyz * toLattice;\n"
+"       for(int i = 0; i < 19; i++)\n"
+"       {\n"
+"           target[i * cellCount + cell] = equilibrium(i, 1.0, velocity);\n"
+"       }\n"
+"       return;\n"
+"   }\n"
+
+//  Pull streaming, distributions towards solid voxels are bounced back
+"   float f[19];\n"
+"   float density = 0;\n"
+"   vec3 momentum = vec3(0);\n"
+"   for(int i = 0; i < 19; i++)\n"
+"   {\n"
+"       ivec3 from = coords - directions[i];\n"
+"       f[i] = isFluid(from) ? source[i * cellCount + getCell(from)] : source[opposite(i) * cellCount + cell];\n"
+"       density += f[i];\n"
+"       momentum += f[i] * vec3(directions[i]);\n"
+"   }\n"
+"   vec3 velocity = momentum / density;\n"
+
+//  Lattice velocity depends on time step, so it is rescaled while keeping the non-equilibrium part
+"   if(velocityRescale != 1.0)\n"
+"   {\n"
+"       vec3 rescaled = velocity * velocityRescale;\n"
+"       for(int i = 0; i < 19; i++)\n"
+"       {\n"
+"           f[i] += equilibrium(i, density, rescaled) - equilibrium(i, density, velocity);\n"
+"       }\n"
+"       velocity = rescaled;\n"
+"   }\n"
+
+//  Upthrust by temperature as shift of equilibrium velocity
+"   vec3 change = vec3(0, thermalExpansionCoefficient * timeStep * imageLoad(temperatureVolume, coords).x * toLattice, 0);\n"
+"   vec3 equilibriumVelocity = velocity + tau * change;\n"
+"   float relaxation = 1.0 / tau;\n"
+"   velocity += 0.5 * change;\n"
+
+//  Fans impose their velocity if it is stronger
+"   vec3 fanVelocity = wind(coords) * toLattice;\n"
+"   if(length(fanVelocity) > length(velocity))\n"
+"   {\n"
+"       velocity = fanVelocity;\n"
+"       equilibriumVelocity = fanVelocity;\n"
+"       relaxation = 1.0;\n"
+"   }\n"
+"   float speed = length(equilibriumVelocity);\n"
+"   if(speed > maxLatticeSpeed) { equilibriumVelocity *= maxLatticeSpeed / speed; }\n"
+
+//  BGK collision
+"   for(int i = 0; i < 19; i++)\n"
+"   {\n"
+"       target[i * cellCount + cell] = f[i] - relaxation * (f[i] - equilibrium(i, density, equilibriumVelocity));\n"
+"   }\n"
+"   imageStore(velocityVolume, coords, vec4(velocity / toLattice, 0));\n"
+"}\n";
+
+#endif // LATTICEBOLTZMANNSHADER_H_
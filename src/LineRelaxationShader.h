@@ -0,0 +1,111 @@
+#ifndef LINERELAXATIONSHADER_H_
+#define LINERELAXATIONSHADER_H_
+
+// Storage format of temperature and MAX_LINE_LENGTH, the longest extent of the box, are prepended as defines.
+// One invocation solves the implicit conduction along one line of the simulation box
+// with the Thomas algorithm, neighbors across the line are taken from the volume
+const char* lineRelaxationComputeShader =
+"struct Mat{\n"
+"   vec4 color;\n"
+"   vec4 cisf;\n"
+"   vec4 dppp;\n"
+"};\n"
+"layout(local_size_x=8, local_size_y=8, local_size_z=1) in;\n"
+"layout(TEMPERATURE_FORMAT, location = 0) uniform image3D temperatureVolume;\n"
+"layout(r32ui, location = 1) uniform uimage3D propertyVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 3) uniform image3D previousTemperatureVolume;\n" // Temperature at begin of step
+"layout(std430, binding=0) buffer Material\n"
+"{\n"
+"   Mat m[];\n"
+"};\n"
+"layout(std430, binding=3) buffer MaxUpdate\n"
+"{\n"
+"   uint maxUpdateBits;\n"
+"};\n"
+"uniform float timeStep;\n"
+"uniform float conductanceScale;\n"
+"uniform int direction;\n" // Axis of lines
+"uniform int color;\n" // Parity of lines, neighboring lines are solved in the other dispatch
+"uniform bool checkedSweep;\n" // Change is measured only in the last sweep of a batch
+"uniform ivec3 boxMin;\n"
+"uniform ivec3 boxMax;\n"
+"const uint materialMask = 0xFFu;\n"
+"float forward[MAX_LINE_LENGTH];\n" // Eliminated upper diagonal
+"float rhs[MAX_LINE_LENGTH];\n" // Eliminated right hand side
+"int getLookup(ivec3 coords){\n"
+"   return int(imageLoad(propertyVolume, coords).x & materialMask);\n"
+"}\n"
+"float getTemperature(ivec3 coords){\n"
+"   return imageLoad(temperatureVolume, coords).x;\n"
+"}\n"
+"void main()\n"
+"{\n"
+//  Start of line and axes across it
+"   int crossA = (direction + 1) % 3;\n"
+"   int crossB = (direction + 2) % 3;\n"
+"   ivec3 start = boxMin;\n"
+"   start[crossA] += int(gl_GlobalInvocationID.x);\n"
+"   start[crossB] += int(gl_GlobalInvocationID.y);\n"
+"   if(start[crossA] >= boxMax[crossA] || start[crossB] >= boxMax[crossB]) { return; }\n"
+"   if(((start[crossA] + start[crossB]) & 1) != color) { return; }\n"
+"   ivec3 along = ivec3(0);\n"
+"   along[direction] = 1;\n"
+"   ivec3 acrossA = ivec3(0);\n"
+"   acrossA[crossA] = 1;\n"
+"   ivec3 acrossB = ivec3(0);\n"
+"   acrossB[crossB] = 1;\n"
+"   int lineLength = min(boxMax[direction] - boxMin[direction], MAX_LINE_LENGTH);\n"
+//  Forward elimination, conductivities along the line are reused by the next voxel
+"   float previousConductivity = m[getLookup(start - along)].cisf.x;\n"
+"   float myConductivity = m[getLookup(start)].cisf.x;\n"
+"   for(int i = 0; i < lineLength; i++)\n"
+"   {\n"
+"       ivec3 coords = start + i * along;\n"
+"       int myLookup = getLookup(coords);\n"
+"       float nextConductivity = m[getLookup(coords + along)].cisf.x;\n"
+"       float sij = m[myLookup].cisf.z * m[myLookup].dppp.x / timeStep;\n"
+"       float lower = conductanceScale * (myConductivity + previousConductivity);\n"
+"       float upper = conductanceScale * (myConductivity + nextConductivity);\n"
+"       float aMinus = conductanceScale * (myConductivity + m[getLookup(coords - acrossA)].cisf.x);\n"
+"       float aPlus = conductanceScale * (myConductivity + m[getLookup(coords + acrossA)].cisf.x);\n"
+"       float bMinus = conductanceScale * (myConductivity + m[getLookup(coords - acrossB)].cisf.x);\n"
+"       float bPlus = conductanceScale * (myConductivity + m[getLookup(coords + acrossB)].cisf.x);\n"
+"       float diagonal = sij + lower + upper + aMinus + aPlus + bMinus + bPlus;\n"
+"       float b = sij * imageLoad(previousTemperatureVolume, coords).x"
+"           + aMinus * getTemperature(coords - acrossA)"
+"           + aPlus * getTemperature(coords + acrossA)"
+"           + bMinus * getTemperature(coords - acrossB)"
+"           + bPlus * getTemperature(coords + acrossB);\n"
+//      Ends of line couple to fixed voxels outside of it
+"       if(i == 0)\n"
+"       {\n"
+"           b += lower * getTemperature(coords - along);\n"
+"           lower = 0;\n"
+"       }\n"
+"       if(i == lineLength - 1)\n"
+"       {\n"
+"           b += upper * getTemperature(coords + along);\n"
+"           upper = 0;\n"
+"       }\n"
+"       float previousForward = i > 0 ? forward[i-1] : 0;\n"
+"       float previousRhs = i > 0 ? rhs[i-1] : 0;\n"
+"       float denominator = diagonal - lower * previousForward;\n"
+"       forward[i] = upper / denominator;\n"
+"       rhs[i] = (b + lower * previousRhs) / denominator;\n"
+"       previousConductivity = myConductivity;\n"
+"       myConductivity = nextConductivity;\n"
+"   }\n"
+//  Back substitution
+"   float change = 0;\n"
+"   float temperature = 0;\n"
+"   for(int i = lineLength - 1; i >= 0; i--)\n"
+"   {\n"
+"       ivec3 coords = start + i * along;\n"
+"       temperature = rhs[i] + forward[i] * temperature;\n"
+"       change = max(change, abs(temperature - getTemperature(coords)));\n"
+"       imageStore(temperatureVolume, coords, vec4(temperature));\n"
+"   }\n"
+"   if(checkedSweep) { atomicMax(maxUpdateBits, floatBitsToUint(change)); }\n"
+"}\n";
+
+#endif // LINERELAXATIONSHADER_H_
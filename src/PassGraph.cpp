@@ -0,0 +1,89 @@
+#include "PassGraph.h"
+
+// Barrier bit that makes incoherent writes visible to an access
+static GLbitfield barrierBit(const ResourceUse& rUse)
+{
+    switch (rUse.access)
+    {
+    case ResourceAccess::IMAGE:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case ResourceAccess::TEXTURE:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case ResourceAccess::STORAGE:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+    default:
+        return rUse.resource == FrameResource::SENSORS ? GL_BUFFER_UPDATE_BARRIER_BIT : GL_TEXTURE_UPDATE_BARRIER_BIT;
+    }
+}
+
+// All bits any later access may need
+const GLbitfield ACCESS_BITS =
+    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT
+    | GL_BUFFER_UPDATE_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+
+PassGraph::PassGraph()
+{
+    // Resources may be written before the first frame
+    mUnsyncedBits.assign((int)FrameResource::COUNT, ACCESS_BITS);
+}
+
+void PassGraph::addPass(const std::string& rName, const std::vector<ResourceUse>& rReads, const std::vector<ResourceUse>& rWrites, std::function<void()> execute)
+{
+    mPasses.push_back({ rName, rReads, rWrites, execute, 0 });
+}
+
+void PassGraph::execute()
+{
+    for (Pass& rPass : mPasses)
+    {
+        // Writes after incoherent writes need ordering as well
+        GLbitfield bits = 0;
+        for (const ResourceUse& rUse : rPass.reads)
+        {
+            bits |= requireVisible(rUse);
+        }
+        for (const ResourceUse& rUse : rPass.writes)
+        {
+            bits |= requireVisible(rUse);
+        }
+        if (bits != 0)
+        {
+            glMemoryBarrier(bits);
+
+            // Barrier covers all resources
+            for (GLbitfield& rUnsyncedBits : mUnsyncedBits)
+            {
+                rUnsyncedBits &= ~bits;
+            }
+        }
+        rPass.barrierBits = bits;
+
+        rPass.execute();
+
+        // Writes of shaders are incoherent for every following access
+        for (const ResourceUse& rUse : rPass.writes)
+        {
+            if (rUse.access != ResourceAccess::CLIENT)
+            {
+                mUnsyncedBits[(int)rUse.resource] = ACCESS_BITS;
+            }
+        }
+    }
+}
+
+GLbitfield PassGraph::requireVisible(const ResourceUse& rUse) const
+{
+    return barrierBit(rUse) & mUnsyncedBits[(int)rUse.resource];
+}
+
+GLbitfield PassGraph::getBarrierBits(const std::string& rName) const
+{
+    for (const Pass& rPass : mPasses)
+    {
+        if (rPass.name == rName)
+        {
+            return rPass.barrierBits;
+        }
+    }
+    return 0;
+}
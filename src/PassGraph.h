@@ -0,0 +1,63 @@
+#ifndef PASSGRAPH_H_
+#define PASSGRAPH_H_
+
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+// Resources shared by the passes of a frame
+enum class FrameResource
+{
+    STATE, // Temperature and velocity volumes
+    LOOKUP, // Property volume with material lookup
+    SENSORS, // Sensors SSBO
+    COLOR, // Color volume
+    COUNT
+};
+
+// How a pass accesses a resource. Shader writes by image or storage buffer are incoherent
+// and need a barrier with the bit of the access that follows them
+enum class ResourceAccess
+{
+    IMAGE, // imageLoad and imageStore
+    TEXTURE, // Sampling and texelFetch
+    STORAGE, // Shader storage buffer
+    CLIENT // Read back or upload by the application
+};
+
+struct ResourceUse
+{
+    FrameResource resource;
+    ResourceAccess access;
+};
+
+// Passes of a frame in their order of execution. Each pass declares the resources it reads and writes,
+// and before a pass only those barrier bits are issued, which its accesses need after earlier incoherent writes.
+// Passes keep their own barriers between their internal dispatches
+class PassGraph
+{
+public:
+    PassGraph();
+
+    void addPass(const std::string& rName, const std::vector<ResourceUse>& rReads, const std::vector<ResourceUse>& rWrites, std::function<void()> execute);
+    void execute();
+    GLbitfield getBarrierBits(const std::string& rName) const; // Issued before pass in last execution
+
+private:
+    struct Pass
+    {
+        std::string name;
+        std::vector<ResourceUse> reads;
+        std::vector<ResourceUse> writes;
+        std::function<void()> execute;
+        GLbitfield barrierBits;
+    };
+
+    GLbitfield requireVisible(const ResourceUse& rUse) const;
+
+    std::vector<Pass> mPasses;
+    std::vector<GLbitfield> mUnsyncedBits; // Per resource, accesses not yet synchronized with its last incoherent write
+};
+
+#endif // PASSGRAPH_H_
@@ -0,0 +1,119 @@
+#include "PrecisionReport.h"
+#include "Setup.h"
+#include "HeatSimulator.h"
+#include "FluidSimulator.h"
+#include "StepScheduler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+
+struct PrecisionRun
+{
+    std::vector<float> temperature;
+    std::vector<float> velocity;
+};
+
+// Settings of the simulators that change the results
+struct PrecisionSettings
+{
+    float edgeLength;
+    float timeStep;
+    RelaxationMethod fluidRelaxation;
+    RelaxationMethod heatRelaxation;
+    AdvectionScheme advection;
+    FluidBackend fluidBackend;
+};
+
+static PrecisionRun simulate(SetupType type, StoragePrecision precision, int steps, bool cropToOccupiedBox, int cropMargin, const PrecisionSettings &rSettings)
+{
+    std::vector<Fan> fans;
+    std::vector<Sensor> sensors;
+    std::unique_ptr<Area> upArea = createSetup(type, fans, sensors);
+    upArea->setStoragePrecision(precision);
+    if (cropToOccupiedBox)
+    {
+        upArea->cropToOccupiedBox(fans, sensors, cropMargin);
+    }
+
+    // Settings passed from main
+    FluidSimulator fluidSimulator(*(upArea.get()), fans);
+    fluidSimulator.setMEdgeLenght(rSettings.edgeLength);
+    fluidSimulator.setRelaxationMethod(rSettings.fluidRelaxation);
+    fluidSimulator.setAdvectionScheme(rSettings.advection);
+    fluidSimulator.setBackend(rSettings.fluidBackend);
+    HeatSimulator heatSimulator(*(upArea.get()));
+    heatSimulator.setMEdgeLenght(rSettings.edgeLength);
+    heatSimulator.setRelaxationMethod(rSettings.heatRelaxation);
+    heatSimulator.setAdvectionScheme(rSettings.advection);
+    StepScheduler scheduler(fluidSimulator, heatSimulator);
+
+    for (int i = 0; i < steps; i++)
+    {
+        scheduler.nextStep(rSettings.timeStep);
+    }
+
+    PrecisionRun run;
+    run.temperature = upArea->readTemperature();
+    run.velocity = upArea->readVelocity();
+    return run;
+}
+
+void printPrecisionReport(int steps, bool cropToOccupiedBox, int cropMargin, float edgeLength, float timeStep,
+    RelaxationMethod fluidRelaxation, RelaxationMethod heatRelaxation, AdvectionScheme advection, FluidBackend fluidBackend)
+{
+    const PrecisionSettings settings = { edgeLength, timeStep, fluidRelaxation, heatRelaxation, advection, fluidBackend };
+
+    const SetupType setups[] = { SetupType::TEST, SetupType::SIMPLE_COOLER, SetupType::COOLER_COMPARSION, SetupType::FANS, SetupType::BEER, SetupType::CHANDELIER };
+    const char* names[] = { "TEST", "SIMPLE_COOLER", "COOLER_COMPARSION", "FANS", "BEER", "CHANDELIER" };
+
+    std::cout << "Half against full storage precision after " << steps << " steps:" << std::endl;
+
+    for (int s = 0; s < 6; s++)
+    {
+        PrecisionRun full = simulate(setups[s], StoragePrecision::FULL, steps, cropToOccupiedBox, cropMargin, settings);
+        PrecisionRun half = simulate(setups[s], StoragePrecision::HALF, steps, cropToOccupiedBox, cropMargin, settings);
+
+        // Temperature error absolute and relative to range of full precision run
+        double maxTemperatureError = 0;
+        double squaredTemperatureError = 0;
+        float minTemperature = full.temperature[0];
+        float maxTemperature = full.temperature[0];
+        for (size_t i = 0; i < full.temperature.size(); i++)
+        {
+            double error = std::abs((double)half.temperature[i] - full.temperature[i]);
+            maxTemperatureError = std::max(maxTemperatureError, error);
+            squaredTemperatureError += error * error;
+            minTemperature = std::min(minTemperature, full.temperature[i]);
+            maxTemperature = std::max(maxTemperature, full.temperature[i]);
+        }
+        double rmsTemperatureError = std::sqrt(squaredTemperatureError / full.temperature.size());
+        double temperatureRange = std::max((double)maxTemperature - minTemperature, 1e-6);
+
+        // Velocity error relative to fastest voxel of full precision run
+        double maxVelocityError = 0;
+        double maxSpeed = 0;
+        for (size_t i = 0; i < full.velocity.size(); i += 4)
+        {
+            double dx = (double)half.velocity[i] - full.velocity[i];
+            double dy = (double)half.velocity[i + 1] - full.velocity[i + 1];
+            double dz = (double)half.velocity[i + 2] - full.velocity[i + 2];
+            maxVelocityError = std::max(maxVelocityError, std::sqrt(dx * dx + dy * dy + dz * dz));
+            double vx = full.velocity[i];
+            double vy = full.velocity[i + 1];
+            double vz = full.velocity[i + 2];
+            maxSpeed = std::max(maxSpeed, std::sqrt(vx * vx + vy * vy + vz * vz));
+        }
+
+        std::cout << std::setw(18) << std::left << names[s] << std::right << std::scientific << std::setprecision(2)
+            << " temperature max " << maxTemperatureError << " (" << std::fixed << 100.0 * maxTemperatureError / temperatureRange << "% of range)"
+            << std::scientific << " rms " << rmsTemperatureError
+            << " | velocity max " << maxVelocityError;
+        if (maxSpeed > 0)
+        {
+            std::cout << " (" << std::fixed << 100.0 * maxVelocityError / maxSpeed << "% of max speed)";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
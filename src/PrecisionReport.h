@@ -0,0 +1,13 @@
+#ifndef PRECISION_REPORT_H_
+#define PRECISION_REPORT_H_
+
+#include "RelaxationMethod.h"
+#include "Advector.h"
+#include "LatticeBoltzmann.h"
+
+// Simulates every setup with full and half storage precision and prints how far the half precision run deviates
+// Simulators run with the settings of main
+void printPrecisionReport(int steps, bool cropToOccupiedBox, int cropMargin, float edgeLength, float timeStep,
+    RelaxationMethod fluidRelaxation, RelaxationMethod heatRelaxation, AdvectionScheme advection, FluidBackend fluidBackend);
+
+#endif // PRECISION_REPORT_H_
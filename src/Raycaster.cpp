@@ -1,19 +1,23 @@
 #include "Raycaster.h"
 #include "RaycastingShader.h"
 
+#include "externals/GLM/glm/gtc/matrix_transform.hpp"
 #include "externals/GLM/glm/gtc/type_ptr.hpp"
 
-Raycaster::Raycaster(GLuint colorVolumeHandle, GLuint stateVolumeHandle)
+Raycaster::Raycaster(GLuint colorVolumeHandle, GLuint temperatureVolumeHandle, GLuint velocityVolumeHandle)
 {
     // Save member
     mColorVolumeHandle = colorVolumeHandle;
-    mStateVolumeHandle = stateVolumeHandle;
+    mTemperatureVolumeHandle = temperatureVolumeHandle;
+    mVelocityVolumeHandle = velocityVolumeHandle;
 
     // Initialize members
     mShaderInitialized = false;
     mRenderEnvironment = true;
     mRenderTemperature = true;
     mRenderVelocity = false;
+    mBoxMin = glm::vec3(0);
+    mBoxMax = glm::vec3(1);
 
     // First compilation of shader
     recompileShader();
@@ -56,25 +60,34 @@ void Raycaster::draw(const glm::mat4& uniformView, const glm::mat4& uniformProje
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_3D, mColorVolumeHandle);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_3D, mStateVolumeHandle);
+    glBindTexture(GL_TEXTURE_3D, mTemperatureVolumeHandle);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_3D, mVelocityVolumeHandle);
 
     if(mColorTextureLocation >= 0)
     {
         glUniform1i(mColorTextureLocation, 0);
     }
-    if(mStateTextureLocation >= 0)
+    if(mTemperatureTextureLocation >= 0)
     {
-        glUniform1i(mStateTextureLocation, 1);
+        glUniform1i(mTemperatureTextureLocation, 1);
+    }
+    if(mVelocityTextureLocation >= 0)
+    {
+        glUniform1i(mVelocityTextureLocation, 2);
     }
 
     // Bind vertex array object
     glBindVertexArray(mVertexArrayObject);
 
     // Set updated uniforms in shader
-    glUniformMatrix4fv(mUniformModelHandle, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), mBoxMin), mBoxMax - mBoxMin);
+    glUniformMatrix4fv(mUniformModelHandle, 1, GL_FALSE, glm::value_ptr(model));
     glUniformMatrix4fv(mUniformViewHandle, 1, GL_FALSE, glm::value_ptr(uniformView));
     glUniformMatrix4fv(mUniformProjectionHandle, 1, GL_FALSE, glm::value_ptr(uniformProjection));
     glUniform3fv(mUniformCameraPositionHandle, 1, glm::value_ptr(cameraPosition));
+    glUniform3fv(mUniformBoxMinHandle, 1, glm::value_ptr(mBoxMin));
+    glUniform3fv(mUniformBoxMaxHandle, 1, glm::value_ptr(mBoxMax));
 
     // Drawing
     glDrawArrays(GL_QUADS, 0, mVertexCount);
@@ -98,6 +111,12 @@ void Raycaster::toggleRenderVelocity()
     recompileShader();
 }
 
+void Raycaster::setVolumeBox(const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    mBoxMin = boxMin;
+    mBoxMax = boxMax;
+}
+
 void Raycaster::recompileShader()
 {
     // Vertex shader
@@ -190,6 +209,9 @@ void Raycaster::recompileShader()
     mUniformViewHandle = glGetUniformLocation(mShaderProgram, "uniformView");
     mUniformProjectionHandle = glGetUniformLocation(mShaderProgram, "uniformProjection");
     mUniformCameraPositionHandle = glGetUniformLocation(mShaderProgram, "uniformCameraPosition");
+    mUniformBoxMinHandle = glGetUniformLocation(mShaderProgram, "uniformBoxMin");
+    mUniformBoxMaxHandle = glGetUniformLocation(mShaderProgram, "uniformBoxMax");
     mColorTextureLocation = glGetUniformLocation(mShaderProgram, "uniformColorVolume");
-    mStateTextureLocation = glGetUniformLocation(mShaderProgram, "uniformStateVolume");
+    mTemperatureTextureLocation = glGetUniformLocation(mShaderProgram, "uniformTemperatureVolume");
+    mVelocityTextureLocation = glGetUniformLocation(mShaderProgram, "uniformVelocityVolume");
 }
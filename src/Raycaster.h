@@ -13,7 +13,7 @@ class Raycaster
 {
 public:
 
-    Raycaster(GLuint colorVolumeHandle, GLuint stateVolumeHandle);
+    Raycaster(GLuint colorVolumeHandle, GLuint temperatureVolumeHandle, GLuint velocityVolumeHandle);
     virtual ~Raycaster();
 
     void draw(const glm::mat4& uniformView, const glm::mat4& uniformProjection, const glm::vec3& cameraPosition) const;
@@ -21,6 +21,7 @@ public:
     void toggleRenderEnvironment();
     void toggleRenderTemperature();
     void toggleRenderVelocity();
+    void setVolumeBox(const glm::vec3& boxMin, const glm::vec3& boxMax);
 
 private:
 
@@ -30,11 +31,15 @@ private:
     GLuint mUniformViewHandle;
     GLuint mUniformProjectionHandle;
     GLuint mUniformCameraPositionHandle;
+    GLuint mUniformBoxMinHandle;
+    GLuint mUniformBoxMaxHandle;
     GLint mColorTextureLocation;
-    GLint mStateTextureLocation;
+    GLint mTemperatureTextureLocation;
+    GLint mVelocityTextureLocation;
     GLuint mVertexCount;
     GLuint mColorVolumeHandle;
-    GLuint mStateVolumeHandle;
+    GLuint mTemperatureVolumeHandle;
+    GLuint mVelocityVolumeHandle;
     GLuint mShaderProgram;
     GLuint mVertexArrayObject;
 
@@ -42,6 +47,8 @@ private:
     bool mRenderEnvironment;
     bool mRenderTemperature;
     bool mRenderVelocity;
+    glm::vec3 mBoxMin;
+    glm::vec3 mBoxMax;
 };
 
 #endif // RAYCASTER_H_
@@ -12,9 +12,10 @@ const char* pRaycastingVertexShader =
     "uniform vec3 uniformCameraPosition;\n"
     "void main()\n"
     "{\n"
-    "	position = positionAttribute.xyz;\n" // Startposition for rays
-    "	direction = position - uniformCameraPosition;\n" // Direction in model space
-    "	gl_Position = uniformProjection * uniformView * uniformModel * positionAttribute;\n" // Output for rasterization
+    "	vec4 worldPosition = uniformModel * positionAttribute;\n" // Cube is scaled to simulation box
+    "	position = worldPosition.xyz;\n" // Startposition for rays
+    "	direction = position - uniformCameraPosition;\n" // Direction in volume space
+    "	gl_Position = uniformProjection * uniformView * worldPosition;\n" // Output for rasterization
     "}";
 
 const char* pRaycastingFragmentShader =
@@ -22,7 +23,10 @@ const char* pRaycastingFragmentShader =
     "in vec3 direction;\n"
     "out vec4 fragmentColor;\n"
     "uniform sampler3D uniformColorVolume;\n"
-    "uniform sampler3D uniformStateVolume;\n"
+    "uniform sampler3D uniformTemperatureVolume;\n"
+    "uniform sampler3D uniformVelocityVolume;\n"
+    "uniform vec3 uniformBoxMin;\n"
+    "uniform vec3 uniformBoxMax;\n"
     "const float stepSize = 0.004;\n"
     "const float outerIterations = 100;\n"
     "const vec3 sun = vec3(0.5,-1,0.75);\n"
@@ -67,7 +71,9 @@ const char* pRaycastingFragmentShader =
     "void nextStep()\n"
     "{\n"
     "	src.rgba = vec4(0,0,0,0);\n"
-    "	vec4 state = texture(uniformStateVolume, pos).rgba;\n"
+    "	#if defined(RENDER_TEMPERATURE) || defined(RENDER_VELOCITY)\n"
+    "		float temperatureSample = texture(uniformTemperatureVolume, pos).r;\n"
+    "	#endif\n"
     //	Render environment
     "	#ifdef RENDER_ENVIRONMENT\n"
     "		src.rgba = texture(uniformColorVolume, pos).rgba;\n" // Get color value from volume
@@ -77,14 +83,14 @@ const char* pRaycastingFragmentShader =
     "	#endif\n"
     //	Render temperature
     "	#ifdef RENDER_TEMPERATURE\n"
-    "       float temperature = state.r;\n" // Get temperature value from volume
+    "       float temperature = temperatureSample;\n" // Get temperature value from volume
     "       maxCelsius = max(maxCelsius, temperature);\n"
     "	#endif\n"
     //	Render velocity
     "	#ifdef RENDER_VELOCITY\n"
     "		const float maxVelocity = 0.05f;\n"
-    "		vec3 velocity = clamp(state.gba, vec3(-maxVelocity, -maxVelocity, -maxVelocity), vec3(maxVelocity, maxVelocity, maxVelocity));\n"
-    "		float velocityAlpha = (state.r / 100) * (abs(velocity.r) + abs(velocity.g) + abs(velocity.b));\n"
+    "		vec3 velocity = clamp(texture(uniformVelocityVolume, pos).rgb, vec3(-maxVelocity, -maxVelocity, -maxVelocity), vec3(maxVelocity, maxVelocity, maxVelocity));\n"
+    "		float velocityAlpha = (temperatureSample / 100) * (abs(velocity.r) + abs(velocity.g) + abs(velocity.b));\n"
     "		velocity += maxVelocity;\n"
     "		velocity *= 1.0 / (2*maxVelocity);\n"
     "       src.rgba += vec4(velocity, velocityAlpha);\n"
@@ -108,8 +114,8 @@ const char* pRaycastingFragmentShader =
     "       nextStep();\n"
     "       nextStep();\n"
     "       nextStep();\n"
-    "		if (pos.x > 1 || pos.y > 1 || pos.z > 1 ||\n"
-    "			pos.x < 0 || pos.y < 0 || pos.z < 0 || dst.a >= 0.99)\n" // Check whether still in volume
+    "		if (any(greaterThan(pos, uniformBoxMax)) ||\n"
+    "			any(lessThan(pos, uniformBoxMin)) || dst.a >= 0.99)\n" // Check whether still in simulation box
     "		{\n"
     "			break;\n"
     "		}\n"
@@ -0,0 +1,33 @@
+#ifndef RELAXATIONMETHOD_H_
+#define RELAXATIONMETHOD_H_
+
+#include <cmath>
+
+// JACOBI: all voxels per sweep, several sweeps per dispatch
+// SOR: red-black ordering with optimal over-relaxation, one dispatch per half sweep
+// CHEBYSHEV: red-black ordering with over-relaxation of Chebyshev acceleration, one dispatch per half sweep
+// LINE: implicit solve along red-black lines alternating through all three axes, heat only
+// (fluid diffusion has no contrast of coefficients and falls back to red-black sweeps)
+enum class RelaxationMethod
+{
+    JACOBI, SOR, CHEBYSHEV, LINE
+};
+
+// Optimal over-relaxation of SOR for spectral radius of Jacobi iteration
+inline float optimalOmega(float spectralRadius)
+{
+    return 2.f / (1.f + std::sqrt(1.f - spectralRadius * spectralRadius));
+}
+
+// Over-relaxation of next half sweep in Chebyshev acceleration with red-black ordering (Numerical Recipes 19.5).
+// Starts with one and converges towards optimal over-relaxation
+inline float nextChebyshevOmega(float omega, float spectralRadius, bool firstHalfSweep)
+{
+    float squaredRadius = spectralRadius * spectralRadius;
+    if (firstHalfSweep)
+        return 1.f / (1.f - 0.5f * squaredRadius);
+    else
+        return 1.f / (1.f - 0.25f * squaredRadius * omega);
+}
+
+#endif // RELAXATIONMETHOD_H_
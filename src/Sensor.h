@@ -20,8 +20,8 @@ public:
 			this->position = position;
 		}
 	};
-	std::string getName() const {return mName;}
-	SensorStruct getSensor(){return mStruct;}
+	const std::string& getName() const {return mName;}
+	SensorStruct getSensor() const {return mStruct;}
 private:
 	std::string mName;
 	SensorStruct mStruct;
@@ -2,14 +2,13 @@
 
 #include "externals/GLM/glm/gtc/type_ptr.hpp"
 #include <iostream>
-#include <sstream>
-#include <iomanip>
+#include <cstdio>
 
 const int MAX_SENSOR_COUNT = 16;
 const float RENDER_HALF_SCALE = 0.05f;
 
+// Storage format of temperature is prepended as define
 const char* sensorReaderShaderSource =
-"#version 430 core\n"
 
 // Structs
 "struct SensorStruct{\n"
@@ -19,7 +18,7 @@ const char* sensorReaderShaderSource =
 
 // Layouts
 "layout(local_size_x=4, local_size_y=1, local_size_z=1) in;\n"
-"layout(rgba32f, location = 0) uniform image3D stateVolume;\n"
+"layout(TEMPERATURE_FORMAT, location = 0) uniform image3D temperatureVolume;\n"
 "layout(std430, binding=0) buffer Sensor\n"
 "{\n"
 "       SensorStruct sensors[];\n"
@@ -31,11 +30,11 @@ const char* sensorReaderShaderSource =
 // Main
 "void main()\n"
 "{\n"
-"	unsigned int index = gl_GlobalInvocationID.x;\n"
+"	uint index = gl_GlobalInvocationID.x;\n"
 "	if(index < sensorCount)\n"
 "	{\n"
 "		ivec3 coords = ivec3(sensors[index].position * 128);\n" // TODO: Voxel count guessed
-"		sensors[index].temperature = imageLoad(stateVolume, coords).x;\n"
+"		sensors[index].temperature = imageLoad(temperatureVolume, coords).x;\n"
 "	}\n"
 "}\n";
 
@@ -58,10 +57,12 @@ const char* sensorFragmentShaderSource =
 "	fragmentColor = vec4(1,1,1,1);\n" // Output
 "}";
 
-SensorReader::SensorReader(GLuint stateVolumeHandle, std::vector<Sensor> sensors)
+SensorReader::SensorReader(Area& area, std::vector<Sensor> sensors)
 {
 	mSensors = sensors;
-	mStateVolume = stateVolumeHandle;
+	mTemperatures.resize(mSensors.size(), 0.f);
+	mTemperatureVolume = area.getTemperatureVolumeHandle();
+	mTemperatureFormat = area.getTemperatureFormat();
 
 	if (mSensors.size() > 0)
 	{
@@ -79,9 +80,11 @@ SensorReader::SensorReader(GLuint stateVolumeHandle, std::vector<Sensor> sensors
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
 		// Create compute shader
+		std::string source = std::string("#version 430 core\n") + area.getStorageFormatDefines() + sensorReaderShaderSource;
+		const char* pSource = source.c_str();
 		mSensorReaderProgram = glCreateProgram();
 		GLint sensorReaderCS = glCreateShader(GL_COMPUTE_SHADER);
-		glShaderSource(sensorReaderCS, 1, &sensorReaderShaderSource, NULL);
+		glShaderSource(sensorReaderCS, 1, &pSource, NULL);
 		glCompileShader(sensorReaderCS);
 
 		// Get length of compiling log
@@ -107,7 +110,7 @@ SensorReader::SensorReader(GLuint stateVolumeHandle, std::vector<Sensor> sensors
 		glDeleteShader(sensorReaderCS);
 
 		// Get locations in shader
-		mStateVolumeLocation = glGetUniformLocation(mSensorReaderProgram, "stateVolume");
+		mTemperatureVolumeLocation = glGetUniformLocation(mSensorReaderProgram, "temperatureVolume");
 		mSensorCountLocation = glGetUniformLocation(mSensorReaderProgram, "sensorCount");
 
 		// Vertex shader
@@ -235,9 +238,8 @@ SensorReader::~SensorReader()
 	glDeleteBuffers(1, &mVertexBuffer);
 }
 
-std::vector<std::string> SensorReader::updateAndDraw(const glm::mat4& uniformView, const glm::mat4& uniformProjection) const
+void SensorReader::draw(const glm::mat4& uniformView, const glm::mat4& uniformProjection) const
 {
-	std::vector<std::string> values;
 	if (mSensors.size() > 0)
 	{
 		// Bind rendering shader
@@ -253,7 +255,13 @@ std::vector<std::string> SensorReader::updateAndDraw(const glm::mat4& uniformVie
 
 		// Drawing
 		glDrawArrays(GL_LINES, 0, mVertexCount);
+	}
+}
 
+void SensorReader::update() const
+{
+	if (mSensors.size() > 0)
+	{
 		// Use reader program
 		glUseProgram(mSensorReaderProgram);
 
@@ -262,37 +270,55 @@ std::vector<std::string> SensorReader::updateAndDraw(const glm::mat4& uniformVie
 
 		// Bind image
 		glBindImageTexture(0,
-			mStateVolume,
+			mTemperatureVolume,
 			0,
 			GL_TRUE,
 			0,
 			GL_READ_ONLY,
-			GL_RGBA32F);
+			mTemperatureFormat);
 
 		// Fill uniforms
-		glUniform1i(mStateVolumeLocation, 0);
+		glUniform1i(mTemperatureVolumeLocation, 0);
 		glUniform1i(mSensorCountLocation, (GLint)mSensors.size());
 
 		// Dispatch
 		glDispatchCompute(MAX_SENSOR_COUNT/4, 1, 1);
+	}
+}
 
-		// Barrier
-		glMemoryBarrier(GL_ALL_BARRIER_BITS);
-
+const std::vector<float>& SensorReader::read() const
+{
+	if (mSensors.size() > 0)
+	{
 		// Collects informations
-	
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSensorsSSBO);
 		Sensor::SensorStruct* ptr = (Sensor::SensorStruct*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-		for (int i = 0; i < mSensors.size(); i++)
+		for (size_t i = 0; i < mSensors.size(); i++)
 		{
-			std::stringstream temperature; 
-			temperature << std::setfill('0') << std::fixed << std::setw(6) << std::setprecision(3) << ptr[i].temperature;
-			values.push_back(mSensors.at(i).getName() + " = " + temperature.str());
+			mTemperatures[i] = ptr[i].temperature;
 		}
 		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 	}
 
-	// Return strings for output
-	return values;
+	// Values for output
+	return mTemperatures;
+}
+
+int SensorReader::format(char* pBuffer, int size) const
+{
+	// Written into buffer of caller, so printing does not allocate
+	int length = 0;
+	if (size > 0)
+	{
+		pBuffer[0] = '\0';
+	}
+	for (size_t i = 0; i < mSensors.size(); i++)
+	{
+		// Only length is counted when buffer is full
+		char* pEnd = length < size ? pBuffer + length : NULL;
+		int rest = length < size ? size - length : 0;
+		length += std::snprintf(pEnd, rest, "%s%s = %06.3f", i > 0 ? ", " : "", mSensors[i].getName().c_str(), mTemperatures[i]);
+	}
+	return length;
 }
\ No newline at end of file
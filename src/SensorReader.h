@@ -2,6 +2,7 @@
 #define SENSOR_READER_H_
 
 #include "Sensor.h"
+#include "Area.h"
 #include "externals/OpenGLLoader/gl_core_4_3.h"
 #include <vector>
 #include <string>
@@ -9,16 +10,21 @@
 class SensorReader
 {
 public:
-	SensorReader(GLuint stateVolumeHandle, std::vector<Sensor> sensors);
+	SensorReader(Area& area, std::vector<Sensor> sensors);
 	~SensorReader();
-	std::vector<std::string> updateAndDraw(const glm::mat4& uniformView, const glm::mat4& uniformProjection) const;
+	void draw(const glm::mat4& uniformView, const glm::mat4& uniformProjection) const;
+	void update() const; // Samples temperature into sensors SSBO
+	const std::vector<float>& read() const; // Sensors SSBO has to be visible for buffer reads, values are reused by next read
+	int format(char* pBuffer, int size) const; // Names and values of last read, returns length like snprintf
 
 private:
 	std::vector<Sensor> mSensors;
+	mutable std::vector<float> mTemperatures;
 	GLuint mSensorReaderProgram;
-	GLuint mStateVolume;
+	GLuint mTemperatureVolume;
+	GLenum mTemperatureFormat;
 	GLuint mSensorsSSBO;
-	int mStateVolumeLocation;
+	int mTemperatureVolumeLocation;
 	int mSensorCountLocation;
 	GLuint mUniformModelHandle;
 	GLuint mUniformViewHandle;
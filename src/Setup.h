@@ -6,25 +6,44 @@
 #include "Sensor.h"
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <cmath>
+
+// Resolution the blocks of the setups are given for
+const int SETUP_RESOLUTION = 128;
 
 enum class SetupType
 {
     TEST, SIMPLE_COOLER, COOLER_COMPARSION, FANS, BEER, CHANDELIER
 };
 
-static std::unique_ptr<Area> createSetup(SetupType type, std::vector<Fan>& rFans, std::vector<Sensor>& rSensors)
+// Scales block to resolution of area, blocks keep at least one voxel per axis
+static void setScaledBlock(Area& rArea, Materialtype material, int x, int y, int z, int width, int height, int depth)
+{
+    float scale = (float)rArea.getResolution() / SETUP_RESOLUTION;
+    int minX = (int)(x * scale);
+    int minY = (int)(y * scale);
+    int minZ = (int)(z * scale);
+    int maxX = std::max(minX + 1, (int)std::ceil((x + width) * scale));
+    int maxY = std::max(minY + 1, (int)std::ceil((y + height) * scale));
+    int maxZ = std::max(minZ + 1, (int)std::ceil((z + depth) * scale));
+    rArea.setBlock(material, minX, minY, minZ, maxX - minX, maxY - minY, maxZ - minZ);
+}
+
+// Fans and sensors are placed relative to the volume, so every resolution works
+static std::unique_ptr<Area> createSetup(SetupType type, std::vector<Fan>& rFans, std::vector<Sensor>& rSensors, int resolution = SETUP_RESOLUTION)
 {
-    std::unique_ptr<Area> upArea = std::unique_ptr<Area>(new Area(128, Materialtype::AIR));
+    std::unique_ptr<Area> upArea = std::unique_ptr<Area>(new Area(resolution, Materialtype::AIR));
 
     switch (type)
     {
     case SetupType::TEST:
-        upArea->setBlock(Materialtype::HEATER, 22, 20, 20, 5, 1, 5);
-        upArea->setBlock(Materialtype::HEATER, 52, 21, 20, 5, 1, 5);
-        upArea->setBlock(Materialtype::COPPER, 20, 22, 20, 70, 3, 70);
-        upArea->setBlock(Materialtype::ISOLATOR, 0, 0, 0, 128, 2, 128); // Bottom
-        upArea->setBlock(Materialtype::ISOLATOR, 0, 0, 0, 128, 128, 2); // Side
-        upArea->setBlock(Materialtype::ISOLATOR, 0, 126, 0, 128, 2, 128); // Top
+        setScaledBlock(*upArea, Materialtype::HEATER, 22, 20, 20, 5, 1, 5);
+        setScaledBlock(*upArea, Materialtype::HEATER, 52, 21, 20, 5, 1, 5);
+        setScaledBlock(*upArea, Materialtype::COPPER, 20, 22, 20, 70, 3, 70);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 0, 0, 0, 128, 2, 128); // Bottom
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 0, 0, 0, 128, 128, 2); // Side
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 0, 126, 0, 128, 2, 128); // Top
 
         rFans.push_back(Fan(glm::vec3(0.3f, 0.2f, 0.1f), 0.1f, glm::vec3(1, 0.9f, 1), 0.2f));
         rFans.push_back(Fan(glm::vec3(0.5f, 0.4f, 0.3f), 0.2f, glm::vec3(-1, 0.9f, -1), 0.4f));
@@ -33,71 +52,71 @@ static std::unique_ptr<Area> createSetup(SetupType type, std::vector<Fan>& rFans
         rSensors.push_back(Sensor(glm::vec3(0.3f, 0.5f, 0.13f), "SensorB"));
         break;
     case SetupType::SIMPLE_COOLER:
-        upArea->setBlock(Materialtype::ISOLATOR, 38, 20, 18, 52, 48, 2);
-        upArea->setBlock(Materialtype::COPPER, 38, 20, 20, 52, 48, 6);
-        upArea->setBlock(Materialtype::HEATER, 50, 30, 20, 28, 28, 4);
-        upArea->setBlock(Materialtype::COPPER, 38, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 46, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 54, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 62, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 70, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 78, 20, 26, 4, 48, 48);
-        upArea->setBlock(Materialtype::COPPER, 86, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 38, 20, 18, 52, 48, 2);
+        setScaledBlock(*upArea, Materialtype::COPPER, 38, 20, 20, 52, 48, 6);
+        setScaledBlock(*upArea, Materialtype::HEATER, 50, 30, 20, 28, 28, 4);
+        setScaledBlock(*upArea, Materialtype::COPPER, 38, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 46, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 54, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 62, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 70, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 78, 20, 26, 4, 48, 48);
+        setScaledBlock(*upArea, Materialtype::COPPER, 86, 20, 26, 4, 48, 48);
         break;
     case SetupType::COOLER_COMPARSION:
-        upArea->setBlock(Materialtype::ISOLATOR, 20, 20, 18, 24, 24, 20);
-        upArea->setBlock(Materialtype::HEATER, 22, 22, 20, 20, 20, 4);
-        upArea->setBlock(Materialtype::COPPER, 26, 26, 24, 12, 12, 14);
-        upArea->setBlock(Materialtype::COPPER, 20, 20, 38, 24, 24, 2);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 20, 20, 18, 24, 24, 20);
+        setScaledBlock(*upArea, Materialtype::HEATER, 22, 22, 20, 20, 20, 4);
+        setScaledBlock(*upArea, Materialtype::COPPER, 26, 26, 24, 12, 12, 14);
+        setScaledBlock(*upArea, Materialtype::COPPER, 20, 20, 38, 24, 24, 2);
 
-        upArea->setBlock(Materialtype::ISOLATOR, 84, 20, 18, 24, 24, 20);
-        upArea->setBlock(Materialtype::HEATER, 86, 22, 20, 20, 20, 4);
-        upArea->setBlock(Materialtype::COPPER, 90, 26, 24, 12, 12, 14);
-        upArea->setBlock(Materialtype::COPPER, 84, 20, 38, 24, 24, 2);
-        upArea->setBlock(Materialtype::COPPER, 84, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 86, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 88, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 90, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 92, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 94, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 96, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 98, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 100, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 102, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 104, 20, 38, 1, 24, 20);
-        upArea->setBlock(Materialtype::COPPER, 106, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 84, 20, 18, 24, 24, 20);
+        setScaledBlock(*upArea, Materialtype::HEATER, 86, 22, 20, 20, 20, 4);
+        setScaledBlock(*upArea, Materialtype::COPPER, 90, 26, 24, 12, 12, 14);
+        setScaledBlock(*upArea, Materialtype::COPPER, 84, 20, 38, 24, 24, 2);
+        setScaledBlock(*upArea, Materialtype::COPPER, 84, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 86, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 88, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 90, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 92, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 94, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 96, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 98, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 100, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 102, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 104, 20, 38, 1, 24, 20);
+        setScaledBlock(*upArea, Materialtype::COPPER, 106, 20, 38, 1, 24, 20);
 
         rSensors.push_back(Sensor(glm::vec3(0.26, 0.26, 0.3), "CoolerA"));
         rSensors.push_back(Sensor(glm::vec3(0.76, 0.26, 0.3), "CoolerB"));
         break;
     case SetupType::FANS:
-        upArea->setBlock(Materialtype::HEATER, 50, 20, 50, 12, 4, 28);
+        setScaledBlock(*upArea, Materialtype::HEATER, 50, 20, 50, 12, 4, 28);
 
         rFans.push_back(Fan(glm::vec3(0.35f, 0.3f, 0.5f), 0.2f, glm::vec3(1, 1, 0), 0.4f));
         rFans.push_back(Fan(glm::vec3(0.5f, 0.5f, 0.5f), 0.2f, glm::vec3(1, 0.4f, 0.3f), 0.4f));
         break;
     case SetupType::BEER:
-        upArea->setBlock(Materialtype::GLASS, 50, 20, 50, 28, 60, 28);
-        upArea->setBlock(Materialtype::BEER, 52, 24, 52, 24, 48, 24);
-        upArea->setBlock(Materialtype::FOAM, 52, 72, 52, 24, 4, 24);
-        upArea->setBlock(Materialtype::AIR, 52, 76, 52, 24, 4, 24);
-        upArea->setBlock(Materialtype::COPPER, 40, 12, 40, 48, 8, 48);
-        upArea->setBlock(Materialtype::HEATER, 54, 12, 54, 20, 4, 20);
-        upArea->setBlock(Materialtype::ISOLATOR, 40, 10, 40, 48, 2, 48);
+        setScaledBlock(*upArea, Materialtype::GLASS, 50, 20, 50, 28, 60, 28);
+        setScaledBlock(*upArea, Materialtype::BEER, 52, 24, 52, 24, 48, 24);
+        setScaledBlock(*upArea, Materialtype::FOAM, 52, 72, 52, 24, 4, 24);
+        setScaledBlock(*upArea, Materialtype::AIR, 52, 76, 52, 24, 4, 24);
+        setScaledBlock(*upArea, Materialtype::COPPER, 40, 12, 40, 48, 8, 48);
+        setScaledBlock(*upArea, Materialtype::HEATER, 54, 12, 54, 20, 4, 20);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 40, 10, 40, 48, 2, 48);
 
         rSensors.push_back(Sensor(glm::vec3(0.5, 0.3, 0.5), "Beer"));
         break;
     case SetupType::CHANDELIER:
-        upArea->setBlock(Materialtype::ISOLATOR,60,60,60,8,8,8 );
-        upArea->setBlock(Materialtype::ISOLATOR, 68,60,60,26,8,8);
-        upArea->setBlock(Materialtype::ISOLATOR, 34,60,60,26,8,8);
-        upArea->setBlock(Materialtype::ISOLATOR, 60,60,68,8,8,26);
-        upArea->setBlock(Materialtype::ISOLATOR, 60,60,34,8,8,26);
-        upArea->setBlock(Materialtype::HEATER, 62,62,62,4,4,4);
-        upArea->setBlock(Materialtype::COPPER, 66,62,62,30,4,4);
-        upArea->setBlock(Materialtype::IRON, 32,62,62,30,4,4);
-        upArea->setBlock(Materialtype::ZINC, 62,62,66,4,4,30);
-        upArea->setBlock(Materialtype::DIAMOND, 62,62,32,4,4,30);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR,60,60,60,8,8,8 );
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 68,60,60,26,8,8);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 34,60,60,26,8,8);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 60,60,68,8,8,26);
+        setScaledBlock(*upArea, Materialtype::ISOLATOR, 60,60,34,8,8,26);
+        setScaledBlock(*upArea, Materialtype::HEATER, 62,62,62,4,4,4);
+        setScaledBlock(*upArea, Materialtype::COPPER, 66,62,62,30,4,4);
+        setScaledBlock(*upArea, Materialtype::IRON, 32,62,62,30,4,4);
+        setScaledBlock(*upArea, Materialtype::ZINC, 62,62,66,4,4,30);
+        setScaledBlock(*upArea, Materialtype::DIAMOND, 62,62,32,4,4,30);
 
         rSensors.push_back(Sensor(glm::vec3(0.75f, 0.5f, 0.5f), "Copper"));
         rSensors.push_back(Sensor(glm::vec3(0.25f, 0.5f, 0.5f), "Iron"));
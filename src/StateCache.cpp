@@ -0,0 +1,177 @@
+#include "StateCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+
+// Identifies cache files, changes with layout of the file
+const uint32_t STATE_CACHE_MAGIC = 0x53434831;
+
+// FNV-1a over raw bytes
+static void hashBytes(uint64_t &rHash, const void* pData, size_t size)
+{
+    const unsigned char* pBytes = (const unsigned char*)pData;
+    for (size_t i = 0; i < size; i++)
+    {
+        rHash ^= pBytes[i];
+        rHash *= 1099511628211ull;
+    }
+}
+
+template<typename T>
+static void hashValue(uint64_t &rHash, const T &rValue)
+{
+    hashBytes(rHash, &rValue, sizeof(T));
+}
+
+StateCache::StateCache(const std::string& rDirectory, Area &area, const std::vector<Fan> &rFans, const StateCacheSettings &rSettings)
+{
+    mDirectory = rDirectory;
+    mpArea = &area;
+    mCheckpointInterval = 200;
+
+    mKey = 14695981039346656037ull;
+    int resolution = area.getResolution();
+    hashValue(mKey, resolution);
+    hashValue(mKey, area.getSimulationBoxMin());
+    hashValue(mKey, area.getSimulationBoxMax());
+    hashValue(mKey, area.getStoragePrecision());
+
+    // Members one by one, padding of the struct is undefined
+    hashValue(mKey, rSettings.timeStep);
+    hashValue(mKey, rSettings.edgeLength);
+    hashValue(mKey, rSettings.fluidRelaxation);
+    hashValue(mKey, rSettings.heatRelaxation);
+    hashValue(mKey, rSettings.fluidRelaxationSteps);
+    hashValue(mKey, rSettings.heatRelaxationSteps);
+    hashValue(mKey, rSettings.fluidTolerance);
+    hashValue(mKey, rSettings.heatTolerance);
+    hashValue(mKey, rSettings.advection);
+    hashValue(mKey, rSettings.fluidBackend);
+    hashValue(mKey, rSettings.sweepsPerCheck);
+    hashValue(mKey, rSettings.useActiveBricks);
+    hashValue(mKey, rSettings.tileSize);
+    hashValue(mKey, rSettings.fusedSimulation);
+    hashValue(mKey, rSettings.cpuSimulation);
+    hashValue(mKey, rSettings.warmStart);
+    hashValue(mKey, rSettings.solveSteadyState);
+    hashBytes(mKey, area.getLookupData(), sizeof(float) * area.getVoxelCount());
+    for (const Materialtype& type : area.getMaterialList())
+    {
+        hashValue(mKey, area.determineMaterial(type));
+    }
+    for (const Fan& fan : rFans)
+    {
+        hashValue(mKey, fan.getPosition());
+        hashValue(mKey, fan.getSpeed());
+        hashValue(mKey, fan.getDirection());
+        hashValue(mKey, fan.getDistance());
+    }
+}
+
+int StateCache::restore()
+{
+    // Checkpoints of the schedule are probed in order, the first missing one ends the common prefix
+    int step = 0;
+    while (std::ifstream(getPath(step + mCheckpointInterval).c_str(), std::ios::binary).good())
+    {
+        step += mCheckpointInterval;
+    }
+
+    // Unreadable checkpoints, like ones of an interrupted write, fall back to the next older one
+    // and are removed, so the run writes them again
+    for (; step > 0; step -= mCheckpointInterval)
+    {
+        if (load(step))
+        {
+            std::cout << "State cache: restored " << step << " steps" << std::endl;
+            return step;
+        }
+        std::cout << "State cache: removed unreadable " << getPath(step) << std::endl;
+        std::remove(getPath(step).c_str());
+    }
+    return 0;
+}
+
+void StateCache::store(int step)
+{
+    if (step <= 0 || step % mCheckpointInterval != 0)
+    {
+        return;
+    }
+
+    std::string path = getPath(step);
+    if (std::ifstream(path.c_str(), std::ios::binary).good())
+    {
+        return;
+    }
+
+    std::vector<float> temperature = mpArea->readTemperature();
+    std::vector<float> velocity = mpArea->readVelocity();
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cout << "State cache: cannot write " << path << std::endl;
+        return;
+    }
+    uint32_t magic = STATE_CACHE_MAGIC;
+    uint32_t voxelCount = (uint32_t)mpArea->getVoxelCount();
+    file.write((const char*)&magic, sizeof(magic));
+    file.write((const char*)&voxelCount, sizeof(voxelCount));
+    file.write((const char*)temperature.data(), sizeof(float) * temperature.size());
+    file.write((const char*)velocity.data(), sizeof(float) * velocity.size());
+}
+
+bool StateCache::load(int step)
+{
+    std::ifstream file(getPath(step).c_str(), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t voxelCount = 0;
+    file.read((char*)&magic, sizeof(magic));
+    file.read((char*)&voxelCount, sizeof(voxelCount));
+    if (magic != STATE_CACHE_MAGIC || voxelCount != (uint32_t)mpArea->getVoxelCount())
+    {
+        return false;
+    }
+
+    std::vector<float> temperature(voxelCount);
+    std::vector<float> velocity(4 * voxelCount);
+    file.read((char*)temperature.data(), sizeof(float) * temperature.size());
+    file.read((char*)velocity.data(), sizeof(float) * velocity.size());
+    if (!file)
+    {
+        return false;
+    }
+
+    mpArea->writeTemperature(temperature);
+    mpArea->writeVelocity(velocity);
+    return true;
+}
+
+std::string StateCache::getPath(int step) const
+{
+    std::stringstream path;
+    path << mDirectory << "state_" << std::hex << std::setfill('0') << std::setw(16) << mKey << std::dec << "_" << step << ".bin";
+    return path.str();
+}
+
+void StateCache::setCheckpointInterval(int steps)
+{
+    if (steps > 0)
+        mCheckpointInterval = steps;
+    else
+        mCheckpointInterval = 200;
+}
+
+uint64_t StateCache::getKey() const
+{
+    return mKey;
+}
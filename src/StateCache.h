@@ -0,0 +1,58 @@
+#ifndef STATECACHE_H_
+#define STATECACHE_H_
+
+#include "Area.h"
+#include "Fan.h"
+#include "RelaxationMethod.h"
+#include "Advector.h"
+#include "LatticeBoltzmann.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Settings of simulators and start of the run, which change its results
+struct StateCacheSettings
+{
+    float timeStep;
+    float edgeLength;
+    RelaxationMethod fluidRelaxation;
+    RelaxationMethod heatRelaxation;
+    int fluidRelaxationSteps;
+    int heatRelaxationSteps;
+    float fluidTolerance;
+    float heatTolerance;
+    AdvectionScheme advection;
+    FluidBackend fluidBackend;
+    int sweepsPerCheck;
+    bool useActiveBricks;
+    int tileSize; // Size of active bricks
+    bool fusedSimulation;
+    bool cpuSimulation;
+    bool warmStart;
+    bool solveSteadyState;
+};
+
+// Checkpoints of temperature and velocity keyed by a hash of everything that determines the run:
+// resolution, simulation box, storage precision, material lookup, material table, fans and settings.
+// Checkpoints are taken every few steps, so a run restores the latest one of the common prefix of its schedule
+class StateCache
+{
+public:
+    StateCache(const std::string& rDirectory, Area &area, const std::vector<Fan> &rFans, const StateCacheSettings &rSettings);
+
+    int restore(); // Loads latest readable checkpoint and returns count of steps it covers, zero without checkpoint
+    void store(int step); // Writes checkpoint when step is on the schedule and not yet cached
+    void setCheckpointInterval(int steps);
+    uint64_t getKey() const;
+
+private:
+    std::string getPath(int step) const;
+    bool load(int step);
+
+    std::string mDirectory;
+    Area* mpArea;
+    uint64_t mKey;
+    int mCheckpointInterval;
+};
+
+#endif // STATECACHE_H_
@@ -0,0 +1,255 @@
+#include "SteadyStateSolver.h"
+
+#include <cmath>
+
+static double dot(const std::vector<double>& rA, const std::vector<double>& rB)
+{
+    double sum = 0;
+    for (size_t i = 0; i < rA.size(); i++)
+    {
+        sum += rA[i] * rB[i];
+    }
+    return sum;
+}
+
+SteadyStateSolver::SteadyStateSolver(Area &area, HeatSimulator &heatSimulator)
+{
+    mpArea = &area;
+    mpHeatSimulator = &heatSimulator;
+    mMaxIterations = 2000;
+    mTolerance = 0.000001f;
+    mFrozenFlow = true;
+}
+
+void SteadyStateSolver::assemble(const std::vector<float>& rTemperature, const std::vector<float>& rVelocity)
+{
+    int resolution = mpArea->getResolution();
+    Material* pMaterials = mpArea->getMaterialData();
+    glm::ivec3 boxMin = mpArea->getSimulationBoxMin();
+    glm::ivec3 boxMax = mpArea->getSimulationBoxMax();
+    float conductanceScale = mpHeatSimulator->getConductanceScale();
+    float edgeLength = mpHeatSimulator->getMEdgeLenght();
+
+    // Outside of the volume the shader loads lookup and temperature zero, a conducting neighbor at 0 degrees
+    Material outsideMaterial = mpArea->determineMaterial(mpArea->getMaterialList()[0]);
+
+    // Heaters are fixed to their temperature like the heat simulator does after every step
+    std::vector<int> unknownOfVoxel(mpArea->getVoxelCount(), -1);
+    mUnknownVoxels.clear();
+    for (int z = boxMin.z; z < boxMax.z; z++)
+    {
+        for (int y = boxMin.y; y < boxMax.y; y++)
+        {
+            for (int x = boxMin.x; x < boxMax.x; x++)
+            {
+                int voxel = x + y * resolution + z * resolution * resolution;
+                if (pMaterials[voxel].cisf.y <= 0)
+                {
+                    unknownOfVoxel[voxel] = (int)mUnknownVoxels.size();
+                    mUnknownVoxels.push_back(voxel);
+                }
+            }
+        }
+    }
+
+    int unknownCount = (int)mUnknownVoxels.size();
+    mDiagonal.assign(unknownCount, 0.f);
+    mNeighborCoefficients.assign(6 * unknownCount, 0.f);
+    mNeighborUnknowns.assign(6 * unknownCount, -1);
+    mRightHandSide.assign(unknownCount, 0.f);
+
+    // Neighbors in order +x, -x, +y, -y, +z, -z
+    const glm::ivec3 offsets[6] = {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0),
+        glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0),
+        glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1) };
+
+    for (int i = 0; i < unknownCount; i++)
+    {
+        int voxel = mUnknownVoxels[i];
+        glm::ivec3 coords(voxel % resolution, (voxel / resolution) % resolution, voxel / (resolution * resolution));
+        const Material& rMaterial = pMaterials[voxel];
+        bool fluid = rMaterial.cisf.w > 0;
+
+        for (int j = 0; j < 6; j++)
+        {
+            glm::ivec3 neighborCoords = coords + offsets[j];
+            bool outside = glm::any(glm::lessThan(neighborCoords, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(neighborCoords, glm::ivec3(resolution)));
+            int neighbor = outside ? -1 : neighborCoords.x + neighborCoords.y * resolution + neighborCoords.z * resolution * resolution;
+            const Material& rNeighborMaterial = outside ? outsideMaterial : pMaterials[neighbor];
+
+            // Same conductance as in the heat simulation
+            float coefficient = conductanceScale * (rMaterial.cisf.x + rNeighborMaterial.cisf.x);
+
+            // Upwind convection from neighbor the flow comes from
+            if (mFrozenFlow && fluid)
+            {
+                int axis = j / 2;
+                float velocity = rVelocity[4 * voxel + axis];
+                float towardsNeighbor = (j % 2 == 0) ? velocity : -velocity;
+                if (towardsNeighbor < 0)
+                {
+                    coefficient += rMaterial.cisf.z * rMaterial.dppp.x * -towardsNeighbor / edgeLength;
+                }
+            }
+
+            mDiagonal[i] += coefficient;
+            if (outside)
+            {
+                continue;
+            }
+            if (unknownOfVoxel[neighbor] >= 0)
+            {
+                mNeighborCoefficients[6 * i + j] = coefficient;
+                mNeighborUnknowns[6 * i + j] = unknownOfVoxel[neighbor];
+            }
+            else
+            {
+                mRightHandSide[i] += coefficient * rTemperature[neighbor];
+            }
+        }
+
+        // Voxels without any conductance, like inside of isolators, keep their temperature
+        if (mDiagonal[i] <= 0)
+        {
+            mDiagonal[i] = 1.f;
+            mRightHandSide[i] = rTemperature[voxel];
+        }
+    }
+}
+
+void SteadyStateSolver::multiply(const std::vector<double>& rX, std::vector<double>& rY) const
+{
+    for (size_t i = 0; i < rX.size(); i++)
+    {
+        double sum = mDiagonal[i] * rX[i];
+        for (int j = 0; j < 6; j++)
+        {
+            int neighbor = mNeighborUnknowns[6 * i + j];
+            if (neighbor >= 0)
+            {
+                sum -= mNeighborCoefficients[6 * i + j] * rX[neighbor];
+            }
+        }
+        rY[i] = sum;
+    }
+}
+
+void SteadyStateSolver::precondition(const std::vector<double>& rX, std::vector<double>& rY) const
+{
+    for (size_t i = 0; i < rX.size(); i++)
+    {
+        rY[i] = rX[i] / mDiagonal[i];
+    }
+}
+
+SteadyStateInfo SteadyStateSolver::solve()
+{
+    std::vector<float> temperature = mpArea->readTemperature();
+    std::vector<float> velocity;
+    if (mFrozenFlow)
+    {
+        velocity = mpArea->readVelocity();
+    }
+
+    // Heaters are set to their temperature
+    Material* pMaterials = mpArea->getMaterialData();
+    for (int i = 0; i < mpArea->getVoxelCount(); i++)
+    {
+        if (pMaterials[i].cisf.y > 0)
+        {
+            temperature[i] = pMaterials[i].cisf.y;
+        }
+    }
+    assemble(temperature, velocity);
+
+    // Current temperature is initial guess
+    size_t unknownCount = mUnknownVoxels.size();
+    std::vector<double> x(unknownCount);
+    for (size_t i = 0; i < unknownCount; i++)
+    {
+        x[i] = temperature[mUnknownVoxels[i]];
+    }
+
+    // Right preconditioned BiCGSTAB. Vectors are double, as fixed voxels dominate the right hand side
+    // and float rounding of it alone would exceed the relative tolerance
+    std::vector<double> r(unknownCount), rHat(unknownCount), p(unknownCount, 0.0), v(unknownCount, 0.0);
+    std::vector<double> pHat(unknownCount), s(unknownCount), sHat(unknownCount), t(unknownCount);
+    multiply(x, r);
+    for (size_t i = 0; i < unknownCount; i++)
+    {
+        r[i] = mRightHandSide[i] - r[i];
+    }
+    rHat = r;
+
+    // Fixed voxels dominate the right hand side, so the residual is relative to the initial one
+    double initialNorm = std::sqrt(dot(r, r));
+    if (initialNorm <= 0)
+    {
+        initialNorm = 1;
+    }
+    double rho = 1, alpha = 1, omega = 1;
+    SteadyStateInfo info = { 0, (float)(std::sqrt(dot(r, r)) / initialNorm), false };
+    while (info.iterations < mMaxIterations && info.residual > mTolerance)
+    {
+        double rhoNext = dot(rHat, r);
+        if (rhoNext == 0 || omega == 0)
+        {
+            break;
+        }
+        double beta = (rhoNext / rho) * (alpha / omega);
+        rho = rhoNext;
+        for (size_t i = 0; i < unknownCount; i++)
+        {
+            p[i] = r[i] + beta * (p[i] - omega * v[i]);
+        }
+        precondition(p, pHat);
+        multiply(pHat, v);
+        alpha = rho / dot(rHat, v);
+        for (size_t i = 0; i < unknownCount; i++)
+        {
+            s[i] = r[i] - alpha * v[i];
+        }
+        precondition(s, sHat);
+        multiply(sHat, t);
+        double tt = dot(t, t);
+        omega = tt > 0 ? dot(t, s) / tt : 0;
+        for (size_t i = 0; i < unknownCount; i++)
+        {
+            x[i] += alpha * pHat[i] + omega * sHat[i];
+            r[i] = s[i] - omega * t[i];
+        }
+        info.iterations++;
+        info.residual = (float)(std::sqrt(dot(r, r)) / initialNorm);
+    }
+    info.converged = info.residual <= mTolerance;
+
+    for (size_t i = 0; i < unknownCount; i++)
+    {
+        temperature[mUnknownVoxels[i]] = (float)x[i];
+    }
+    mpArea->writeTemperature(temperature);
+
+    return info;
+}
+
+void SteadyStateSolver::setMaxIterations(int iterations)
+{
+    if (iterations > 0)
+        mMaxIterations = iterations;
+    else
+        mMaxIterations = 2000;
+}
+
+void SteadyStateSolver::setTolerance(float tolerance)
+{
+    if (tolerance > 0.f)
+        mTolerance = tolerance;
+    else
+        mTolerance = 0.000001f;
+}
+
+void SteadyStateSolver::setFrozenFlow(bool frozenFlow)
+{
+    mFrozenFlow = frozenFlow;
+}
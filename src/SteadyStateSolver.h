@@ -0,0 +1,50 @@
+#ifndef STEADYSTATESOLVER_H_
+#define STEADYSTATESOLVER_H_
+
+#include "Area.h"
+#include "HeatSimulator.h"
+#include <vector>
+
+// Telemetry of the solve
+struct SteadyStateInfo
+{
+    int iterations; // Performed iterations of BiCGSTAB
+    float residual; // Norm relative to the one of the initial temperature
+    bool converged; // Residual went below tolerance before maximum of iterations
+};
+
+// Solves for the equilibrium temperature of the simulation box directly instead of running the transient
+// simulation until it settles. Conduction uses the same conductances as the heat simulator, convection
+// is upwinded with the current velocity frozen. Heaters and voxels outside of the box keep their temperature,
+// outside of the volume is a conducting neighbor at 0 degrees like in the shader.
+// Linear system is solved by BiCGSTAB with diagonal preconditioning on the CPU
+class SteadyStateSolver
+{
+public:
+    SteadyStateSolver(Area &area, HeatSimulator &heatSimulator);
+
+    SteadyStateInfo solve(); // Writes equilibrium into temperature volume of area
+    void setMaxIterations(int iterations);
+    void setTolerance(float tolerance); // Residual relative to the one of the initial temperature
+    void setFrozenFlow(bool frozenFlow);
+
+private:
+    void assemble(const std::vector<float>& rTemperature, const std::vector<float>& rVelocity);
+    void multiply(const std::vector<double>& rX, std::vector<double>& rY) const;
+    void precondition(const std::vector<double>& rX, std::vector<double>& rY) const;
+
+    Area* mpArea;
+    HeatSimulator* mpHeatSimulator;
+    int mMaxIterations;
+    float mTolerance;
+    bool mFrozenFlow;
+
+    // Seven point stencil of unknowns, neighbor index is -1 for fixed voxels
+    std::vector<int> mUnknownVoxels;
+    std::vector<float> mDiagonal;
+    std::vector<float> mNeighborCoefficients; // Six per unknown
+    std::vector<int> mNeighborUnknowns; // Six per unknown
+    std::vector<float> mRightHandSide;
+};
+
+#endif // STEADYSTATESOLVER_H_
@@ -0,0 +1,32 @@
+#include "StepScheduler.h"
+#include "TimeStepLimits.h"
+
+#include <algorithm>
+
+StepScheduler::StepScheduler(FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator)
+{
+    mpFluidSimulator = &fluidSimulator;
+    mpHeatSimulator = &heatSimulator;
+    mSubstepCount = 1;
+    mSubstepsClamped = false;
+}
+
+void StepScheduler::nextStep(float dt)
+{
+    // Common time step is the one of the faster system
+    float maxSpeed = mpFluidSimulator->measureMaxSpeed();
+    float stableTimeStep = std::min(mpFluidSimulator->computeStableTimeStep(maxSpeed), mpHeatSimulator->computeStableTimeStep(maxSpeed));
+    mSubstepCount = countSubsteps(dt, stableTimeStep, mSubstepsClamped);
+
+    // Heat sees velocity at the end of each substep
+    for (int i = 0; i < mSubstepCount; i++)
+    {
+        mpFluidSimulator->simulate(dt / mSubstepCount);
+        mpHeatSimulator->simulate(dt / mSubstepCount);
+    }
+}
+
+int StepScheduler::getSubstepCount() const
+{
+    return mSubstepCount;
+}
@@ -0,0 +1,24 @@
+#ifndef STEPSCHEDULER_H_
+#define STEPSCHEDULER_H_
+
+#include "FluidSimulator.h"
+#include "HeatSimulator.h"
+
+// Advances fluid and heat simulation with common substeps of the smaller stable time step. Both systems
+// are limited by the same velocity, so their stable time steps only differ for the lattice Boltzmann backend
+class StepScheduler
+{
+public:
+    StepScheduler(FluidSimulator &fluidSimulator, HeatSimulator &heatSimulator);
+
+    void nextStep(float dt);
+    int getSubstepCount() const;
+
+private:
+    FluidSimulator* mpFluidSimulator;
+    HeatSimulator* mpHeatSimulator;
+    int mSubstepCount;
+    bool mSubstepsClamped;
+};
+
+#endif // STEPSCHEDULER_H_
@@ -0,0 +1,35 @@
+#ifndef TIMESTEPLIMITS_H_
+#define TIMESTEPLIMITS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+// Upper bound of substeps per step, even when stable time step would require more
+const int MAX_SUBSTEPS = 16;
+
+// Voxels the semi-Lagrangian advection may trace back per step, bounded for accuracy only
+const float SEMI_LAGRANGIAN_COURANT_NUMBER = 4.f;
+
+// Steps of at most the stable time step which cover dt, bounded by MAX_SUBSTEPS. Bounded steps are
+// longer than stable ones, which rClamped tells and which is warned about when it begins. A stable time
+// step that is zero or not a number, like after a diverged velocity, needs the bound
+inline int countSubsteps(float dt, float stableTimeStep, bool& rClamped)
+{
+    float count = stableTimeStep > 0 ? std::ceil(dt / stableTimeStep) : std::numeric_limits<float>::infinity();
+    if (!(count >= 1))
+    {
+        count = 1;
+    }
+    bool clamped = count > MAX_SUBSTEPS;
+    if (clamped && !rClamped)
+    {
+        std::cout << "Warning: stable time step of " << stableTimeStep << " s would need " << count
+            << " substeps, clamped to " << MAX_SUBSTEPS << ", simulation may become unstable" << std::endl;
+    }
+    rClamped = clamped;
+    return (int)std::min(count, (float)MAX_SUBSTEPS);
+}
+
+#endif // TIMESTEPLIMITS_H_
@@ -0,0 +1,124 @@
+#include "VelocityReduction.h"
+#include "VelocityReductionShader.h"
+
+#include <iostream>
+#include <cstring>
+
+VelocityReduction::VelocityReduction(Area &area)
+{
+    mVelocityVolume = area.getVelocityVolumeHandle();
+    mBoxMin = area.getSimulationBoxMin();
+    mBoxMax = area.getSimulationBoxMax();
+
+    // Reductions alternate between two buffers, one is written while the other is read
+    GLuint initialData = 0;
+    glGenBuffers(2, mMaxSpeedSSBOs);
+    for (GLuint maxSpeedSSBO : mMaxSpeedSSBOs)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxSpeedSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &initialData, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    mCurrentSSBO = 0;
+    mStarted = false;
+
+    prepareShader();
+}
+
+VelocityReduction::~VelocityReduction()
+{
+    glDeleteProgram(mVelocityReductionProgram);
+    glDeleteBuffers(2, mMaxSpeedSSBOs);
+}
+
+void VelocityReduction::prepareShader()
+{
+    mVelocityReductionProgram = glCreateProgram();
+    GLint velocityReductionCS = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(velocityReductionCS, 1, &velocityReductionComputeShader, NULL);
+    glCompileShader(velocityReductionCS);
+
+    // Get length of compiling log
+    GLint log_length = 0;
+    glGetShaderiv(velocityReductionCS, GL_INFO_LOG_LENGTH, &log_length);
+
+    if (log_length > 1)
+    {
+        // Copy log to chars
+        GLchar *log = new GLchar[log_length];
+        glGetShaderInfoLog(velocityReductionCS, log_length, NULL, log);
+
+        // Print it
+        std::cout << log << std::endl;
+
+        // Delete chars
+        delete[] log;
+    }
+
+    glAttachShader(mVelocityReductionProgram, velocityReductionCS);
+    glLinkProgram(mVelocityReductionProgram);
+    glDetachShader(mVelocityReductionProgram, velocityReductionCS);
+    glDeleteShader(velocityReductionCS);
+
+    mVelocityVolumeLocation = glGetUniformLocation(mVelocityReductionProgram, "velocityVolume");
+    mBoxMinLocation = glGetUniformLocation(mVelocityReductionProgram, "boxMin");
+    mBoxMaxLocation = glGetUniformLocation(mVelocityReductionProgram, "boxMax");
+}
+
+float VelocityReduction::computeMaxSpeed()
+{
+    // Velocity has changed only little within a frame, so the maximum of the previous one is good enough.
+    // Very first call has no previous result and waits for its own
+    int previousSSBO = 1 - mCurrentSSBO;
+    dispatch(mMaxSpeedSSBOs[mCurrentSSBO]);
+    if (!mStarted)
+    {
+        mStarted = true;
+        previousSSBO = mCurrentSSBO;
+    }
+    mCurrentSSBO = 1 - mCurrentSSBO;
+    return read(mMaxSpeedSSBOs[previousSSBO]);
+}
+
+void VelocityReduction::dispatch(GLuint maxSpeedSSBO) const
+{
+    // Reset maximum
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxSpeedSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Velocity has to be written by simulators before fetching it
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glUseProgram(mVelocityReductionProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, maxSpeedSSBO);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, mVelocityVolume);
+
+    glUniform1i(mVelocityVolumeLocation, 0);
+    glUniform3i(mBoxMinLocation, mBoxMin.x, mBoxMin.y, mBoxMin.z);
+    glUniform3i(mBoxMaxLocation, mBoxMax.x, mBoxMax.y, mBoxMax.z);
+
+    // One invocation per voxel of simulation box
+    glm::ivec3 groups = (mBoxMax - mBoxMin + 7) / 8;
+    glDispatchCompute(groups.x, groups.y, groups.z);
+
+    glUseProgram(0);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+float VelocityReduction::read(GLuint maxSpeedSSBO) const
+{
+    // Waits only for the dispatch which wrote the buffer
+    GLuint maxSpeedBits = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maxSpeedSSBO);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &maxSpeedBits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    float maxSpeed;
+    std::memcpy(&maxSpeed, &maxSpeedBits, sizeof(float));
+    return maxSpeed;
+}
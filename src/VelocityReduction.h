@@ -0,0 +1,34 @@
+#ifndef VELOCITYREDUCTION_H_
+#define VELOCITYREDUCTION_H_
+
+#include "Area.h"
+#include "externals/OpenGLLoader/gl_core_4_3.h"
+
+// Determines maximum speed in simulation box, used for time step control. Results are read one call
+// later, so the GPU has finished the reduction by then and the pipeline is not drained every frame
+class VelocityReduction
+{
+public:
+    VelocityReduction(Area &area);
+    ~VelocityReduction();
+
+    float computeMaxSpeed(); // Starts reduction of current velocity, returns the one started by previous call
+
+private:
+    void prepareShader();
+    void dispatch(GLuint maxSpeedSSBO) const;
+    float read(GLuint maxSpeedSSBO) const;
+
+    GLuint mVelocityReductionProgram;
+    GLuint mMaxSpeedSSBOs[2];
+    int mCurrentSSBO;
+    bool mStarted;
+    GLuint mVelocityVolume;
+    int mVelocityVolumeLocation;
+    int mBoxMinLocation;
+    int mBoxMaxLocation;
+    glm::ivec3 mBoxMin;
+    glm::ivec3 mBoxMax;
+};
+
+#endif // VELOCITYREDUCTION_H_
@@ -0,0 +1,51 @@
+#ifndef VELOCITYREDUCTIONSHADER_H_
+#define VELOCITYREDUCTIONSHADER_H_
+
+// Maximum speed inside of simulation box, reduced per workgroup in shared memory and then atomically over all workgroups.
+// Velocity is fetched through sampler, so any storage format works
+const char* velocityReductionComputeShader =
+"#version 430 core\n"
+
+// Workgroup settings
+"layout(local_size_x=8, local_size_y=8, local_size_z=8) in;\n"
+
+// SSBOs
+"layout(std430, binding = 0) buffer MaxSpeed\n"
+"{\n"
+"	uint maxSpeedBits;\n" // Positive floats keep their order as uint
+"};\n"
+
+// Uniforms
+"uniform sampler3D velocityVolume;\n"
+"uniform ivec3 boxMin;\n"
+"uniform ivec3 boxMax;\n"
+
+// Shared memory
+"shared float speeds[512];\n"
+
+// Main
+"void main()\n"
+"{\n"
+"	ivec3 coords = boxMin + ivec3(gl_GlobalInvocationID);\n"
+"	float speed = 0;\n"
+"	if(all(lessThan(coords, boxMax)))\n"
+"	{\n"
+"		speed = length(texelFetch(velocityVolume, coords, 0).xyz);\n"
+"	}\n"
+"	speeds[gl_LocalInvocationIndex] = speed;\n"
+"	barrier();\n"
+"	for(uint stride = 256u; stride > 0u; stride >>= 1)\n"
+"	{\n"
+"		if(gl_LocalInvocationIndex < stride)\n"
+"		{\n"
+"			speeds[gl_LocalInvocationIndex] = max(speeds[gl_LocalInvocationIndex], speeds[gl_LocalInvocationIndex + stride]);\n"
+"		}\n"
+"		barrier();\n"
+"	}\n"
+"	if(gl_LocalInvocationIndex == 0u)\n"
+"	{\n"
+"		atomicMax(maxSpeedBits, floatBitsToUint(speeds[0]));\n"
+"	}\n"
+"}\n";
+
+#endif // VELOCITYREDUCTIONSHADER_H_
@@ -0,0 +1,150 @@
+#include "VolumeArena.h"
+
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// Alignment of buffers within blocks
+const size_t BUFFER_ALIGNMENT = 64;
+
+static size_t roundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void* allocateHugePages(size_t bytes, bool& rExplicitHugePages)
+{
+    size_t size = roundUp(bytes, HUGE_PAGE_SIZE);
+#if defined(_WIN32)
+    // Large pages need the lock memory privilege, without it the allocation fails
+    rExplicitHugePages = true;
+    void* pMemory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if(pMemory == NULL)
+    {
+        rExplicitHugePages = false;
+        pMemory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    return pMemory;
+#elif defined(__linux__)
+    // Explicit huge pages exist only when reserved by the administrator
+    void* pMemory;
+#ifdef MAP_HUGETLB
+    rExplicitHugePages = true;
+    pMemory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(pMemory != MAP_FAILED)
+    {
+        return pMemory;
+    }
+#endif
+    rExplicitHugePages = false;
+
+    // Mapping with one huge page more is trimmed to aligned range, so transparent huge pages can back it
+    pMemory = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(pMemory == MAP_FAILED)
+    {
+        return NULL;
+    }
+    char* pStart = static_cast<char*>(pMemory);
+    char* pAligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(pStart), HUGE_PAGE_SIZE));
+    if(pAligned > pStart)
+    {
+        munmap(pStart, pAligned - pStart);
+    }
+    size_t tail = (pStart + size + HUGE_PAGE_SIZE) - (pAligned + size);
+    if(tail > 0)
+    {
+        munmap(pAligned + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(pAligned, size, MADV_HUGEPAGE);
+#endif
+    return pAligned;
+#else
+    rExplicitHugePages = false;
+    void* pMemory = NULL;
+    if(posix_memalign(&pMemory, HUGE_PAGE_SIZE, size) != 0)
+    {
+        return NULL;
+    }
+    return pMemory;
+#endif
+}
+
+void freeHugePages(void* pMemory, size_t bytes)
+{
+#if defined(_WIN32)
+    VirtualFree(pMemory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(pMemory, roundUp(bytes, HUGE_PAGE_SIZE));
+#else
+    free(pMemory);
+#endif
+}
+
+VolumeArena::VolumeArena()
+{
+}
+
+VolumeArena::~VolumeArena()
+{
+    for(const Block& rBlock : mBlocks)
+    {
+        freeHugePages(rBlock.pMemory, rBlock.size);
+    }
+}
+
+void* VolumeArena::allocate(size_t bytes)
+{
+    bytes = roundUp(bytes > 0 ? bytes : 1, BUFFER_ALIGNMENT);
+
+    // Rest of earlier blocks, small buffers share the last huge page of large ones
+    for(Block& rBlock : mBlocks)
+    {
+        if(rBlock.size - rBlock.used >= bytes)
+        {
+            void* pBuffer = rBlock.pMemory + rBlock.used;
+            rBlock.used += bytes;
+            return pBuffer;
+        }
+    }
+
+    Block block;
+    block.size = roundUp(bytes, HUGE_PAGE_SIZE);
+    block.used = bytes;
+    block.pMemory = static_cast<char*>(allocateHugePages(block.size, block.explicitHugePages));
+    if(block.pMemory == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    mBlocks.push_back(block);
+    return block.pMemory;
+}
+
+size_t VolumeArena::getReservedBytes() const
+{
+    size_t bytes = 0;
+    for(const Block& rBlock : mBlocks)
+    {
+        bytes += rBlock.size;
+    }
+    return bytes;
+}
+
+size_t VolumeArena::getHugePageBytes() const
+{
+    size_t bytes = 0;
+    for(const Block& rBlock : mBlocks)
+    {
+        if(rBlock.explicitHugePages)
+        {
+            bytes += rBlock.size;
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,90 @@
+#ifndef VOLUMEARENA_H_
+#define VOLUMEARENA_H_
+
+#include <vector>
+#include <new>
+#include <cstddef>
+
+// Size of huge pages, to which blocks are aligned
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Whole huge pages, backed by explicit ones if the system has them reserved and by transparent ones
+// otherwise. Returns null on failure
+void* allocateHugePages(size_t bytes, bool& rExplicitHugePages);
+void freeHugePages(void* pMemory, size_t bytes);
+
+// For containers of volume size that are resized, like the fields of the CPU kernels. Small allocations
+// come from the heap
+template<typename T>
+struct HugePageAllocator
+{
+    typedef T value_type;
+
+    HugePageAllocator() {}
+    template<typename U> HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if(bytes < HUGE_PAGE_SIZE)
+        {
+            return static_cast<T*>(::operator new(bytes));
+        }
+        bool explicitHugePages;
+        void* pMemory = allocateHugePages(bytes, explicitHugePages);
+        if(pMemory == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(pMemory);
+    }
+
+    void deallocate(T* pMemory, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if(bytes < HUGE_PAGE_SIZE)
+            ::operator delete(pMemory);
+        else
+            freeHugePages(pMemory, bytes);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+template<typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+template<typename T>
+using VolumeVector = std::vector<T, HugePageAllocator<T> >;
+
+// Memory for buffers of whole volumes. Blocks are aligned to huge pages and the operating system is asked
+// to back them with huge pages, explicit ones first and transparent ones otherwise, which spares the TLB
+// misses of stencils striding through planes. Buffers are carved from the blocks and live as long as the
+// arena, so buffers that are needed again, like staging for uploads, are allocated once and reused
+class VolumeArena
+{
+public:
+    VolumeArena();
+    ~VolumeArena();
+
+    void* allocate(size_t bytes); // Uninitialized and aligned to cache lines
+    template<typename T> T* allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T))); }
+    size_t getReservedBytes() const;
+    size_t getHugePageBytes() const; // Of blocks backed by explicit huge pages
+
+private:
+    VolumeArena(const VolumeArena&);
+    VolumeArena& operator=(const VolumeArena&);
+
+    struct Block
+    {
+        char* pMemory;
+        size_t size;
+        size_t used;
+        bool explicitHugePages;
+    };
+
+    std::vector<Block> mBlocks;
+};
+
+#endif // VOLUMEARENA_H_
@@ -0,0 +1,173 @@
+#include "WarmStart.h"
+#include "FluidSimulator.h"
+#include "HeatSimulator.h"
+#include "StepScheduler.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// Steps between comparisons of the temperature
+const int SETTLE_CHECK_STEPS = 10;
+
+WarmStart::WarmStart(SetupType type, float edgeLength, float timeStep,
+    RelaxationMethod fluidRelaxation, RelaxationMethod heatRelaxation, AdvectionScheme advection, FluidBackend fluidBackend)
+{
+    mType = type;
+    mEdgeLength = edgeLength;
+    mTimeStep = timeStep;
+    mFluidRelaxation = fluidRelaxation;
+    mHeatRelaxation = heatRelaxation;
+    mAdvection = advection;
+    mFluidBackend = fluidBackend;
+    mCoarsestResolution = 32;
+    mMaxStepsPerLevel = 500;
+    mTolerance = 0.01f;
+}
+
+void WarmStart::apply(Area &rTarget)
+{
+    int targetResolution = rTarget.getResolution();
+    std::vector<float> temperature;
+    std::vector<float> velocity;
+    int resolution = 0;
+
+    for (int levelResolution = mCoarsestResolution; levelResolution < targetResolution; levelResolution *= 2)
+    {
+        std::vector<Fan> fans;
+        std::vector<Sensor> sensors;
+        std::unique_ptr<Area> upArea = createSetup(mType, fans, sensors, levelResolution);
+
+        // Start from prolonged result of previous level
+        if (resolution > 0)
+        {
+            upArea->writeTemperature(prolong(temperature, resolution, levelResolution, 1));
+            upArea->writeVelocity(prolong(velocity, resolution, levelResolution, 4));
+        }
+
+        simulateLevel(*(upArea.get()), fans, mEdgeLength * targetResolution / levelResolution);
+
+        temperature = upArea->readTemperature();
+        velocity = upArea->readVelocity();
+        resolution = levelResolution;
+    }
+
+    if (resolution > 0)
+    {
+        rTarget.writeTemperature(prolong(temperature, resolution, targetResolution, 1));
+        rTarget.writeVelocity(prolong(velocity, resolution, targetResolution, 4));
+    }
+}
+
+void WarmStart::simulateLevel(Area &rArea, std::vector<Fan> &rFans, float edgeLength)
+{
+    FluidSimulator fluidSimulator(rArea, rFans);
+    fluidSimulator.setMEdgeLenght(edgeLength);
+    fluidSimulator.setRelaxationMethod(mFluidRelaxation);
+    fluidSimulator.setAdvectionScheme(mAdvection);
+    fluidSimulator.setBackend(mFluidBackend);
+    HeatSimulator heatSimulator(rArea);
+    heatSimulator.setMEdgeLenght(edgeLength);
+    heatSimulator.setRelaxationMethod(mHeatRelaxation);
+    heatSimulator.setAdvectionScheme(mAdvection);
+    StepScheduler scheduler(fluidSimulator, heatSimulator);
+
+    std::vector<float> previousTemperature = rArea.readTemperature();
+    int step = 0;
+    float change = 0.f;
+    while (step < mMaxStepsPerLevel)
+    {
+        scheduler.nextStep(mTimeStep);
+        step++;
+
+        // Settled when temperature barely changes between checks
+        if (step % SETTLE_CHECK_STEPS == 0)
+        {
+            std::vector<float> temperature = rArea.readTemperature();
+            change = 0.f;
+            for (size_t i = 0; i < temperature.size(); i++)
+            {
+                change = std::max(change, std::abs(temperature[i] - previousTemperature[i]));
+            }
+            previousTemperature.swap(temperature);
+            if (change <= mTolerance)
+            {
+                break;
+            }
+        }
+    }
+
+    std::cout << "Warm start at " << rArea.getResolution() << ": " << step << " steps, change " << change << std::endl;
+}
+
+void WarmStart::setCoarsestResolution(int resolution)
+{
+    // Coarser levels have no interior to settle
+    if (resolution >= 2)
+        mCoarsestResolution = resolution;
+    else
+        mCoarsestResolution = 32;
+}
+
+void WarmStart::setMaxStepsPerLevel(int steps)
+{
+    if (steps > 0)
+        mMaxStepsPerLevel = steps;
+    else
+        mMaxStepsPerLevel = 500;
+}
+
+void WarmStart::setTolerance(float tolerance)
+{
+    if (tolerance >= 0.f)
+        mTolerance = tolerance;
+    else
+        mTolerance = 0.01f;
+}
+
+std::vector<float> prolong(const std::vector<float>& rCoarse, int coarseResolution, int fineResolution, int channels)
+{
+    std::vector<float> fine((size_t)fineResolution * fineResolution * fineResolution * channels);
+    float scale = (float)coarseResolution / fineResolution;
+
+    // Position of fine voxel center in coarse voxels, split into lower neighbor and weight
+    std::vector<int> lower(fineResolution);
+    std::vector<float> weight(fineResolution);
+    for (int i = 0; i < fineResolution; i++)
+    {
+        float position = std::min(std::max((i + 0.5f) * scale - 0.5f, 0.f), (float)(coarseResolution - 1));
+        lower[i] = std::min((int)position, coarseResolution - 2);
+        weight[i] = position - lower[i];
+    }
+
+    for (int z = 0; z < fineResolution; z++)
+    {
+        for (int y = 0; y < fineResolution; y++)
+        {
+            for (int x = 0; x < fineResolution; x++)
+            {
+                size_t target = ((size_t)x + (size_t)y * fineResolution + (size_t)z * fineResolution * fineResolution) * channels;
+                for (int c = 0; c < channels; c++)
+                {
+                    float value = 0.f;
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        int dx = corner & 1;
+                        int dy = (corner >> 1) & 1;
+                        int dz = (corner >> 2) & 1;
+                        float w = (dx ? weight[x] : 1.f - weight[x])
+                            * (dy ? weight[y] : 1.f - weight[y])
+                            * (dz ? weight[z] : 1.f - weight[z]);
+                        size_t source = ((size_t)(lower[x] + dx)
+                            + (size_t)(lower[y] + dy) * coarseResolution
+                            + (size_t)(lower[z] + dz) * coarseResolution * coarseResolution) * channels;
+                        value += w * rCoarse[source + c];
+                    }
+                    fine[target + c] = value;
+                }
+            }
+        }
+    }
+
+    return fine;
+}
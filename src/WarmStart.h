@@ -0,0 +1,43 @@
+#ifndef WARMSTART_H_
+#define WARMSTART_H_
+
+#include "Setup.h"
+#include "Area.h"
+#include "RelaxationMethod.h"
+#include "Advector.h"
+#include "LatticeBoltzmann.h"
+#include <vector>
+
+// Runs a setup at coarse resolutions until its fields settle and prolongs the result level by level
+// as initial state of the target area. Edge length of the voxels grows with coarser levels, the other
+// simulator settings are the ones of the target run
+class WarmStart
+{
+public:
+    WarmStart(SetupType type, float edgeLength, float timeStep,
+        RelaxationMethod fluidRelaxation, RelaxationMethod heatRelaxation, AdvectionScheme advection, FluidBackend fluidBackend);
+
+    void apply(Area &rTarget); // Writes prolonged temperature and velocity into target
+    void setCoarsestResolution(int resolution); // At least 2, levels double from there
+    void setMaxStepsPerLevel(int steps);
+    void setTolerance(float tolerance); // Largest change of temperature between checks to count as settled
+
+private:
+    void simulateLevel(Area &rArea, std::vector<Fan> &rFans, float edgeLength);
+
+    SetupType mType;
+    float mEdgeLength;
+    float mTimeStep;
+    RelaxationMethod mFluidRelaxation;
+    RelaxationMethod mHeatRelaxation;
+    AdvectionScheme mAdvection;
+    FluidBackend mFluidBackend;
+    int mCoarsestResolution;
+    int mMaxStepsPerLevel;
+    float mTolerance;
+};
+
+// Trilinear interpolation of voxel centers
+std::vector<float> prolong(const std::vector<float>& rCoarse, int coarseResolution, int fineResolution, int channels);
+
+#endif // WARMSTART_H_
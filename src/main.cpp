@@ -7,16 +7,46 @@
 #include "Raycaster.h"
 #include "HeatSimulator.h"
 #include "FluidSimulator.h"
+#include "FusedSimulator.h"
+#include "CpuSimulator.h"
+#include "SteadyStateSolver.h"
+#include "WarmStart.h"
+#include "StateCache.h"
+#include "StepScheduler.h"
 #include "SensorReader.h"
+#include "PassGraph.h"
 #include "Setup.h"
-#include <sstream>
-#include <iomanip>
+#include "PrecisionReport.h"
+#include "AllocationCounter.h"
+#include <cstdio>
+#include <cassert>
 
 // GLM for math
 // picoPNG for loading PNGs
 
 // ########### SETUP SETTINGS ###########
 const SetupType SETUP = SetupType::COOLER_COMPARSION;
+const bool CROP_TO_OCCUPIED_BOX = true; // Only simulate box around geometry, fans and sensors
+const int CROP_MARGIN = 8; // Voxels of air around occupied box
+const StoragePrecision STORAGE_PRECISION = StoragePrecision::FULL; // Half precision halves memory traffic of temperature and velocity
+const bool WARM_START = false; // Start from settled runs at coarser resolutions
+const bool SOLVE_STEADY_STATE = false; // Start from equilibrium temperatures instead of running into them
+const bool USE_STATE_CACHE = false; // Continue from latest checkpoint of an identical earlier run
+const std::string STATE_CACHE_DIRECTORY = ""; // Prefix of checkpoint files, directory must exist
+const int CHECKPOINT_INTERVAL = 200; // Steps between checkpoints
+const bool PRINT_PRECISION_REPORT = false; // Compare half against full precision on all setups before start
+const int PRECISION_REPORT_STEPS = 200;
+const float VOXEL_EDGE_LENGTH = 0.1f; // Meters, for simulators and warm start
+const float SIMULATION_TIME_STEP = 0.5f; // Split into substeps when stable time steps are smaller
+const RelaxationMethod FLUID_RELAXATION = RelaxationMethod::CHEBYSHEV; // Jacobi, SOR or Chebyshev accelerated red-black sweeps
+const RelaxationMethod HEAT_RELAXATION = RelaxationMethod::CHEBYSHEV; // Same as fluid or line relaxation, which solves thin metal structures along their extent
+const AdvectionScheme ADVECTION = AdvectionScheme::CENTERED; // Semi-Lagrangian schemes stay stable for larger time steps
+const FluidBackend FLUID_BACKEND = FluidBackend::STENCIL; // Lattice Boltzmann needs no relaxation sweeps but smaller time steps
+const int SWEEPS_PER_CHECK = 0; // Relaxation sweeps between readbacks of the largest change, 0 keeps the default of each simulator
+const bool USE_ACTIVE_BRICKS = true; // Simulate only bricks with flow or temperature differences
+const int TILE_SIZE = 0; // Relaxation sweeps read neighbors from shared memory tiles of 4 or 8 voxels, 0 reads them from the volumes
+const bool FUSED_SIMULATION = false; // Fluid and heat share one pass per sweep with a common time step
+const bool CPU_SIMULATION = false; // Fluid and heat on the CPU with kernels specialized for the setup
 // ######################################
 
 // Global variables
@@ -121,6 +151,13 @@ int main(void)
     glEnable(GL_TEXTURE_3D);
     glEnable(GL_CULL_FACE);
 
+    // Accuracy of half precision storage
+    if (PRINT_PRECISION_REPORT)
+    {
+        printPrecisionReport(PRECISION_REPORT_STEPS, CROP_TO_OCCUPIED_BOX, CROP_MARGIN, VOXEL_EDGE_LENGTH, SIMULATION_TIME_STEP,
+            FLUID_RELAXATION, HEAT_RELAXATION, ADVECTION, FLUID_BACKEND);
+    }
+
     // Initialize camera
     Camera camera(glm::vec3(0.5f), glm::radians(-135.0f), glm::radians(80.0f), 2, 0.1f, 5);
 
@@ -136,20 +173,111 @@ int main(void)
 
     // Area
     std::unique_ptr<Area> upArea = std::move(createSetup(SETUP, fans, sensors));
+    upArea->setStoragePrecision(STORAGE_PRECISION);
+    if (CROP_TO_OCCUPIED_BOX)
+    {
+        upArea->cropToOccupiedBox(fans, sensors, CROP_MARGIN);
+    }
+
+    // Volume buffers and whether the system backs them with huge pages
+    const size_t MEGABYTE = 1024 * 1024;
+    std::cout << "Volume memory: " << upArea->getArena().getReservedBytes() / MEGABYTE << " MB, "
+        << upArea->getArena().getHugePageBytes() / MEGABYTE << " MB of it in explicit huge pages" << std::endl;
+
+    // Initial state prolonged from coarse levels
+    if (WARM_START)
+    {
+        WarmStart warmStart(SETUP, VOXEL_EDGE_LENGTH, SIMULATION_TIME_STEP, FLUID_RELAXATION, HEAT_RELAXATION, ADVECTION, FLUID_BACKEND);
+        warmStart.apply(*(upArea.get()));
+    }
 
     // Raycaster
-    upRaycaster = std::unique_ptr<Raycaster>(new Raycaster(upArea->getColorVolumeHandle(), upArea->getStateVolumeHandle()));
+    upRaycaster = std::unique_ptr<Raycaster>(new Raycaster(upArea->getColorVolumeHandle(), upArea->getTemperatureVolumeHandle(), upArea->getVelocityVolumeHandle()));
+    upRaycaster->setVolumeBox(
+        glm::vec3(upArea->getSimulationBoxMin()) / (float)upArea->getResolution(),
+        glm::vec3(upArea->getSimulationBoxMax()) / (float)upArea->getResolution());
 
     // Fluid simulator
     FluidSimulator fluidSimulator(*(upArea.get()), fans);
-    fluidSimulator.setMEdgeLenght(0.1f);
+    fluidSimulator.setMEdgeLenght(VOXEL_EDGE_LENGTH);
+    fluidSimulator.setRelaxationMethod(FLUID_RELAXATION);
+    fluidSimulator.setAdvectionScheme(ADVECTION);
+    fluidSimulator.setBackend(FLUID_BACKEND);
+    fluidSimulator.setSweepsPerCheck(SWEEPS_PER_CHECK);
+    fluidSimulator.setUseActiveBricks(USE_ACTIVE_BRICKS);
+    fluidSimulator.setTileSize(TILE_SIZE);
 
     // Heat simulator
     HeatSimulator heatSimulator(*(upArea.get()));
-    heatSimulator.setMEdgeLenght(0.1f);
+    heatSimulator.setMEdgeLenght(VOXEL_EDGE_LENGTH);
+    heatSimulator.setRelaxationMethod(HEAT_RELAXATION);
+    heatSimulator.setAdvectionScheme(ADVECTION);
+    heatSimulator.setSweepsPerCheck(SWEEPS_PER_CHECK);
+    heatSimulator.setUseActiveBricks(USE_ACTIVE_BRICKS);
+    heatSimulator.setTileSize(TILE_SIZE);
+
+    // Equilibrium of conduction with current flow
+    if (SOLVE_STEADY_STATE)
+    {
+        SteadyStateSolver steadyStateSolver(*(upArea.get()), heatSimulator);
+        SteadyStateInfo info = steadyStateSolver.solve();
+        std::cout << "Steady state: " << info.iterations << " iterations, residual " << info.residual << std::endl;
+        if (!info.converged)
+        {
+            std::cout << "Warning: steady state did not converge, simulation starts from the last iterate" << std::endl;
+        }
+    }
+
+    // Fluid and heat share substeps of the smaller stable time step
+    StepScheduler scheduler(fluidSimulator, heatSimulator);
+
+    // Alternatively both are advanced together
+    std::unique_ptr<FusedSimulator> upFusedSimulator;
+    if (FUSED_SIMULATION)
+    {
+        upFusedSimulator = std::unique_ptr<FusedSimulator>(new FusedSimulator(*(upArea.get()), fluidSimulator, heatSimulator));
+        upFusedSimulator->setAdvectionScheme(ADVECTION);
+        upFusedSimulator->setSweepsPerCheck(SWEEPS_PER_CHECK);
+    }
+
+    // Or on the CPU
+    std::unique_ptr<CpuSimulator> upCpuSimulator;
+    if (CPU_SIMULATION)
+    {
+        upCpuSimulator = std::unique_ptr<CpuSimulator>(new CpuSimulator(*(upArea.get()), fans, fluidSimulator, heatSimulator));
+        upCpuSimulator->setSweepsPerCheck(SWEEPS_PER_CHECK);
+    }
+
+    // Skip simulated time already cached
+    std::unique_ptr<StateCache> upStateCache;
+    int simulatedSteps = 0;
+    if (USE_STATE_CACHE)
+    {
+        StateCacheSettings settings;
+        settings.timeStep = SIMULATION_TIME_STEP;
+        settings.edgeLength = fluidSimulator.getMEdgeLenght();
+        settings.fluidRelaxation = FLUID_RELAXATION;
+        settings.heatRelaxation = HEAT_RELAXATION;
+        settings.fluidRelaxationSteps = fluidSimulator.getRelaxationSteps();
+        settings.heatRelaxationSteps = heatSimulator.getRelaxationSteps();
+        settings.fluidTolerance = fluidSimulator.getTolerance();
+        settings.heatTolerance = heatSimulator.getTolerance();
+        settings.advection = ADVECTION;
+        settings.fluidBackend = FLUID_BACKEND;
+        settings.sweepsPerCheck = SWEEPS_PER_CHECK;
+        settings.useActiveBricks = USE_ACTIVE_BRICKS;
+        settings.tileSize = TILE_SIZE;
+        settings.fusedSimulation = FUSED_SIMULATION;
+        settings.cpuSimulation = CPU_SIMULATION;
+        settings.warmStart = WARM_START;
+        settings.solveSteadyState = SOLVE_STEADY_STATE;
+        upStateCache = std::unique_ptr<StateCache>(new StateCache(STATE_CACHE_DIRECTORY, *(upArea.get()), fans, settings));
+        upStateCache->setCheckpointInterval(CHECKPOINT_INTERVAL);
+        simulatedSteps = upStateCache->restore();
+    }
 
     // Sensor reader
-    SensorReader sensorReader(upArea->getStateVolumeHandle(), sensors);
+    SensorReader sensorReader(*(upArea.get()), sensors);
 
     // Variables for the loop
     GLfloat prevTime = (GLfloat)glfwGetTime();
@@ -160,6 +288,92 @@ int main(void)
     glm::mat4 uniformView;
     glm::mat4 uniformProjection;
 
+    // Output is printed in intervals from a buffer of the loop, so frames do not allocate after warm-up
+    const float PRINT_INTERVAL = 0.25f; // Seconds
+    const int WARM_UP_FRAMES = 3;
+    char printBuffer[1024];
+    float timeSincePrint = PRINT_INTERVAL;
+    int framesSincePrint = 0;
+    int frame = 0;
+    size_t warmUpAllocations = 0;
+
+    // Passes of a frame, barriers between them follow from the declared accesses
+    PassGraph frameGraph;
+    frameGraph.addPass("simulation",
+        { { FrameResource::STATE, ResourceAccess::IMAGE }, { FrameResource::LOOKUP, ResourceAccess::IMAGE } },
+        { { FrameResource::STATE, ResourceAccess::IMAGE } },
+        [&]()
+        {
+            // Simulate (TODO: real time steps. at the moment depending on frame time)
+            if (upCpuSimulator)
+            {
+                upCpuSimulator->nextStep(SIMULATION_TIME_STEP);
+            }
+            else if (upFusedSimulator)
+            {
+                upFusedSimulator->nextStep(SIMULATION_TIME_STEP);
+            }
+            else
+            {
+                scheduler.nextStep(SIMULATION_TIME_STEP);
+            }
+            simulatedSteps++;
+        });
+    frameGraph.addPass("upload",
+        {},
+        { { FrameResource::STATE, ResourceAccess::CLIENT } },
+        [&]()
+        {
+            // CPU simulation writes the volumes only for the passes that read them
+            if (upCpuSimulator)
+            {
+                upCpuSimulator->upload();
+            }
+        });
+    frameGraph.addPass("checkpoint",
+        { { FrameResource::STATE, ResourceAccess::CLIENT } },
+        {},
+        [&]()
+        {
+            if (upStateCache)
+            {
+                upStateCache->store(simulatedSteps);
+            }
+        });
+    frameGraph.addPass("raycaster",
+        { { FrameResource::STATE, ResourceAccess::TEXTURE }, { FrameResource::COLOR, ResourceAccess::TEXTURE } },
+        {},
+        [&]()
+        {
+            upRaycaster->draw(uniformView, uniformProjection, camera.getPosition());
+        });
+    frameGraph.addPass("fans",
+        {},
+        {},
+        [&]()
+        {
+            // Draw fans (TODO: Does not work)
+            for(const Fan& fan : fans)
+            {
+                fan.draw(uniformView, uniformProjection);
+            }
+        });
+    frameGraph.addPass("sensors",
+        { { FrameResource::STATE, ResourceAccess::IMAGE } },
+        { { FrameResource::SENSORS, ResourceAccess::STORAGE } },
+        [&]()
+        {
+            sensorReader.draw(uniformView, uniformProjection);
+            sensorReader.update();
+        });
+    frameGraph.addPass("sensor readback",
+        { { FrameResource::SENSORS, ResourceAccess::CLIENT } },
+        {},
+        [&]()
+        {
+            sensorReader.read();
+        });
+
     // Loop
     while (!glfwWindowShouldClose(pWindow))
     {
@@ -202,43 +416,61 @@ int main(void)
         // Projection matrix
         uniformProjection = glm::perspective(glm::radians(35.0f), ((GLfloat)width / (GLfloat)height), 0.1f, 100.f);
 
-        // Simulate (TODO: real time steps. at the moment depending on frame time)
-        fluidSimulator.nextStep(0.5);
-        heatSimulator.nextStep(0.5);
-
-        // Draw raycaster
-        upRaycaster->draw(uniformView, uniformProjection, camera.getPosition());
-
-        // Draw fans (TODO: Does not work)
-        for(const Fan& fan : fans)
-        {
-            fan.draw(uniformView, uniformProjection);
-        }
-
-        // Update and draw sensors
-        std::vector<std::string> sensorOutputs = sensorReader.updateAndDraw(uniformView, uniformProjection);
+        // Simulate, draw and read sensors
+        frameGraph.execute();
 
         // Prepare next frame
         glfwSwapBuffers(pWindow);
         glfwPollEvents();
 
         // Printing
-		std::stringstream fps;
-		fps << std::setfill('0') << std::setw(3) << (int)(1.0f / deltaTime);
-		std::string sensorPrint = "";
-		if (!sensorOutputs.empty())
+		timeSincePrint += deltaTime;
+		framesSincePrint++;
+		if (timeSincePrint >= PRINT_INTERVAL)
 		{
-			sensorPrint = " | Sensors: ";
-			for (int i = 0; i < sensorOutputs.size(); i++)
+			// Relaxation of the last step by whichever simulator ran it
+			ConvergenceInfo fluidInfo = fluidSimulator.getConvergenceInfo();
+			ConvergenceInfo heatInfo = heatSimulator.getConvergenceInfo();
+			if (upCpuSimulator)
+			{
+				fluidInfo = upCpuSimulator->getFluidConvergenceInfo();
+				heatInfo = upCpuSimulator->getHeatConvergenceInfo();
+			}
+			else if (upFusedSimulator)
 			{
-				sensorPrint += sensorOutputs[i];
-				if (i < sensorOutputs.size() - 1)
-				{
-					sensorPrint += ", ";
-				}
+				fluidInfo = upFusedSimulator->getFluidConvergenceInfo();
+				heatInfo = upFusedSimulator->getHeatConvergenceInfo();
 			}
+
+			int length = std::snprintf(printBuffer, sizeof(printBuffer), "FPS: %03d", (int)(framesSincePrint / timeSincePrint));
+			if (!sensors.empty() && length < (int)sizeof(printBuffer))
+			{
+				length += std::snprintf(printBuffer + length, sizeof(printBuffer) - length, " | Sensors: ");
+			}
+			if (!sensors.empty() && length < (int)sizeof(printBuffer))
+			{
+				length += sensorReader.format(printBuffer + length, (int)sizeof(printBuffer) - length);
+			}
+			if (length < (int)sizeof(printBuffer))
+			{
+				std::snprintf(printBuffer + length, sizeof(printBuffer) - length, " | Fluid: %d sweeps, change %.2e | Heat: %d sweeps, change %.2e",
+					fluidInfo.sweeps, fluidInfo.maxUpdate, heatInfo.sweeps, heatInfo.maxUpdate);
+			}
+			std::cout << "\r" << printBuffer;
+			timeSincePrint = 0;
+			framesSincePrint = 0;
 		}
-		std::cout << "\r" << "FPS: " << fps.str() << sensorPrint;
+
+        // Checkpoints write files on their schedule, everything else is allocated in the first frames
+        frame++;
+        if (frame == WARM_UP_FRAMES)
+        {
+            warmUpAllocations = getAllocationCount();
+        }
+        else if (frame > WARM_UP_FRAMES && !USE_STATE_CACHE)
+        {
+            assert(getAllocationCount() == warmUpAllocations && "Frame loop allocated after warm-up");
+        }
     }
 
     // Termination